@@ -4,14 +4,20 @@
 #include "MdiArea.h"
 #include "QSettings"
 #include "QFileDialog"
+#include "QAction"
 #include "GLSLViewer/GLSLViewer.h"
+#include "GLSLViewer/PointCloudExporter.h"
+#include "GLSLViewer/PointCloudMemoryBudget.h"
+#include "GLSLViewer/PointCloudColormap.h"
+#include "DCGui/ColorTable.h"
+#include "QFutureWatcher"
 
 static BCGP* s_instance = nullptr;
 
-//! ʵ
+//! 实例化对象
 BCGP* BCGP::Instance()
 {
-    //ʵMyClass1 
+    //实例化MyClass1 
     if (!s_instance)
     {
         s_instance = new BCGP();
@@ -19,7 +25,7 @@ BCGP* BCGP::Instance()
 
     return s_instance;
 }
-//! ɾʵĶ
+//! 删除实例化的对象
 void BCGP::UnInitialize()
 {
     if (s_instance)
@@ -48,7 +54,7 @@ BCGP::~BCGP()
 
 void BCGP::Init()
 {
-    //ʼരڹ
+    //初始化多窗口管理
     QGridLayout* gridLayout = new QGridLayout(centralWidget());
     m_pMdiArea = new MdiArea(centralWidget());
     m_pMdiArea->setVerticalScrollBarPolicy(Qt::ScrollBarAsNeeded);
@@ -56,17 +62,93 @@ void BCGP::Init()
     m_pMdiArea->setFocus();
     gridLayout->addWidget(m_pMdiArea, 0, 0, 1, 1);
 
-    //õװ屳ͼƬ
+    //设置底板背景图片
     m_pMdiArea->setBackground(Qt::NoBrush);
     QBrush bgBrush(QImage(":/img/Resources/gpbg.png"));
     m_pMdiArea->setBackground(bgBrush);
 
-    //! രڵϷŲ
+    //! 激活多窗口的拖放操作
     m_pMdiArea->setAcceptDrops(true);
 
     connect(m_pMdiArea, SIGNAL(subWindowActivated(QMdiSubWindow*)), this, SLOT(ChangedCurrentViewer(QMdiSubWindow*)));
 
-    //״̬
+    //! 点云内存预算（MB），超出时释放未激活窗口的 GPU/CPU 数据
+    QSettings settings;
+    settings.beginGroup("MemoryBudget");
+    PointCloudMemoryBudget::setCpuBudget(settings.value("CpuMB", 8192).toLongLong() << 20);
+    PointCloudMemoryBudget::setGpuBudget(settings.value("GpuMB", 2048).toLongLong() << 20);
+    settings.endGroup();
+
+    //! 高程色带：预设名称（elevation/viridis/jet/terrain/grayscale）或 custom，
+    //! custom 时按颜色表中的颜色名称等间距排列
+    settings.beginGroup("Colormap");
+    const QString colormapName = settings.value("Name", "elevation").toString();
+    if (colormapName.compare("custom", Qt::CaseInsensitive) == 0)
+    {
+        QList<QColor> colors;
+        const QStringList colorNames = settings.value("CustomColors").toStringList();
+        for (const QString& colorName : colorNames)
+        {
+            colors.append(DcGui::ColorTable::GetColor(colorName));
+        }
+        m_colormap = PointCloudColormap::fromColors("custom", colors);
+    }
+    else
+    {
+        m_colormap = PointCloudColormap::preset(colormapName);
+    }
+    settings.endGroup();
+
+    //! 点大小：Adaptive 时按点间距自适应，Scale 为全局系数；否则使用 FixedSize
+    settings.beginGroup("PointSize");
+    m_pointSizeSettings.adaptive = settings.value("Adaptive", true).toBool();
+    m_pointSizeSettings.scale = settings.value("Scale", 1.0).toFloat();
+    m_pointSizeSettings.fixedSize = settings.value("FixedSize", 3.0).toFloat();
+    m_pointSizeSettings.minSize = settings.value("MinSize", 1.0).toFloat();
+    m_pointSizeSettings.maxSize = settings.value("MaxSize", 10.0).toFloat();
+    settings.endGroup();
+
+    //! 视觉着色：开关取菜单动作的初始勾选状态，其余参数来自配置
+    settings.beginGroup("EDL");
+    m_edlSettings.halfResolution = settings.value("HalfResolution", false).toBool();
+    m_edlSettings.strength = settings.value("Strength", 1.0).toFloat();
+    m_edlSettings.radius = settings.value("Radius", 1.4).toFloat();
+    settings.endGroup();
+    if (QAction* edlAction = findChild<QAction*>("actionEDLShader"))
+    {
+        m_edlSettings.enabled = edlAction->isChecked();
+    }
+
+    //! 编辑快捷键：删除所选点、撤销、重做
+    if (QAction* deleteAction = findChild<QAction*>("actionDeletePoints"))
+    {
+        deleteAction->setShortcut(QKeySequence::Delete);
+    }
+    if (QAction* undoAction = findChild<QAction*>("actionUndo"))
+    {
+        undoAction->setShortcut(QKeySequence::Undo);
+    }
+    if (QAction* redoAction = findChild<QAction*>("actionRedo"))
+    {
+        redoAction->setShortcut(QKeySequence::Redo);
+    }
+    UpdateEditActions();
+
+    //! 动态旋转中心：取菜单动作的初始勾选状态
+    if (QAction* pivotAction = findChild<QAction*>("actionUpdatePivot"))
+    {
+        m_dynamicPivot = pivotAction->isChecked();
+    }
+
+    //! 屏幕空间补洞：填满稀疏点之间的空隙
+    settings.beginGroup("HoleFill");
+    m_holeFillSettings.enabled = settings.value("Enabled", false).toBool();
+    m_holeFillSettings.levels = settings.value("Levels", 4).toInt();
+    m_holeFillSettings.depthTolerance = settings.value("DepthTolerance", 0.1).toFloat();
+    m_holeFillSettings.minCoverage = settings.value("MinCoverage", 0.5).toFloat();
+    settings.endGroup();
+
+    //状态栏
     statusBar()->showMessage(QString::fromLocal8Bit("ok"));
 }
 
@@ -76,20 +158,337 @@ GLSLViewer* BCGP::CurrentDCViewer()
     return pViewer;
 }
 
-//! ı䵱ǰ
+//! 改变当前窗体
 void BCGP::ChangedCurrentViewer(QMdiSubWindow* subWindow)
 {
     GLSLViewer* pViewer = CurrentDCViewer();
-    //Ϣź֪ͨڸı
+    //发送消息信号通知窗口改变了
+    if (pViewer)
+    {
+        //! 标记为最近使用，超出内存预算时释放长时间未激活窗口的数据
+        pViewer->activate();
+    }
+    UpdateEditActions();
+}
+
+//! 视图设置
+void BCGP::SetView()
+{
+    QAction* action = qobject_cast<QAction*>(sender());
+    if (!action)
+    {
+        return;
+    }
+
+    if (action->objectName() == "actionEDLShader")
+    {
+        //! 视觉着色对所有窗口生效，新建窗口也沿用
+        m_edlSettings.enabled = action->isChecked();
+        const QList<QMdiSubWindow*> subWindowList = m_pMdiArea->subWindowList();
+        for (QMdiSubWindow* subWindow : subWindowList)
+        {
+            if (GLSLViewer* pViewer = qobject_cast<GLSLViewer*>(subWindow->widget()))
+            {
+                pViewer->setEyeDomeLighting(m_edlSettings);
+            }
+        }
+    }
+    else if (action->objectName() == "actionCenterSelected")
+    {
+        GLSLViewer* pViewer = CurrentDCViewer();
+        if (!pViewer || !pViewer->centerOnSelection())
+        {
+            statusBar()->showMessage(tr("No points selected"));
+        }
+    }
 }
 
-//! ļ
+//! 动态旋转中心
+void BCGP::UpdatePivot()
+{
+    QAction* action = qobject_cast<QAction*>(sender());
+    m_dynamicPivot = action ? action->isChecked() : !m_dynamicPivot;
+
+    const QList<QMdiSubWindow*> subWindowList = m_pMdiArea->subWindowList();
+    for (QMdiSubWindow* subWindow : subWindowList)
+    {
+        if (GLSLViewer* pViewer = qobject_cast<GLSLViewer*>(subWindow->widget()))
+        {
+            pViewer->setDynamicPivot(m_dynamicPivot);
+        }
+    }
+}
+
+//! 点坐标量测
+void BCGP::MeasurePoint()
+{
+    QAction* action = qobject_cast<QAction*>(sender());
+    const bool checked = action ? action->isChecked() : true;
+    SetMeasureMode(checked ? GLSLViewer::eMeasurePoint : GLSLViewer::eMeasureNone);
+}
+
+//! 两点距离量测
+void BCGP::MeasureDistance()
+{
+    QAction* action = qobject_cast<QAction*>(sender());
+    const bool checked = action ? action->isChecked() : true;
+    SetMeasureMode(checked ? GLSLViewer::eMeasureDistance : GLSLViewer::eMeasureNone);
+}
+
+void BCGP::SetMeasureMode(GLSLViewer::MeasureMode mode)
+{
+    m_measureMode = mode;
+    if (mode != GLSLViewer::eMeasureNone && m_selectionTool != GLSLViewer::eSelectNone)
+    {
+        SetSelectionTool(GLSLViewer::eSelectNone);
+    }
+
+    //! 两个量测动作互斥，菜单勾选状态与当前工具一致
+    if (QAction* pointAction = findChild<QAction*>("actionPointMeasure"))
+    {
+        pointAction->setChecked(mode == GLSLViewer::eMeasurePoint);
+    }
+    if (QAction* distanceAction = findChild<QAction*>("actionDistanceMeasure"))
+    {
+        distanceAction->setChecked(mode == GLSLViewer::eMeasureDistance);
+    }
+
+    const QList<QMdiSubWindow*> subWindowList = m_pMdiArea->subWindowList();
+    for (QMdiSubWindow* subWindow : subWindowList)
+    {
+        if (GLSLViewer* pViewer = qobject_cast<GLSLViewer*>(subWindow->widget()))
+        {
+            pViewer->setMeasureMode(mode);
+        }
+    }
+
+    if (mode == GLSLViewer::eMeasurePoint) statusBar()->showMessage(tr("Click a point to show its coordinates"));
+    else if (mode == GLSLViewer::eMeasureDistance) statusBar()->showMessage(tr("Click two points to measure the distance"));
+    else statusBar()->clearMessage();
+}
+
+//! 选择工具
+void BCGP::SelectPoints()
+{
+    QAction* action = qobject_cast<QAction*>(sender());
+    if (!action)
+    {
+        return;
+    }
+
+    if (action->objectName() == "actionCancelSelect")
+    {
+        //! 清空当前窗口的选择，工具保持不变
+        if (GLSLViewer* pViewer = CurrentDCViewer())
+        {
+            pViewer->clearSelection();
+        }
+        return;
+    }
+
+    GLSLViewer::SelectionTool tool = GLSLViewer::eSelectNone;
+    if (action->isChecked())
+    {
+        tool = action->objectName() == "actionLassoSelect" ? GLSLViewer::eSelectLasso : GLSLViewer::eSelectRectangle;
+    }
+    SetSelectionTool(tool);
+}
+
+void BCGP::SetSelectionTool(GLSLViewer::SelectionTool tool)
+{
+    m_selectionTool = tool;
+    if (tool != GLSLViewer::eSelectNone && m_measureMode != GLSLViewer::eMeasureNone)
+    {
+        SetMeasureMode(GLSLViewer::eMeasureNone);
+    }
+
+    //! 矩形和套索互斥，菜单勾选状态与当前工具一致
+    if (QAction* rectAction = findChild<QAction*>("actionRectSelect"))
+    {
+        rectAction->setChecked(tool == GLSLViewer::eSelectRectangle);
+    }
+    if (QAction* lassoAction = findChild<QAction*>("actionLassoSelect"))
+    {
+        lassoAction->setChecked(tool == GLSLViewer::eSelectLasso);
+    }
+
+    const QList<QMdiSubWindow*> subWindowList = m_pMdiArea->subWindowList();
+    for (QMdiSubWindow* subWindow : subWindowList)
+    {
+        if (GLSLViewer* pViewer = qobject_cast<GLSLViewer*>(subWindow->widget()))
+        {
+            pViewer->setSelectionTool(tool);
+        }
+    }
+
+    if (tool != GLSLViewer::eSelectNone) statusBar()->showMessage(tr("Drag to select points, Shift to add, Ctrl to remove"));
+    else statusBar()->clearMessage();
+}
+
+//! 裁剪
+void BCGP::ClipPoints()
+{
+    QAction* action = qobject_cast<QAction*>(sender());
+    GLSLViewer* pViewer = CurrentDCViewer();
+    if (!action || !pViewer || !pViewer->hasPoints())
+    {
+        return;
+    }
+
+    const QString name = action->objectName();
+    if (name == "actionClipInside" || name == "actionClipOutside")
+    {
+        if (!pViewer->clipToSelection(name == "actionClipInside"))
+        {
+            statusBar()->showMessage(tr("Select points first (at most %1 clip boxes)").arg(PointCloudClipping::kMaxBoxes));
+        }
+    }
+    else if (name == "actionClipPlane")
+    {
+        if (!pViewer->addViewClipPlane())
+        {
+            statusBar()->showMessage(tr("At most %1 clip planes").arg(PointCloudClipping::kMaxPlanes));
+        }
+    }
+    else if (name == "actionReverseClip")
+    {
+        pViewer->invertClipping();
+    }
+    else if (name == "actionClearClip")
+    {
+        pViewer->clearClipping();
+    }
+    else if (name == "actionBakeClip")
+    {
+        BakeClipping(pViewer);
+    }
+}
+
+//! 编辑
+void BCGP::EditPoints()
+{
+    QAction* action = qobject_cast<QAction*>(sender());
+    GLSLViewer* pViewer = CurrentDCViewer();
+    if (!action || !pViewer || !pViewer->hasPoints())
+    {
+        return;
+    }
+
+    const QString name = action->objectName();
+    if (name == "actionDeletePoints")
+    {
+        if (!pViewer->deleteSelection())
+        {
+            statusBar()->showMessage(tr("Select points to delete first"));
+        }
+    }
+    else if (name == "actionUndo")
+    {
+        pViewer->undoEdit();
+    }
+    else if (name == "actionRedo")
+    {
+        pViewer->redoEdit();
+    }
+}
+
+void BCGP::UpdateEditActions()
+{
+    GLSLViewer* pViewer = CurrentDCViewer();
+    const std::shared_ptr<PointCloudDataset> dataset = pViewer ? pViewer->dataset() : nullptr;
+    if (QAction* undoAction = findChild<QAction*>("actionUndo"))
+    {
+        undoAction->setEnabled(dataset && dataset->canUndo());
+    }
+    if (QAction* redoAction = findChild<QAction*>("actionRedo"))
+    {
+        redoAction->setEnabled(dataset && dataset->canRedo());
+    }
+}
+
+void BCGP::BakeClipping(GLSLViewer* viewer)
+{
+    if (!viewer->clipping())
+    {
+        statusBar()->showMessage(tr("No clipping to save"));
+        return;
+    }
+
+    QSettings settings;
+    settings.beginGroup("ExportData");
+    QString currentPath = settings.value("ExportDataPath", QApplication::applicationDirPath()).toString();
+    QString fileName = QFileDialog::getSaveFileName(this, tr("Save clipped points"), currentPath, PointCloudExporter::fileFilter());
+    if (fileName.isEmpty())
+    {
+        settings.endGroup();
+        return;
+    }
+    settings.setValue("ExportDataPath", QFileInfo(fileName).absolutePath());
+    settings.endGroup();
+
+    //! 裁剪状态取当前快照，之后继续修改裁剪不影响正在写的文件
+    const PointCloudExporter::Format format = PointCloudExporter::formatFromFileName(fileName);
+    statusBar()->showMessage(tr("Saving clipped points to %1 ...").arg(fileName));
+    QFutureWatcher<bool>* watcher = new QFutureWatcher<bool>(this);
+    connect(watcher, &QFutureWatcher<bool>::finished, this, [this, watcher, fileName, format]()
+    {
+        const bool ok = watcher->result();
+        watcher->deleteLater();
+        statusBar()->showMessage(ok ? tr("Saved %1").arg(fileName) : tr("Failed to save %1").arg(fileName));
+        //! LAS 暂不能读取，其它格式直接打开裁剪结果
+        if (ok && format != PointCloudExporter::Las)
+        {
+            LoadFile(fileName, nullptr);
+        }
+    });
+    watcher->setFuture(PointCloudExporter::exportAsync(viewer->pointCloud(), viewer->dataset()->deletedPoints(),
+        viewer->clipping(), fileName, format));
+}
+
+void BCGP::ConnectMeasurement(GLSLViewer* viewer)
+{
+    connect(viewer, &GLSLViewer::pointPicked, this, [this](double x, double y, double z)
+    {
+        statusBar()->showMessage(tr("X: %1  Y: %2  Z: %3")
+            .arg(x, 0, 'f', 3).arg(y, 0, 'f', 3).arg(z, 0, 'f', 3));
+    });
+    connect(viewer, &GLSLViewer::distanceMeasured, this, [this](double distance, double dx, double dy, double dz)
+    {
+        statusBar()->showMessage(tr("Distance: %1  dX: %2  dY: %3  dZ: %4")
+            .arg(distance, 0, 'f', 3).arg(dx, 0, 'f', 3).arg(dy, 0, 'f', 3).arg(dz, 0, 'f', 3));
+    });
+    connect(viewer, &GLSLViewer::selectionChanged, this, [this](qulonglong selectedCount, qulonglong pointCount)
+    {
+        statusBar()->showMessage(tr("Selected %1 of %2 points").arg(selectedCount).arg(pointCount));
+    });
+    //! 同一文件在多个窗口中共享数据集，编辑后其它窗口一起刷新
+    connect(viewer, &GLSLViewer::pointsEdited, this, [this, viewer]()
+    {
+        const QList<QMdiSubWindow*> subWindowList = m_pMdiArea->subWindowList();
+        for (QMdiSubWindow* subWindow : subWindowList)
+        {
+            GLSLViewer* pViewer = qobject_cast<GLSLViewer*>(subWindow->widget());
+            if (pViewer && pViewer != viewer && pViewer->dataset() == viewer->dataset())
+            {
+                pViewer->refreshEdits();
+            }
+        }
+        UpdateEditActions();
+        if (viewer->dataset())
+        {
+            statusBar()->showMessage(tr("%1 points, %2 deleted")
+                .arg(viewer->dataset()->pointCount()).arg(viewer->deletedCount()));
+        }
+    });
+}
+
+//! 加载文件
 int BCGP::LoadFile(const QString& fileName, GLSLViewer* viewer)
 {
-    //!2 һviewӴviewڵ
+    //!2 创建一个view，视窗与view共享场景根节点
     GLSLViewer* pNewViewer = new GLSLViewer(this);
     
-    //жǷڴ
+    //判断是否存在窗口
     QList<QMdiSubWindow*> subWindowList = m_pMdiArea->subWindowList();
     GLSLViewer* otherWin = 0;
     if (!subWindowList.isEmpty())
@@ -102,27 +501,35 @@ int BCGP::LoadFile(const QString& fileName, GLSLViewer* viewer)
     subWindow->setMinimumSize(300, 200);
     subWindow->setWindowTitle("GLSL Viewer");
     
-    //ʾʼopenglܼ
+    //最大化显示，初始化opengl环境后才能加载数据
     subWindow->showMaximized();
 
+    if (m_colormap) pNewViewer->setColormap(m_colormap);
+    pNewViewer->setPointSize(m_pointSizeSettings);
+    pNewViewer->setEyeDomeLighting(m_edlSettings);
+    pNewViewer->setHoleFilling(m_holeFillSettings);
+    pNewViewer->setMeasureMode(m_measureMode);
+    pNewViewer->setDynamicPivot(m_dynamicPivot);
+    pNewViewer->setSelectionTool(m_selectionTool);
+    ConnectMeasurement(pNewViewer);
     pNewViewer->loadPointCloud(fileName);
 	return 0;
 }
 
-//! ڵǰУļ
+//! 在当前激活窗口中，添加数据文件
 int BCGP::AddFile(GLSLViewer* viewer, const QString& fileName)
 {
 	
 	return 1;
 }
 
-//! 򿪹+
+//! 打开工程+
 void BCGP::OpenProject(QString proName)
 {
 	
 }
 
-//! صǰĴ
+//! 返回当前激活的窗口
 QWidget* BCGP::ActiveMdiChild()
 {
     if (QMdiSubWindow* activeSubWindow = m_pMdiArea->currentSubWindow())
@@ -135,15 +542,15 @@ QWidget* BCGP::ActiveMdiChild()
     }
 }
 
-//! ݵµվ
+//! 导入点云数据到新的站点
 void BCGP::ImportData()
 {
-    //¼ļ·
+    //记录文件路径
     QSettings settings;
     settings.beginGroup("ImporData");
     QString currentPath = settings.value("ImporDataPath", QApplication::applicationDirPath()).toString();
 
-    //! ѡȡļ
+    //! 选取文件名
     QStringList fileNames = QFileDialog::getOpenFileNames(this, tr("Open file"), currentPath);
 
     if (fileNames.isEmpty())
@@ -151,15 +558,55 @@ void BCGP::ImportData()
         return;
     }
 
-    //! ȡݣڣӵģ
+    //! 读取数据，并创建窗口，添加到管理模块中
     for (int i = 0; i != fileNames.size(); ++i)
     {
         LoadFile(fileNames[i], nullptr);
     }
 
-    //µǰļ·ļֵ
+    //更新当前保存的文件路径和文件过滤类型值
     currentPath = QFileInfo(fileNames[0]).absolutePath();
-    //µֵ浽settings
+    //将更新的值保存到settings中
     settings.setValue("ImporDataPath", currentPath);
     settings.endGroup();
-}
\ No newline at end of file
+}
+
+//! 导出当前窗口的点云数据
+void BCGP::ExportData()
+{
+    GLSLViewer* pViewer = CurrentDCViewer();
+    if (!pViewer || !pViewer->hasPoints())
+    {
+        statusBar()->showMessage(tr("No point cloud to export"));
+        return;
+    }
+
+    //记录文件路径
+    QSettings settings;
+    settings.beginGroup("ExportData");
+    QString currentPath = settings.value("ExportDataPath", QApplication::applicationDirPath()).toString();
+
+    //! 选取文件名，格式由扩展名决定
+    QString fileName = QFileDialog::getSaveFileName(this, tr("Export file"), currentPath, PointCloudExporter::fileFilter());
+    if (fileName.isEmpty())
+    {
+        settings.endGroup();
+        return;
+    }
+
+    settings.setValue("ExportDataPath", QFileInfo(fileName).absolutePath());
+    settings.endGroup();
+
+    //! 后台导出，数据由共享指针保持，窗口关闭也不影响写文件
+    statusBar()->showMessage(tr("Exporting %1 ...").arg(fileName));
+    QFutureWatcher<bool>* watcher = new QFutureWatcher<bool>(this);
+    connect(watcher, &QFutureWatcher<bool>::finished, this, [this, watcher, fileName]()
+    {
+        statusBar()->showMessage(watcher->result() ? tr("Exported %1").arg(fileName)
+                                                   : tr("Failed to export %1").arg(fileName));
+        watcher->deleteLater();
+    });
+    //! 已删除的点不导出
+    watcher->setFuture(PointCloudExporter::exportAsync(pViewer->pointCloud(), pViewer->dataset()->deletedPoints(),
+        nullptr, fileName, PointCloudExporter::formatFromFileName(fileName)));
+}
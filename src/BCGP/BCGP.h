@@ -10,6 +10,7 @@
 //DCGUI
 #include "DCGui/AuxMainWindow.h"
 #include "GLSLViewer/GLSLViewer.h"
+#include "GLSLViewer/PointCloudColormap.h"
 class MdiArea;
 class GLSLViewer;
 #include <QWidget>
@@ -27,27 +28,87 @@ public:
 
     static void UnInitialize();
 
-    //!--------------------------ļ----------------------------------
+    //!--------------------------数据文件加载----------------------------------
     int LoadFile(const QString& fileName, GLSLViewer* viewer);
     int AddFile(GLSLViewer* viewer, const QString& fileName);
 
-    //! 򿪹
+    //! 打开工程
     void OpenProject(QString proName);
     QWidget* ActiveMdiChild();
 
     GLSLViewer* CurrentDCViewer();
 private slots:
-    //! ݣ´
+    //! 导入数据，创建新窗口
     void ImportData();
 
-    //! ݵָĴ
+    //! 导出当前窗口的点云数据（后台写文件）
+    void ExportData();
+
+    //! 导入数据到指定的窗口中
     //void ImportDataToView();
 
-    //! ı䵱ǰ壨MDI֪ͨڣ
+    //! 视图设置，菜单中多个动作共用，按动作名称区分
+    void SetView();
+
+    //! 点坐标量测（可勾选，与距离量测互斥）
+    void MeasurePoint();
+
+    //! 两点距离量测（可勾选，与点坐标量测互斥）
+    void MeasureDistance();
+
+    //! 动态旋转中心（可勾选）：绕鼠标按下处的点旋转，否则绕包围盒中心
+    void UpdatePivot();
+
+    //! 选择工具，矩形、套索、取消选择共用，按动作名称区分（选择工具与量测工具互斥）
+    void SelectPoints();
+
+    //! 裁剪，保留框内、保留框外、剖切、反转、取消裁剪、裁剪结果另存共用，按动作名称区分；作用于当前窗口
+    void ClipPoints();
+
+    //! 编辑，删除所选点、撤销、重做共用，按动作名称区分；作用于当前窗口的数据集（共享该数据集的窗口一起刷新）
+    void EditPoints();
+
+    //! 改变当前窗体（MDI通知主窗口）
     void ChangedCurrentViewer(QMdiSubWindow* subWindow);
 private:
     Ui::BCGPClass ui;
 
+    //! 切换量测工具，作用于所有窗口
+    void SetMeasureMode(GLSLViewer::MeasureMode mode);
+
+    //! 裁剪结果另存（后台生成并写文件），能读取的格式写好后在新窗口中打开
+    void BakeClipping(GLSLViewer* viewer);
+
+    //! 切换选择工具，作用于所有窗口
+    void SetSelectionTool(GLSLViewer::SelectionTool tool);
+
+    //! 量测和选择结果显示在状态栏
+    void ConnectMeasurement(GLSLViewer* viewer);
+
+    //! 撤销、重做按当前窗口数据集的编辑记录启用
+    void UpdateEditActions();
+
     MdiArea* m_pMdiArea = nullptr;
+
+    //! 新建窗口使用的高程色带（配置中读取）
+    std::shared_ptr<const PointCloudColormap> m_colormap;
+
+    //! 点大小（配置中读取）
+    PointCloudPointSizeSettings m_pointSizeSettings;
+
+    //! 视觉着色参数，作用于所有窗口
+    PointCloudEdlSettings m_edlSettings;
+
+    //! 屏幕空间补洞参数（配置中读取）
+    PointCloudHoleFillSettings m_holeFillSettings;
+
+    //! 当前量测工具，新建窗口也沿用
+    GLSLViewer::MeasureMode m_measureMode = GLSLViewer::eMeasureNone;
+
+    //! 动态旋转中心，作用于所有窗口
+    bool m_dynamicPivot = false;
+
+    //! 当前选择工具，新建窗口也沿用
+    GLSLViewer::SelectionTool m_selectionTool = GLSLViewer::eSelectNone;
 };
 
@@ -3,21 +3,23 @@
 #include "QFileInfo"
 int main(int argc, char *argv[])
 {
+	//! 所有窗口共享 OpenGL 上下文，同一数据集的顶点缓冲只上传一次（必须在创建 QApplication 之前设置）
+	QApplication::setAttribute(Qt::AA_ShareOpenGLContexts);
 	QApplication a(argc, argv);
 
 	int aa = sizeof(long);
 
-	//! жɣʹݿ
+	//! 判断许可，使用数据库
 	BCGP* mw = BCGP::Instance();
 	QString license = mw->GetLicenseState();
 	mw->SetLicenseText(license);
 
-	//! жDCLCMG
+	//! 判断DCLCMG许可
 #ifdef USE_LISCENSE
-	//ж״̬
+	//判断许可状态
 	if (!IsValidLicense())
 	{
-		//жmw
+		//卸载主mw
 		mw->UnInitialize();
 		return EXIT_FAILURE;
 	}
@@ -25,19 +27,19 @@ int main(int argc, char *argv[])
 
 	mw->showMaximized();
 
-	//! ֹ֧ļ򿪣в
+	//! 支持工程文件打开，解析命令行参数
 	if (argc >= 2)
 	{
 		QString proName = argv[1];
 		QFileInfo info(proName);
 		if (info.suffix().toUpper() == "DCPRO")
 		{
-			//! 򿪹ļ
+			//! 打开工程文件
 			mw->OpenProject(proName);
 		}
 		else
 		{
-			//! ֵ֧ļ
+			//! 打开支持的文件
 			mw->LoadFile(proName, nullptr);
 		}
 	}
@@ -52,7 +54,7 @@ int main(int argc, char *argv[])
 		result = a.exec();
 	}
 
-	//жmw
+	//卸载主mw
 	mw->UnInitialize();
 
 	return result;
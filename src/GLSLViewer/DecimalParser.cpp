@@ -0,0 +1,198 @@
+﻿#include "DecimalParser.h"
+
+#include <charconv>
+#include <cstdint>
+#include <limits>
+#include <system_error>
+
+namespace
+{
+    // 10^0 .. 10^22 都能被 double 精确表示
+    const double kExactPow10[] = {
+        1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+
+    // 10^0 .. 10^10 都能被 float 精确表示（5^10 < 2^24）
+    const float kExactPow10f[] = {
+        1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f
+    };
+
+    // 各精度下 Clinger 快速路径的条件：尾数不超过 2^有效位数，10 的幂在精确表中
+    template <class T> struct FastPath;
+
+    template <> struct FastPath<double>
+    {
+        static constexpr uint64_t kMaxMantissa = uint64_t(1) << 53;
+        static constexpr int kMaxExponent = 22;
+        static double pow10(int e) { return kExactPow10[e]; }
+    };
+
+    template <> struct FastPath<float>
+    {
+        static constexpr uint64_t kMaxMantissa = uint64_t(1) << 24;
+        static constexpr int kMaxExponent = 10;
+        static float pow10(int e) { return kExactPow10f[e]; }
+    };
+
+    inline bool isDigit(char c)
+    {
+        return static_cast<unsigned char>(c - '0') < 10;
+    }
+
+    // 拆分出的十进制数：值 = (negative ? -1 : 1) * mantissa * 10^exponent
+    // truncated 表示超过 19 位的有效数字被舍去，unsignedBegin 指向符号之后
+    struct DecimalParts
+    {
+        uint64_t mantissa = 0;
+        int exponent = 0;
+        bool negative = false;
+        bool truncated = false;
+        const char* unsignedBegin = nullptr;
+    };
+
+    bool scanDecimal(const char* begin, const char* end, DecimalParts& parts)
+    {
+        const char* p = begin;
+        if (p == end) return false;
+
+        if (*p == '-' || *p == '+') {
+            parts.negative = (*p == '-');
+            ++p;
+        }
+        // std::from_chars 不接受 '+'，符号由我们自己处理
+        parts.unsignedBegin = p;
+
+        uint64_t mantissa = 0;
+        int significant = 0;   // 已累积到 mantissa 中的有效数字个数
+        int exponent = 0;
+        bool anyDigit = false;
+        bool truncated = false;
+
+        // 整数部分
+        for (; p != end && isDigit(*p); ++p) {
+            anyDigit = true;
+            if (significant < 19) {
+                mantissa = mantissa * 10 + static_cast<uint64_t>(*p - '0');
+                if (mantissa != 0) ++significant;
+            }
+            else {
+                truncated = true;
+                ++exponent;
+            }
+        }
+
+        // 小数部分
+        if (p != end && *p == '.') {
+            ++p;
+            for (; p != end && isDigit(*p); ++p) {
+                anyDigit = true;
+                if (significant < 19) {
+                    mantissa = mantissa * 10 + static_cast<uint64_t>(*p - '0');
+                    if (mantissa != 0) ++significant;
+                    --exponent;
+                }
+                else {
+                    truncated = true;
+                }
+            }
+        }
+
+        if (!anyDigit) return false;
+
+        // 指数部分
+        if (p != end && (*p == 'e' || *p == 'E')) {
+            ++p;
+            bool expNegative = false;
+            if (p != end && (*p == '-' || *p == '+')) {
+                expNegative = (*p == '-');
+                ++p;
+            }
+            if (p == end || !isDigit(*p)) return false;
+
+            int exp = 0;
+            for (; p != end && isDigit(*p); ++p) {
+                if (exp < 100000) exp = exp * 10 + (*p - '0');
+            }
+            exponent += expNegative ? -exp : exp;
+        }
+
+        if (p != end) return false;
+
+        parts.mantissa = mantissa;
+        parts.exponent = exponent;
+        parts.truncated = truncated;
+        return true;
+    }
+
+    // Clinger 快速路径：尾数和 10 的幂都能在 T 中精确表示时，一次 T 精度的乘除即为正确舍入结果
+    // 直接按目标精度计算，float 不经过 double，避免两次舍入
+    template <class T>
+    bool fastPath(const DecimalParts& parts, T& value)
+    {
+        using Limits = FastPath<T>;
+        if (parts.truncated || parts.mantissa > Limits::kMaxMantissa) return false;
+
+        const int exponent = parts.exponent;
+        T result;
+        if (parts.mantissa == 0) {
+            result = T(0);
+        }
+        else if (exponent >= 0 && exponent <= Limits::kMaxExponent) {
+            result = static_cast<T>(parts.mantissa) * Limits::pow10(exponent);
+        }
+        else if (exponent < 0 && exponent >= -Limits::kMaxExponent) {
+            result = static_cast<T>(parts.mantissa) / Limits::pow10(-exponent);
+        }
+        else if (exponent > Limits::kMaxExponent) {
+            // 把多出来的指数先乘进尾数，只要尾数仍然精确即可
+            uint64_t m = parts.mantissa;
+            for (int i = Limits::kMaxExponent; i < exponent; ++i) {
+                m *= 10;
+                if (m > Limits::kMaxMantissa) return false;
+            }
+            result = static_cast<T>(m) * Limits::pow10(Limits::kMaxExponent);
+        }
+        else {
+            return false;
+        }
+
+        value = parts.negative ? -result : result;
+        return true;
+    }
+
+    // 慢速路径：超长尾数或极端指数，std::from_chars 按目标精度正确舍入
+    template <class T>
+    bool parseDecimalT(const char* begin, const char* end, T& value)
+    {
+        DecimalParts parts;
+        if (!scanDecimal(begin, end, parts)) return false;
+        if (fastPath(parts, value)) return true;
+
+        T result = T(0);
+        const std::from_chars_result r = std::from_chars(parts.unsignedBegin, end, result);
+        if (r.ptr != end) return false;
+        if (r.ec == std::errc::result_out_of_range) {
+            // 超出 T 的范围时 from_chars 不写结果，按 strtod/strtof 的约定上溢为无穷大、下溢为 0
+            int magnitude = parts.exponent;
+            for (uint64_t m = parts.mantissa; m >= 10; m /= 10) ++magnitude;
+            result = magnitude > 0 ? std::numeric_limits<T>::infinity() : T(0);
+        }
+        else if (r.ec != std::errc()) {
+            return false;
+        }
+
+        value = parts.negative ? -result : result;
+        return true;
+    }
+}
+
+bool parseDecimal(const char* begin, const char* end, double& value)
+{
+    return parseDecimalT(begin, end, value);
+}
+
+bool parseDecimal(const char* begin, const char* end, float& value)
+{
+    return parseDecimalT(begin, end, value);
+}
@@ -0,0 +1,11 @@
+﻿#pragma once
+
+// 十进制数解析
+// 整个 [begin, end) 区间都必须是一个合法数字（可带符号、小数点和指数），否则返回 false。
+// 常见的测绘坐标（不超过 19 位有效数字、指数绝对值不超过 22）走 Clinger 快速路径，
+// 只需一次精确的整数转换和一次乘除；其余情况交给 std::from_chars，结果总是正确舍入的。
+bool parseDecimal(const char* begin, const char* end, double& value);
+
+// float 版本直接按单精度舍入，不先解析成 double 再转换（两次舍入在少数输入上差一个 ulp）
+// 快速路径要求尾数不超过 2^24、指数绝对值不超过 10
+bool parseDecimal(const char* begin, const char* end, float& value);
@@ -2,194 +2,761 @@
 #include <QDir>
 #include <QDebug>
 #include <QPainter>
-#include <QLinearGradient>
+#include <QOpenGLFramebufferObject>
+#include <QtConcurrent>
+#include <QFutureWatcher>
+
+#include <algorithm>
+#include <cmath>
+
+#include "PointCloudRegistry.h"
+#include "PointCloudMemoryBudget.h"
+#include "PointCloudRenderThread.h"
+
 // 修复 C26495: 始终初始化成员变量
 GLSLViewer::GLSLViewer(QWidget* parent)
     : QOpenGLWidget(parent)
     , m_renderMode(0)
     , m_distance(1.0f)
     , m_sceneRadius(0.0f)
-    , m_boxInitialized(false)
     , m_axisLength(40.0f)
     , m_showColorBar(false)
-    , m_axisInitialized(false)
-    , m_boxShader(nullptr)         // 明确初始化
     , m_glHeight(0)                // 明确初始化
     , m_glWidth(0)                 // 明确初始化
     , m_logDistance(1.0f)          // 明确初始化
 {
     setFocusPolicy(Qt::StrongFocus);
+    m_firstFrameTimer.start();
+
+    m_settleTimer.setSingleShot(true);
+    m_settleTimer.setInterval(200);
+    connect(&m_settleTimer, &QTimer::timeout, this, &GLSLViewer::endInteraction);
+
+    m_compactTimer.setSingleShot(true);
+    m_compactTimer.setInterval(kCompactIdleMs);
+    connect(&m_compactTimer, &QTimer::timeout, this, &GLSLViewer::compactDataset);
 }
 
 GLSLViewer::~GLSLViewer()
 {
     makeCurrent();
+    // 先停止渲染线程，线程中的 GL 资源在它自己的上下文中释放
+    stopRenderThread();
     // 释放 OpenGL 资源
-    m_vao.destroy();
-    m_vbo.destroy();
+    m_renderer.reset();
+    m_sceneFbo.reset();
+    if (m_presentFbo) glDeleteFramebuffers(1, &m_presentFbo);
+    m_postedState = PointCloudFrameState();
+    // 共享的 VBO 在最后一个持有者释放数据集时销毁，此时本窗口上下文仍为当前
+    m_dataset.reset();
     doneCurrent();
 }
 
 void GLSLViewer::loadPointCloud(const QString& filename)
 {
-    QFile file(filename);
-    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
-        qWarning() << "Cannot open file:" << filename;
-        return;
-    }
+    // 同一文件在多个窗口中共享 CPU 数据和 VBO，已加载时不再解析
+    std::shared_ptr<PointCloudDataset> dataset = PointCloudRegistry::acquire(filename);
+    if (!dataset) return;
+
+    m_dataset = std::move(dataset);
+    // 量测结果属于原来的数据
+    m_measuredPoints.clear();
+    m_pickPending = false;
+    m_selection.reset();
+    m_clipping.reset();
+    m_compactTimer.stop();
+
+    //设置默认渲染模式有rgb则真彩色，没有rgb则高程色渲染
+    // 不管是否有rgb，加载到内存中的数据都是6列 ，没有rgb的用的白色
+    setRenderMode(m_dataset->hasColor() ? 1 : 0);
+
+    // === 统计包围盒、场景中心和半径 ===
+    updateStatistics();
+
+    // === 重新初始化包围盒相关的 uniform（可选）===
+    // 我们将在顶点着色器中用 uniform 传递 minZ/maxZ
+
+    // 上传 GPU 和重建 VAO 由渲染器在绘制时完成（数据集已上传过时只重建 VAO）
+
+    // === 自动重置视图 ===
+    resetView();
+    requestRedraw(eDataDirty | eOverlayDirty);
+
+    // 登记到内存预算，必要时释放其它窗口的数据
+    activate();
+}
+
+// 窗口被激活或加载了数据：标记数据集为最近使用并检查内存预算
+// 被释放过的 GPU 缓冲在下一次绘制时从 CPU 数据或二进制缓存恢复
+// 窗口还没有上下文时（加载发生在第一次显示之前）同样检查，GPU 缓冲由 Qt 推迟释放
+void GLSLViewer::activate()
+{
+    if (!m_dataset) return;
+
+    PointCloudMemoryBudget::touch(m_dataset);
+    if (isValid()) makeCurrent();
+    PointCloudMemoryBudget::enforce();
+    if (isValid()) doneCurrent();
+    // 相机和数据都没变，不需要重绘；窗口已有的帧直接复用
+}
+
+// 数据集统计量变化后刷新，包围盒、中心和半径都从统计结果派生
+void GLSLViewer::updateStatistics()
+{
+    m_stats = m_dataset ? m_dataset->stats() : PointCloudStats();
+    if (!m_stats.valid()) return;
+
+    m_bboxMin = QVector3D(m_stats.min[0], m_stats.min[1], m_stats.min[2]);
+    m_bboxMax = QVector3D(m_stats.max[0], m_stats.max[1], m_stats.max[2]);
+
+    // 默认显示范围取 1%–99% 分位数，零星的飞点不会把色带压到一种颜色
+    m_displayMinZ = m_stats.zLow;
+    m_displayMaxZ = m_stats.zHigh;
+    m_rangePercentiles = true;
+    m_lowPercent = PointCloudStats::kDefaultLowPercent;
+    m_highPercent = PointCloudStats::kDefaultHighPercent;
+    m_center = (m_bboxMin + m_bboxMax) * 0.5f;
+    m_pivot = m_center;
+    m_bboxSize = m_bboxMax - m_bboxMin;
+    m_sceneRadius = 0.5f * m_bboxSize.length();
+
+    // 避免除零
+    if (m_sceneRadius < 1e-6f) m_sceneRadius = 1.0f;
+}
+
+// 标记需要重绘的内容；不可见时只记录，重新露出时再画
+// 相机和数据的变化推进版本号，场景缓存按版本号判断是否失效；只有叠加层变化时复用缓存
+void GLSLViewer::requestRedraw(int flags)
+{
+    if (flags & eCameraDirty) ++m_cameraVersion;
+    if (flags & eDataDirty) ++m_dataVersion;
+
+    m_dirty |= flags;
+    if (isRenderable()) update();
+}
 
-    // 临时存储原始点（x, y, z）和颜色
-    std::vector<float> originalPoints; // [x, y, z]
-    std::vector<float> colors;         // [r, g, b]
+// 被最大化窗口遮住、最小化或隐藏时都不可见
+bool GLSLViewer::isRenderable() const
+{
+    return isVisible() && !visibleRegion().isEmpty();
+}
 
-    m_bboxMin = QVector3D(std::numeric_limits<float>::max(),
-        std::numeric_limits<float>::max(),
-        std::numeric_limits<float>::max());
-    m_bboxMax = QVector3D(std::numeric_limits<float>::lowest(),
-        std::numeric_limits<float>::lowest(),
-        std::numeric_limits<float>::lowest());
+void GLSLViewer::showEvent(QShowEvent* event)
+{
+    QOpenGLWidget::showEvent(event);
+    if (m_renderThread) m_renderThread->setPaused(false);
+    // 最小化或隐藏后重新显示，完整绘制一次
+    m_dirty |= eRedrawAll;
+}
 
-    QTextStream in(&file);
+void GLSLViewer::hideEvent(QHideEvent* event)
+{
+    QOpenGLWidget::hideEvent(event);
+    releaseTransientTargets();
+}
 
-    //根据是否大于3列，判断是否有rgb颜色
-    bool isHaveColor = false;
+// 释放同步渲染的场景缓存，窗口再次显示时按需重建
+// 渲染线程只暂停不停止：频繁最小化、切换标签页时不必重建上下文和着色器，已完成的帧也保留
+void GLSLViewer::releaseTransientTargets()
+{
+    if (m_renderThread) m_renderThread->setPaused(true);
+    if (!isValid() || !m_sceneFbo) return;
 
-    while (!in.atEnd()) {
-        QString line = in.readLine().trimmed();
-        if (line.isEmpty()) continue;
+    makeCurrent();
+    m_sceneFbo.reset();
+    doneCurrent();
+}
 
-        QStringList parts = line.split(' ', Qt::SkipEmptyParts);
-        if (parts.size() < 3) continue;
+void GLSLViewer::paintEvent(QPaintEvent* event)
+{
+    // 被遮挡时跳过，脏标记保留到重新露出
+    if (!isRenderable()) return;
 
-        bool ok;
-        float x = parts[0].toFloat(&ok); if (!ok) continue;
-        float y = parts[1].toFloat(&ok); if (!ok) continue;
-        float z = parts[2].toFloat(&ok); if (!ok) continue;
+    // 相机、数据和叠加层都没有变化（例如被遮挡后重新露出），窗口中已有的帧仍然有效
+    if (m_dirty == 0) return;
 
-        // 更新包围盒（使用原始坐标！）
-        m_bboxMin.setX(qMin(m_bboxMin.x(), x));
-        m_bboxMin.setY(qMin(m_bboxMin.y(), y));
-        m_bboxMin.setZ(qMin(m_bboxMin.z(), z));
+    // 先清除脏标记再调用 QOpenGLWidget 的 paintEvent（会触发 paintGL，场景未变化时只是复制缓存）
+    // paintGL 中为分片上传、拾取读回请求的下一帧要保留下来，不能在之后清除
+    m_dirty = 0;
+    QOpenGLWidget::paintEvent(event);
 
-        m_bboxMax.setX(qMax(m_bboxMax.x(), x));
-        m_bboxMax.setY(qMax(m_bboxMax.y(), y));
-        m_bboxMax.setZ(qMax(m_bboxMax.z(), z));
+    // 二维叠加层每次都画在场景之上
+    QPainter painter(this);
+    paintOverlay(painter);
+    painter.end();
+}
 
-        originalPoints.insert(originalPoints.end(), { x, y, z });
+// 二维叠加层（颜色条、标注、量测、框选等），用 QPainter 画在场景缓存之上
+void GLSLViewer::paintOverlay(QPainter& painter)
+{
+    // 如果不是高程色模式，不画颜色条
+    if (m_showColorBar && hasPoints()) paintColorBar(painter);
+    if (!m_measuredPoints.empty()) paintMeasurement(painter);
+    if (m_selecting) paintSelectionShape(painter);
+    if (m_dynamicPivot && m_orbiting && hasPoints()) paintPivot(painter);
+}
 
-        float r = 1.0f, g = 1.0f, b = 1.0f;
-        if (parts.size() >= 6) {
-            r = qBound(0.0f, parts[3].toFloat() / 255.0f, 1.0f);
-            g = qBound(0.0f, parts[4].toFloat() / 255.0f, 1.0f);
-            b = qBound(0.0f, parts[5].toFloat() / 255.0f, 1.0f);
-            isHaveColor = true;
+// 旋转时在旋转中心画十字
+void GLSLViewer::paintPivot(QPainter& painter)
+{
+    QPointF pos;
+    if (!projectToWidget(m_pivot, pos)) return;
+
+    painter.setRenderHint(QPainter::Antialiasing, true);
+    painter.setPen(QPen(QColor(0, 200, 255), 2));
+    painter.drawEllipse(pos, 6.0, 6.0);
+    painter.drawLine(pos - QPointF(10, 0), pos + QPointF(10, 0));
+    painter.drawLine(pos - QPointF(0, 10), pos + QPointF(0, 10));
+}
+
+// 局部坐标投影到窗口坐标，在相机后方时返回 false
+bool GLSLViewer::projectToWidget(const QVector3D& local, QPointF& pos) const
+{
+    const QVector4D clip = m_projection * m_view * QVector4D(local, 1.0f);
+    if (clip.w() <= 1e-6f) return false;
+
+    pos = QPointF((clip.x() / clip.w() + 1.0f) * 0.5f * width(), (1.0f - clip.y() / clip.w()) * 0.5f * height());
+    return true;
+}
+
+// 量测标记：拾取的点画圆圈，点坐标模式标注真实坐标，距离模式连线并标注距离和高差
+void GLSLViewer::paintMeasurement(QPainter& painter)
+{
+    painter.setRenderHint(QPainter::Antialiasing, true);
+    QFont font = painter.font();
+    font.setPointSize(9);
+    painter.setFont(font);
+
+    std::vector<QPointF> positions(m_measuredPoints.size());
+    std::vector<bool> visible(m_measuredPoints.size());
+    for (size_t i = 0; i < m_measuredPoints.size(); ++i) {
+        visible[i] = projectToWidget(m_measuredPoints[i].local, positions[i]);
+    }
+
+    if (m_measuredPoints.size() == 2 && visible[0] && visible[1]) {
+        const MeasuredPoint& a = m_measuredPoints[0];
+        const MeasuredPoint& b = m_measuredPoints[1];
+        const double dx = b.world[0] - a.world[0];
+        const double dy = b.world[1] - a.world[1];
+        const double dz = b.world[2] - a.world[2];
+        const double distance = std::sqrt(dx * dx + dy * dy + dz * dz);
+
+        painter.setPen(QPen(QColor(255, 220, 0), 2));
+        painter.drawLine(positions[0], positions[1]);
+        const QString text = QStringLiteral("D: %1  dZ: %2").arg(distance, 0, 'f', 3).arg(dz, 0, 'f', 3);
+        painter.setPen(Qt::white);
+        painter.drawText((positions[0] + positions[1]) * 0.5 + QPointF(8, -8), text);
+    }
+
+    for (size_t i = 0; i < m_measuredPoints.size(); ++i) {
+        if (!visible[i]) continue;
+        painter.setPen(QPen(QColor(255, 220, 0), 2));
+        painter.drawEllipse(positions[i], 5.0, 5.0);
+
+        if (m_measureMode == eMeasurePoint) {
+            const MeasuredPoint& point = m_measuredPoints[i];
+            const QString text = QStringLiteral("X: %1  Y: %2  Z: %3")
+                .arg(point.world[0], 0, 'f', 3).arg(point.world[1], 0, 'f', 3).arg(point.world[2], 0, 'f', 3);
+            painter.setPen(Qt::white);
+            painter.drawText(positions[i] + QPointF(8, -8), text);
         }
-        colors.insert(colors.end(), { r, g, b });
     }
+}
+
+void GLSLViewer::setMeasureMode(MeasureMode mode)
+{
+    if (mode == m_measureMode) return;
+
+    m_measureMode = mode;
+    m_measuredPoints.clear();
+    m_pickPending = false;
+    if (mode == eMeasureNone) unsetCursor();
+    else setCursor(Qt::CrossCursor);
+    requestRedraw(eOverlayDirty);
+}
+
+void GLSLViewer::clearMeasurement()
+{
+    m_measuredPoints.clear();
+    m_pickPending = false;
+    requestRedraw(eOverlayDirty);
+}
+
+void GLSLViewer::setSelectionTool(SelectionTool tool)
+{
+    if (tool == m_selectionTool) return;
+
+    m_selectionTool = tool;
+    m_selecting = false;
+    m_selectionShape.clear();
+    if (tool == eSelectNone) unsetCursor();
+    else setCursor(Qt::CrossCursor);
+    requestRedraw(eOverlayDirty);
+}
 
-    if (originalPoints.empty()) {
-        qWarning() << "No valid points loaded.";
+void GLSLViewer::clearSelection()
+{
+    if (!m_selection) return;
+
+    m_selection.reset();
+    requestRedraw(eDataDirty);
+    emit selectionChanged(0, m_dataset ? m_dataset->pointCount() : 0);
+}
+
+// 拖动中的选择形状：虚线，套索未闭合的一边也画出
+void GLSLViewer::paintSelectionShape(QPainter& painter)
+{
+    if (m_selectionShape.size() < 2) return;
+
+    painter.setRenderHint(QPainter::Antialiasing, false);
+    painter.setPen(QPen(Qt::white, 1, Qt::DashLine));
+    painter.setBrush(QColor(255, 255, 255, 30));
+    if (m_selectionTool == eSelectRectangle) painter.drawRect(QRect(m_selectionShape.first(), m_selectionShape.last()).normalized());
+    else painter.drawPolygon(m_selectionShape);
+    painter.setBrush(Qt::NoBrush);
+}
+
+// 用当前相机判断每个点的投影，套索先光栅化为窗口大小的掩码，每个点只查一次表
+// 单击（形状为空）且不加减选时清空选择
+void GLSLViewer::applySelection(Qt::KeyboardModifiers modifiers)
+{
+    if (!hasPoints()) return;
+
+    PointCloudSelection::Mode mode = PointCloudSelection::eReplace;
+    if (modifiers & Qt::ShiftModifier) mode = PointCloudSelection::eAdd;
+    else if (modifiers & Qt::ControlModifier) mode = PointCloudSelection::eSubtract;
+    if (m_selectionShape.isEmpty()) {
+        if (mode == PointCloudSelection::eReplace) clearSelection();
         return;
     }
 
-    //设置默认渲染模式有rgb则真彩色，没有rgb则高程色渲染
-    // 不管是否有rgb，加载到内存中的数据都是6列 ，没有rgb的用的白色
-    setRenderMode(isHaveColor ? 1 : 0);
-    // === 计算场景中心和半径 ===
-    m_center = (m_bboxMin + m_bboxMax) * 0.5f;
-    m_bboxSize = m_bboxMax - m_bboxMin;
-    m_sceneRadius = 0.5f * m_bboxSize.length();
+    const std::shared_ptr<const PointCloudData> cloud = m_dataset->cloud();
+    if (!cloud) return;
+
+    QRectF bounds;
+    QImage mask;
+    if (m_selectionTool == eSelectLasso && m_selectionShape.size() >= 3) {
+        bounds = QRectF(m_selectionShape.boundingRect());
+        mask = QImage(size(), QImage::Format_Grayscale8);
+        mask.fill(0);
+        QPainter maskPainter(&mask);
+        maskPainter.setPen(Qt::NoPen);
+        maskPainter.setBrush(Qt::white);
+        maskPainter.drawPolygon(m_selectionShape);
+    }
+    else if (m_selectionTool == eSelectRectangle) {
+        bounds = QRectF(QPointF(m_selectionShape.first()), QPointF(m_selectionShape.last())).normalized();
+    }
 
-    // 避免除零
-    if (m_sceneRadius < 1e-6f) m_sceneRadius = 1.0f;
+    QElapsedTimer timer;
+    timer.start();
+    const std::shared_ptr<const PointCloudSelection> deleted = m_dataset->deletedPoints();
+    m_selection = PointCloudSelection::select(m_selection, *cloud, m_projection * m_view, size(), bounds,
+        mask.isNull() ? nullptr : &mask, mode, m_clipping.get(), deleted.get());
+    qDebug().nospace() << "Selection: " << m_selection->selectedCount() << " of " << cloud->pointCount()
+        << " points, " << timer.elapsed() << " ms";
 
-    // === 构建最终的 m_points: [x, y, z_norm, r, g, b] ===
-    // 注意：z_norm 是归一化的 z（用于高程色），但 x,y,z 渲染仍用原始值！
-    // 所以我们只替换 z 分量用于 color 通道，顶点位置仍用原始 xyz
-    m_points.clear();
-    float zRange = m_bboxMax.z() - m_bboxMin.z();
-    if (zRange < 1e-6f) zRange = 1.0f;
+    requestRedraw(eDataDirty);
+    emit selectionChanged(m_selection->selectedCount(), cloud->pointCount());
+}
 
-    for (size_t i = 0; i < originalPoints.size(); i += 3) {
-        float x = originalPoints[i];
-        float y = originalPoints[i + 1];
-        float z = originalPoints[i + 2];
+bool GLSLViewer::centerOnSelection()
+{
+    if (!hasPoints() || !m_selection || m_selection->empty()) return false;
+    const std::shared_ptr<const PointCloudData> cloud = m_dataset->cloud();
+    QVector3D min;
+    QVector3D max;
+    if (!cloud || !m_selection->bounds(*cloud, min, max)) return false;
+
+    m_center = (min + max) * 0.5f;
+    m_pivot = m_center;
+    // 单个点或很小的选择保持一个可见的距离
+    const float radius = std::max(0.5f * (max - min).length(), m_sceneRadius * 0.01f);
+    m_distance = std::max(0.01f, radius * 2.5f);
+    m_logDistance = std::log(m_distance);
+    updateCamera();
+    return true;
+}
 
-        float r = colors[i];
-        float g = colors[i + 1];
-        float b = colors[i + 2];
+void GLSLViewer::setClipping(const PointCloudClipping& clipping)
+{
+    if (clipping.empty()) m_clipping.reset();
+    else m_clipping = std::make_shared<const PointCloudClipping>(clipping);
+    requestRedraw(eDataDirty);
+}
 
-        // 因此，这里我们**不修改 z**，保持原始几何
-        m_points.insert(m_points.end(), { x, y, z, r, g, b });
-    }
+void GLSLViewer::clearClipping()
+{
+    if (!m_clipping) return;
 
-    // === 重新初始化包围盒相关的 uniform（可选）===
-    // 我们将在顶点着色器中用 uniform 传递 minZ/maxZ
+    m_clipping.reset();
+    requestRedraw(eDataDirty);
+}
+
+bool GLSLViewer::clipToSelection(bool keepInside)
+{
+    PointCloudClipping clipping = m_clipping ? *m_clipping : PointCloudClipping();
+    if (static_cast<int>(clipping.boxes.size()) >= PointCloudClipping::kMaxBoxes) return false;
+    if (!hasPoints() || !m_selection || m_selection->empty()) return false;
+    const std::shared_ptr<const PointCloudData> cloud = m_dataset->cloud();
+    PointCloudClipBox box;
+    if (!cloud || !m_selection->bounds(*cloud, box.min, box.max)) return false;
+
+    box.keepInside = keepInside;
+    clipping.boxes.push_back(box);
+    m_selection.reset();
+    emit selectionChanged(0, cloud->pointCount());
+    setClipping(clipping);
+    return true;
+}
+
+bool GLSLViewer::addViewClipPlane()
+{
+    PointCloudClipping clipping = m_clipping ? *m_clipping : PointCloudClipping();
+    if (!hasPoints() || static_cast<int>(clipping.planes.size()) >= PointCloudClipping::kMaxPlanes) return false;
+
+    // 视图矩阵第三行为相机 z 轴（指向相机后方），视线方向取反
+    const QVector3D forward = -m_view.row(2).toVector3D().normalized();
+    PointCloudClipPlane plane;
+    plane.normal = forward;
+    plane.offset = -QVector3D::dotProduct(forward, m_pivot);
+    clipping.planes.push_back(plane);
+    setClipping(clipping);
+    return true;
+}
 
-    // === 上传到 GPU ===
-    if (isValid()) {
-        makeCurrent();
-        m_vbo.bind();
-        m_vbo.allocate(m_points.data(),
-            static_cast<int>(m_points.size() * sizeof(float)));
-        m_vbo.release();
-        doneCurrent();
+void GLSLViewer::invertClipping()
+{
+    if (!m_clipping) return;
+
+    PointCloudClipping clipping = *m_clipping;
+    clipping.invert();
+    setClipping(clipping);
+}
+
+// 删除只按块合并删除标记，没有变化的块共享；渲染器只上传标志变化的块
+bool GLSLViewer::deleteSelection()
+{
+    if (!hasPoints() || !m_selection || m_selection->empty()) return false;
+    if (!m_dataset->deletePoints(*m_selection)) return false;
+
+    qDebug() << "Deleted" << m_selection->selectedCount() << "points, total" << m_dataset->deletedCount();
+    m_selection.reset();
+    emit selectionChanged(0, m_dataset->pointCount());
+    finishEdit();
+    return true;
+}
+
+bool GLSLViewer::undoEdit()
+{
+    if (!m_dataset || !m_dataset->undoEdit()) return false;
+
+    finishEdit();
+    return true;
+}
+
+bool GLSLViewer::redoEdit()
+{
+    if (!m_dataset || !m_dataset->redoEdit()) return false;
+
+    finishEdit();
+    return true;
+}
+
+// 编辑所在的窗口负责后台统计和压缩，其它窗口只刷新
+// 每次编辑都推迟压缩，连续删除、撤销时不会中途压缩
+void GLSLViewer::finishEdit()
+{
+    refreshEdits();
+    emit pointsEdited();
+    m_compactTimer.start();
+
+    const quint64 version = m_dataset->editVersion();
+    if (m_dataset->statsVersion() == version) return;
+
+    // 后台只计算，结果在 GUI 线程中写回数据集，stats() 只在 GUI 线程中读写
+    // 期间又有编辑时结果作废，由那次编辑重新统计
+    std::shared_ptr<PointCloudDataset> dataset = m_dataset;
+    QFutureWatcher<PointCloudStats>* watcher = new QFutureWatcher<PointCloudStats>(this);
+    connect(watcher, &QFutureWatcher<PointCloudStats>::finished, this, [this, watcher, dataset, version]()
+    {
+        const PointCloudStats stats = watcher->result();
+        watcher->deleteLater();
+        if (!dataset->updateStats(stats, version) || dataset != m_dataset) return;
+        refreshEdits();
+        emit pointsEdited();
+    });
+    watcher->setFuture(QtConcurrent::run([dataset, version]() {
+        const std::shared_ptr<const PointCloudData> cloud = dataset->cloud();
+        const std::shared_ptr<const PointCloudSelection> deleted = dataset->deletedPoints();
+        if (!cloud || dataset->editVersion() != version) return PointCloudStats();
+        return PointCloudStats::compute(*cloud, deleted.get());
+    }));
+}
+
+void GLSLViewer::refreshEdits()
+{
+    if (!m_dataset) return;
+
+    // 压缩后点的序号改变，原来的选择作废
+    if (m_selection && m_selection->pointCount() != m_dataset->pointCount()) {
+        m_selection.reset();
+        emit selectionChanged(0, m_dataset->pointCount());
     }
+    if (m_dataset->statsVersion() == m_dataset->editVersion()) applyEditedStatistics();
+    requestRedraw(eDataDirty | eOverlayDirty);
+}
 
-    updateBoundingBoxGeometry();
+// 编辑后的统计量：更新包围盒和场景半径，不重置视图和高程显示范围
+void GLSLViewer::applyEditedStatistics()
+{
+    const PointCloudStats& stats = m_dataset->stats();
+    if (!stats.valid()) return;
 
-    // === 自动重置视图 ===
-    resetView();
+    m_stats = stats;
+    m_bboxMin = QVector3D(m_stats.min[0], m_stats.min[1], m_stats.min[2]);
+    m_bboxMax = QVector3D(m_stats.max[0], m_stats.max[1], m_stats.max[2]);
+    m_bboxSize = m_bboxMax - m_bboxMin;
+    m_sceneRadius = 0.5f * m_bboxSize.length();
+    if (m_sceneRadius < 1e-6f) m_sceneRadius = 1.0f;
+    updateProjection();
+    requestRedraw(eCameraDirty);
+}
 
-    update();
-    
+// 准备在后台线程中进行，替换在 GUI 线程；准备期间又有编辑时放弃，等下一次空闲
+void GLSLViewer::compactDataset()
+{
+    if (!m_dataset || m_compacting) return;
+    if (m_dataset->deletedCount() < m_dataset->pointCount() * kCompactRatio) return;
+
+    m_compacting = true;
+    std::shared_ptr<PointCloudDataset> dataset = m_dataset;
+    using Compaction = std::shared_ptr<PointCloudDataset::Compaction>;
+    QFutureWatcher<Compaction>* watcher = new QFutureWatcher<Compaction>(this);
+    connect(watcher, &QFutureWatcher<Compaction>::finished, this, [this, watcher, dataset]()
+    {
+        const Compaction compaction = watcher->result();
+        watcher->deleteLater();
+        m_compacting = false;
+        if (!compaction || dataset != m_dataset) return;
+
+        // 释放 GPU 缓冲需要共享组内的上下文为当前
+        if (isValid()) makeCurrent();
+        const bool applied = dataset->applyCompaction(*compaction);
+        if (isValid()) doneCurrent();
+        if (!applied) return;
+
+        refreshEdits();
+        emit pointsEdited();
+    });
+    watcher->setFuture(QtConcurrent::run([dataset]() { return dataset->prepareCompaction(); }));
 }
 
-void GLSLViewer::paintEvent(QPaintEvent* event)
+// 拾取请求随下一帧的状态提交，渲染器在同一帧中画点序号并异步读回
+void GLSLViewer::requestPick(const QPoint& pos)
 {
-    // 先调用 QOpenGLWidget 的 paintEvent（会触发 paintGL）
-    QOpenGLWidget::paintEvent(event);
+    if (!hasPoints()) return;
 
-    // 如果不是高程色模式，不画颜色条
-    if (!m_showColorBar) return;
+    m_pickPos = pos;
+    ++m_pickSerial;
+    m_pickPending = true;
+    requestRedraw(eOverlayDirty);
+}
 
-    QPainter painter(this);
-    painter.setRenderHint(QPainter::Antialiasing, false);
+void GLSLViewer::setDynamicPivot(bool enabled)
+{
+    if (enabled == m_dynamicPivot) return;
 
-    // 颜色条位置：右侧，宽 20px，高 80% 窗口
-    int barWidth = 20;
-    int barHeight = static_cast<int>(height() * 0.8f);
-    int barX = width() - barWidth - 10;
-    int barY = (height() - barHeight) / 2;
+    m_dynamicPivot = enabled;
+    m_depthPickPending = false;
+    // 关闭后恢复绕包围盒中心旋转，当前视图不变
+    if (!enabled) m_pivot = (m_bboxMin + m_bboxMax) * 0.5f;
+    requestRedraw(eOverlayDirty);
+}
 
-    // 创建垂直线性渐变（从 minZ 到 maxZ）
-    QLinearGradient gradient(barX, barY + barHeight, barX, barY); // 从下到上
+// 与点拾取相同，随下一帧提交；渲染器在这一帧画完后读取深度
+void GLSLViewer::requestDepthPick(const QPoint& pos)
+{
+    if (!hasPoints()) return;
 
-    // 定义与 GLSL 中相同的颜色映射
-    gradient.setColorAt(0.0, QColor(0, 0, 128));       // 深蓝
-    gradient.setColorAt(0.25, QColor(0, 128, 0));      // 绿
-    gradient.setColorAt(0.5, QColor(204, 204, 0));     // 黄
-    gradient.setColorAt(0.75, QColor(255, 255, 255));  // 白
-    gradient.setColorAt(1.0, QColor(255, 255, 255));   // 白（保持）
+    m_depthPickPos = pos;
+    ++m_depthPickSerial;
+    m_depthPickPending = true;
+    requestRedraw(eOverlayDirty);
+}
 
-    // 画颜色条
-    painter.fillRect(barX, barY, barWidth, barHeight, gradient);
+// 窗口坐标（左上角为原点）换算到渲染像素（左下角为原点），取像素中心
+QPoint GLSLViewer::renderPixel(const QPoint& pos, const QSize& renderSize) const
+{
+    const int x = static_cast<int>((pos.x() + 0.5) * renderSize.width() / std::max(1, width()));
+    const int y = static_cast<int>((height() - pos.y() - 0.5) * renderSize.height() / std::max(1, height()));
+    return QPoint(qBound(0, x, renderSize.width() - 1), qBound(0, y, renderSize.height() - 1));
+}
+
+// 渲染器返回的点序号换算为真实坐标，深度读取的结果作为旋转中心
+// 重建渲染线程后同一请求可能返回多次，只接受正在等待的那一个
+void GLSLViewer::handlePickResults(const std::vector<PointCloudPickResult>& results)
+{
+    for (const PointCloudPickResult& result : results) {
+        if (result.kind == PointCloudPickResult::eDepth) {
+            if (!m_depthPickPending || result.serial != m_depthPickSerial) continue;
+            m_depthPickPending = false;
+            if (result.hit && m_dynamicPivot) {
+                m_pivot = result.position;
+                requestRedraw(eOverlayDirty);
+            }
+            continue;
+        }
+
+        if (!m_pickPending || result.serial != m_pickSerial) continue;
+        m_pickPending = false;
+        if (!result.hit || m_measureMode == eMeasureNone || !m_dataset) continue;
+
+        const std::shared_ptr<const PointCloudData> cloud = m_dataset->cloud();
+        if (!cloud || result.index >= cloud->pointCount()) continue;
+
+        MeasuredPoint point;
+        cloud->worldPosition(result.index, point.world[0], point.world[1], point.world[2]);
+        const float* p = cloud->points.data() + static_cast<size_t>(result.index) * PointCloudData::kFloatsPerPoint;
+        point.local = QVector3D(p[0], p[1], p[2]);
+
+        // 点坐标只保留最近一次；距离量测满两点后重新开始
+        if (m_measureMode == eMeasurePoint || m_measuredPoints.size() >= 2) m_measuredPoints.clear();
+        m_measuredPoints.push_back(point);
+
+        if (m_measureMode == eMeasurePoint) {
+            emit pointPicked(point.world[0], point.world[1], point.world[2]);
+        }
+        else if (m_measuredPoints.size() == 2) {
+            const double dx = m_measuredPoints[1].world[0] - m_measuredPoints[0].world[0];
+            const double dy = m_measuredPoints[1].world[1] - m_measuredPoints[0].world[1];
+            const double dz = m_measuredPoints[1].world[2] - m_measuredPoints[0].world[2];
+            emit distanceMeasured(std::sqrt(dx * dx + dy * dy + dz * dz), dx, dy, dz);
+        }
+        requestRedraw(eOverlayDirty);
+    }
+}
+
+// 颜色条位置：右侧，宽 20px，高 80% 窗口
+QRect GLSLViewer::colorBarRect() const
+{
+    const int barWidth = 20;
+    const int barHeight = static_cast<int>(height() * 0.8f);
+    return QRect(width() - barWidth - 10, (height() - barHeight) / 2, barWidth, barHeight);
+}
+
+void GLSLViewer::paintColorBar(QPainter& painter)
+{
+    painter.setRenderHint(QPainter::Antialiasing, false);
+
+    const QRect bar = colorBarRect();
+    const int barWidth = bar.width();
+    const int barHeight = bar.height();
+    const int barX = bar.x();
+    const int barY = bar.y();
+
+    // 画颜色条：与着色器相同的查找表，从下到上对应显示范围的下限到上限
+    if (m_colorBarImage.isNull()) m_colorBarImage = m_colormap->image();
+    painter.setRenderHint(QPainter::SmoothPixmapTransform, true);
+    painter.drawImage(QRect(barX, barY, barWidth, barHeight), m_colorBarImage);
 
     // 可选：画边框
     painter.setPen(Qt::white);
     painter.drawRect(barX, barY, barWidth - 1, barHeight - 1);
 
-    // 可选：标注 min/max Z 值
+    // 颜色条左侧画显示范围内的高程分布（统计时已得到 Z 直方图）
+    const std::vector<uint32_t>& histZ = m_stats.histogram[2];
+    const float extent = m_stats.max[2] - m_stats.min[2];
+    if (!histZ.empty() && extent > 0.0f) {
+        const float span = m_displayMaxZ - m_displayMinZ;
+        std::vector<int> rowBins(barHeight, -1);
+        uint32_t peak = 0;
+        for (int y = 0; y < barHeight; ++y) {
+            // 从下到上对应显示范围的下限到上限，超出数据范围的行不画
+            const float z = m_displayMinZ + span * (barHeight - 1 - y + 0.5f) / barHeight;
+            const int bin = static_cast<int>(std::floor((z - m_stats.min[2]) / extent * PointCloudStats::kHistogramBins));
+            if (bin < 0 || bin >= PointCloudStats::kHistogramBins) continue;
+            rowBins[y] = bin;
+            peak = std::max(peak, histZ[bin]);
+        }
+
+        const int histWidth = 30;
+        painter.setPen(QColor(255, 255, 255, 90));
+        for (int y = 0; y < barHeight && peak > 0; ++y) {
+            if (rowBins[y] < 0) continue;
+            const int len = static_cast<int>(histWidth * static_cast<float>(histZ[rowBins[y]]) / peak + 0.5f);
+            if (len > 0) painter.drawLine(barX - 2 - len, barY + y, barX - 2, barY + y);
+        }
+    }
+
+    // 标注显示范围（真实高程 = 局部偏移 + 原点），按分位数设置时注明分位
     painter.setPen(Qt::white);
     QFont font = painter.font();
     font.setPointSize(8);
     painter.setFont(font);
-    QString minText = QString::number(m_bboxMin.z(), 'f', 2);
-    QString maxText = QString::number(m_bboxMax.z(), 'f', 2);
-    painter.drawText(barX - 50, barY + barHeight, minText);
-    painter.drawText(barX - 50, barY, maxText);
+    const double originZ = m_dataset->origin().z;
+    QString minText = QString::number(originZ + m_displayMinZ, 'f', 2);
+    QString maxText = QString::number(originZ + m_displayMaxZ, 'f', 2);
+    if (m_rangePercentiles) {
+        minText += QStringLiteral(" (P%1)").arg(m_lowPercent);
+        maxText += QStringLiteral(" (P%1)").arg(m_highPercent);
+    }
+    const QFontMetrics metrics(font);
+    painter.drawText(barX - 6 - metrics.horizontalAdvance(minText), barY + barHeight, minText);
+    painter.drawText(barX - 6 - metrics.horizontalAdvance(maxText), barY + metrics.ascent(), maxText);
+}
 
-    painter.end();
+// 显示范围以真实高程设置，内部保存局部坐标；只改着色器 uniform，不改顶点数据
+void GLSLViewer::setElevationRange(double minZ, double maxZ)
+{
+    if (!m_dataset) return;
+    if (minZ > maxZ) std::swap(minZ, maxZ);
+
+    const double originZ = m_dataset->origin().z;
+    m_displayMinZ = static_cast<float>(minZ - originZ);
+    m_displayMaxZ = static_cast<float>(maxZ - originZ);
+    m_rangePercentiles = false;
+    requestRedraw(eDataDirty | eOverlayDirty);
+}
+
+void GLSLViewer::elevationRange(double& minZ, double& maxZ) const
+{
+    const double originZ = m_dataset ? m_dataset->origin().z : 0.0;
+    minZ = originZ + m_displayMinZ;
+    maxZ = originZ + m_displayMaxZ;
+}
+
+bool GLSLViewer::setElevationPercentiles(double lowPercent, double highPercent)
+{
+    if (!hasPoints()) return false;
+
+    float low = 0.0f, high = 0.0f;
+    if (lowPercent == PointCloudStats::kDefaultLowPercent && highPercent == PointCloudStats::kDefaultHighPercent) {
+        // 加载时已统计
+        low = m_stats.zLow;
+        high = m_stats.zHigh;
+    }
+    else {
+        // 已删除的点不计入
+        std::shared_ptr<const PointCloudData> cloud = pointCloud();
+        const std::shared_ptr<const PointCloudSelection> deleted = m_dataset->deletedPoints();
+        if (!cloud || !PointCloudStats::percentiles(*cloud, PointScalar::Z, lowPercent, highPercent, low, high, deleted.get())) {
+            return false;
+        }
+    }
+
+    m_displayMinZ = low;
+    m_displayMaxZ = high;
+    m_rangePercentiles = true;
+    m_lowPercent = lowPercent;
+    m_highPercent = highPercent;
+    requestRedraw(eDataDirty | eOverlayDirty);
+    return true;
+}
+
+void GLSLViewer::resetElevationRange()
+{
+    setElevationPercentiles(PointCloudStats::kDefaultLowPercent, PointCloudStats::kDefaultHighPercent);
 }
 
 
@@ -202,6 +769,10 @@ void GLSLViewer::resetView()
     m_yaw = -90.0f;   // 从 +X 方向看（常见于点云）
     m_pitch = -20.0f; // 稍微俯视
 
+    // 注视点和旋转中心回到包围盒中心
+    m_center = (m_bboxMin + m_bboxMax) * 0.5f;
+    m_pivot = m_center;
+
     // 相机距离：根据场景大小自动调整
     m_distance = m_sceneRadius * 2.5f; // 可调系数（2~3 倍半径通常合适）
     m_logDistance = log(m_distance);
@@ -214,24 +785,47 @@ void GLSLViewer::setRenderMode(int mode)
 {
     m_renderMode = mode;
     m_showColorBar = (mode == 0); // 仅高程色显示
-    update(); // 触发重绘（包括 paintEvent）
+    requestRedraw(eDataDirty | eOverlayDirty); // 触发重绘（包括 paintEvent）
+}
+
+void GLSLViewer::setColormap(std::shared_ptr<const PointCloudColormap> colormap)
+{
+    if (!colormap || colormap == m_colormap) return;
+
+    m_colormap = std::move(colormap);
+    m_colorBarImage = QImage();
+    // 只有高程色模式使用色带；场景重画只换纹理
+    if (m_renderMode == 0) requestRedraw(eDataDirty | eOverlayDirty);
+}
+
+void GLSLViewer::setPointSize(const PointCloudPointSizeSettings& settings)
+{
+    m_pointSize = settings;
+    requestRedraw(eDataDirty);
+}
+
+void GLSLViewer::setEyeDomeLighting(const PointCloudEdlSettings& settings)
+{
+    m_edl = settings;
+    requestRedraw(eDataDirty);
+}
+
+void GLSLViewer::setHoleFilling(const PointCloudHoleFillSettings& settings)
+{
+    m_holeFill = settings;
+    requestRedraw(eDataDirty);
 }
 
 void GLSLViewer::initializeGL()
 {
     initializeOpenGLFunctions();
     glClearColor(0.05f, 0.05f, 0.05f, 1.0f);
-    glEnable(GL_DEPTH_TEST);
-    glEnable(GL_PROGRAM_POINT_SIZE);
 
-    //点云着色器
-    initPointCloud();
+    // 呈现渲染线程的纹理
+    glGenFramebuffers(1, &m_presentFbo);
 
-    // 初始化坐标轴
-    //initScreenAxis();
-    initScreenAxisOrtho();
-
-    initBoundingBoxGeometry();
+    // 着色器、坐标轴和包围盒由渲染器在渲染线程的上下文中初始化
+    startRenderThread();
 }
 
 void GLSLViewer::resizeGL(int w, int h)
@@ -241,560 +835,350 @@ void GLSLViewer::resizeGL(int w, int h)
     m_glHeight = h;
     m_glWidth = w;
 
-    m_projection.setToIdentity();
-    float aspect = static_cast<float>(w) / static_cast<float>(h);
-    m_projection.perspective(45.0f, aspect, 0.1f, 1000.0f);
+    // 尺寸变化后窗口的帧缓冲重建过，需要完整绘制（场景缓存按尺寸重建）
+    m_dirty |= eRedrawAll;
+    updateProjection();
 }
 
-void GLSLViewer::paintGL()
+void GLSLViewer::updateProjection()
 {
-    glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-    //glEnable(GL_DEPTH_TEST);   // 必须开启深度测试
-    //glDisable(GL_BLEND);       // 避免混合干扰
-    //glDisable(GL_CULL_FACE);   // 坐标轴无背面
-    renderPointCloud();
-
-    // 2. 渲染坐标轴（半透明，无深度写入）
-    glDepthMask(GL_FALSE);
-    //renderScreenAxis();
-    renderScreenAxisOrtho();
-    glDepthMask(GL_TRUE);
-
-    // 3. 渲染边界盒（最后渲染，确保在最前面）
-    renderBoundingBox();
+    if (m_glWidth <= 0 || m_glHeight <= 0) return;
 
+    // 近/远裁剪面跟随相机距离和场景大小，放大查看时保持深度精度
+    // 绕其它点旋转后注视点会离开包围盒中心，远裁剪面按偏离的距离放远
+    const float offset = (m_center - (m_bboxMin + m_bboxMax) * 0.5f).length();
+    const float farPlane = m_distance + offset + 2.0f * m_sceneRadius + 1.0f;
+    const float nearPlane = qMax(m_distance * 0.01f, farPlane * 1e-6f);
 
+    m_projection.setToIdentity();
+    float aspect = static_cast<float>(m_glWidth) / static_cast<float>(m_glHeight);
+    m_projection.perspective(45.0f, aspect, nearPlane, farPlane);
 }
 
-void GLSLViewer::initPointCloud()
+void GLSLViewer::paintGL()
 {
-    // 编译着色器（从文件）
-    m_program = new QOpenGLShaderProgram(this);
-    if (!m_program->addShaderFromSourceFile(QOpenGLShader::Vertex, ":/shaders/shaders/pointcloud.vert")) {
-        qCritical() << "Failed to compile vertex shader";
+    // 交互期间只渲染左下角按比例缩小的区域，呈现时放大到整个窗口
+    const QSize fboSize = size() * devicePixelRatioF();
+    const PointCloudFrameState state = frameState();
+
+    if (!m_renderThread && !m_renderThreadFailed) startRenderThread();
+
+    if (m_renderThread) {
+        // 相机、数据版本和尺寸都没变时不再提交，窗口继续呈现已完成的帧
+        if (!state.sameFrame(m_postedState)) {
+            m_renderThread->post(state);
+            m_postedState = state;
+        }
+        presentThreadFrame(fboSize);
         return;
     }
-    if (!m_program->addShaderFromSourceFile(QOpenGLShader::Fragment, ":/shaders/shaders/pointcloud.frag")) {
-        qCritical() << "Failed to compile fragment shader";
-        return;
+
+    // 同步渲染：三维内容渲染到场景缓存，状态没变时直接复用
+    if (!m_renderer) {
+        m_renderer = std::make_unique<PointCloudRenderer>();
+        m_renderer->initialize();
     }
-    if (!m_program->link()) {
-        qCritical() << "Failed to link shader program";
-        return;
+    if (!m_sceneFbo || m_sceneFbo->size() != fboSize) {
+        m_sceneFbo.reset();
+        m_sceneFbo = std::make_unique<QOpenGLFramebufferObject>(fboSize,
+            QOpenGLFramebufferObject::CombinedDepthStencil);
+        m_postedState = PointCloudFrameState();
     }
+    if (!state.sameFrame(m_postedState)) {
+        m_renderer->render(state, m_sceneFbo.get());
+        m_postedState = state;
+    }
+    updateInteractionScale(m_renderer->takeFrameTime());
+    presentSceneFbo(fboSize);
+    handlePickResults(m_renderer->takePickResults());
 
-    // Create VAO/VBO
-    m_vao.create();
-    m_vbo.create();
-    m_vao.bind();
-    m_vbo.bind();
-
-    if (!m_points.empty()) {
-        m_vbo.allocate(m_points.data(),
-            static_cast<int>(m_points.size() * sizeof(float)));
-    }
-
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
-
-    // Unbind
-    m_vbo.release();
-    m_vao.release();
+    // 点云还在分片上传，下一帧继续；拾取结果还没读回时下一帧再查询
+    if (m_renderer->uploadPending()) requestRedraw(eDataDirty);
+    else if (m_renderer->pickPending()) requestRedraw(eFrameDirty);
+}
 
+// 当前相机和数据的快照，渲染器只读取快照
+PointCloudFrameState GLSLViewer::frameState() const
+{
+    const QSize fboSize = size() * devicePixelRatioF();
+    const float scale = (m_dynamicResolution && m_interacting) ? m_interactionScale : 1.0f;
+
+    PointCloudFrameState state;
+    state.dataset = m_dataset;
+    state.projection = m_projection;
+    state.view = m_view;
+    state.renderMode = m_renderMode;
+    state.colormap = m_colormap;
+    state.bboxMin = m_bboxMin;
+    state.bboxMax = m_bboxMax;
+    state.displayMinZ = m_displayMinZ;
+    state.displayMaxZ = m_displayMaxZ;
+    state.pointSize = m_pointSize;
+    state.edl = m_edl;
+    state.holeFill = m_holeFill;
+    state.selection = m_selection;
+    state.clipping = m_clipping;
+    state.deleted = m_dataset ? m_dataset->deletedPoints() : nullptr;
+    state.viewportSize = QSize(m_glWidth, m_glHeight);
+    state.targetSize = fboSize;
+    state.renderSize = QSize(qMax(1, qRound(fboSize.width() * scale)), qMax(1, qRound(fboSize.height() * scale)));
+    state.cameraVersion = m_cameraVersion;
+    state.dataVersion = m_dataVersion;
+    if (m_pickSerial != 0) {
+        state.pick.serial = m_pickSerial;
+        state.pick.pixel = renderPixel(m_pickPos, state.renderSize);
+    }
+    if (m_depthPickSerial != 0) {
+        state.depthPick.serial = m_depthPickSerial;
+        state.depthPick.pixel = renderPixel(m_depthPickPos, state.renderSize);
+    }
+    return state;
 }
-
-void GLSLViewer::renderPointCloud()
+
+// 需要当前上下文为本窗口的上下文
+void GLSLViewer::startRenderThread()
 {
-    if (m_points.empty()) return;
-
-    m_program->bind();
-    m_program->setUniformValue("uProjection", m_projection);
-    m_program->setUniformValue("uView", m_view);
-    m_program->setUniformValue("uRenderMode", m_renderMode);
-    m_program->setUniformValue("uMinZ", m_bboxMin.z());
-    m_program->setUniformValue("uMaxZ", m_bboxMax.z());
+    if (m_renderThread || m_renderThreadFailed || !context()) return;
 
-    m_vao.bind();
-    glDrawArrays(GL_POINTS, 0, static_cast<GLsizei>(m_points.size() / 6));
-
-    m_vao.release();
-    m_program->release();
-}
-
-void GLSLViewer::initScreenAxis()
-{
-    if (m_axisInitialized) return;
-
-    // 1. 创建着色器
-    m_axisShader = new QOpenGLShaderProgram(this);
-
-    // 使用视图矩阵的旋转部分，但固定位置
-    m_axisShader->addShaderFromSourceCode(QOpenGLShader::Vertex,
-        "#version 330 core\n"
-        "layout (location = 0) in vec3 aPos;\n"
-        "layout (location = 1) in vec3 aColor;\n"
-        "uniform mat4 uRotation;      // 只包含旋转的矩阵\n"
-        "uniform vec2 uCorner;        // 角落位置 (0-1)\n"
-        "uniform float uSize;         // 大小 (0-1)\n"
-        "out vec3 vColor;\n"
-        "void main() {\n"
-        "   // 应用旋转\n"
-        "   vec4 rotated = uRotation * vec4(aPos, 1.0);\n"
-        "   \n"
-        "   // 映射到屏幕角落\n"
-        "   vec2 screenPos = uCorner + rotated.xy * uSize;\n"
-        "   \n"
-        "   // 转换到NDC (-1到1)\n"
-        "   vec2 ndc = screenPos * 2.0 - 1.0;\n"
-        "   ndc.y = -ndc.y;  // 翻转Y轴\n"
-        "   \n"
-        "   gl_Position = vec4(ndc, 0.999, 1.0);\n"
-        "   vColor = aColor;\n"
-        "}"
-    );
-
-    m_axisShader->addShaderFromSourceCode(QOpenGLShader::Fragment,
-        "#version 330 core\n"
-        "in vec3 vColor;\n"
-        "out vec4 FragColor;\n"
-        "void main() {\n"
-        "   FragColor = vec4(vColor, 1.0);\n"
-        "}"
-    );
-
-    if (!m_axisShader->link()) return;
-
-    // 2. 准备顶点数据（单位长度的坐标轴）
-    struct Vertex {
-        float x, y, z;
-        float r, g, b;
-    };
-
-    std::vector<Vertex> vertices = {
-        // X轴（红）
-        {0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f},
-        {1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f},
-        // Y轴（绿）
-        {0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f},
-        {0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f},
-        // Z轴（蓝）
-        {0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f},
-        {0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f}
-    };
-
-    m_axisVbo.create();
-    m_axisVbo.bind();
-    m_axisVbo.allocate(vertices.data(),
-        static_cast<int>(vertices.size() * sizeof(Vertex)));
-    m_axisVbo.release();
-
-    m_axisInitialized = true;
-}
-
-void GLSLViewer::renderScreenAxis()
-{
-    if (!m_axisInitialized) return;
-
-    glDisable(GL_DEPTH_TEST);
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-
-    m_axisShader->bind();
-
-    // 从视图矩阵提取旋转（移除平移）
-    QMatrix4x4 rotation = m_view;
-    rotation.setColumn(3, QVector4D(0, 0, 0, 1));
-
-    // 左下角位置和大小
-    QVector2D corner(0.05f, 0.75f);  // 左下角，稍微靠上一点
-    float size = 0.15f;              // 占屏幕的15%
-
-    m_axisShader->setUniformValue("uRotation", rotation);
-    m_axisShader->setUniformValue("uCorner", corner);
-    m_axisShader->setUniformValue("uSize", size);
-
-    // 渲染
-    glLineWidth(2.5f);
-    m_axisVbo.bind();  // 重用现有的坐标轴VBO
-    glEnableVertexAttribArray(0);
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE,
-        sizeof(float) * 6, nullptr);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE,
-        sizeof(float) * 6,
-        reinterpret_cast<void*>(sizeof(float) * 3));
-
-    glDrawArrays(GL_LINES, 0, 6);
-
-    // 清理
-    glDisableVertexAttribArray(0);
-    glDisableVertexAttribArray(1);
-    m_axisVbo.release();
-    m_axisShader->release();
-
-    // 恢复状态
-    glDisable(GL_BLEND);
-    glEnable(GL_DEPTH_TEST);
-
-    // 可选：添加标签
-    renderCornerAxisLabels(rotation);
-}
-
-void GLSLViewer::initScreenAxisOrtho()
-{
-    if (m_axisInitialized) return;
-
-    // 1. 创建着色器（使用正交投影矩阵）
-    m_axisShader = new QOpenGLShaderProgram(this);
-
-    m_axisShader->addShaderFromSourceCode(QOpenGLShader::Vertex,
-        "#version 330 core\n"
-        "layout (location = 0) in vec3 aPos;\n"
-        "layout (location = 1) in vec3 aColor;\n"
-        "uniform mat4 uProjection;\n"
-        "out vec3 vColor;\n"
-        "void main() {\n"
-        "   gl_Position = uProjection * vec4(aPos, 1.0);\n"
-        "   vColor = aColor;\n"
-        "}"
-    );
-
-    m_axisShader->addShaderFromSourceCode(QOpenGLShader::Fragment,
-        "#version 330 core\n"
-        "in vec3 vColor;\n"
-        "out vec4 FragColor;\n"
-        "void main() {\n"
-        "   FragColor = vec4(vColor, 1.0);\n"
-        "}"
-    );
-
-    if (!m_axisShader->link()) {
-        qWarning() << "Screen axis shader link failed:" << m_axisShader->log();
+    auto thread = std::make_unique<PointCloudRenderThread>();
+    if (!thread->startRendering(context())) {
+        qWarning() << "Render thread unavailable, rendering on the GUI thread";
+        m_renderThreadFailed = true;
         return;
     }
+    connect(thread.get(), &PointCloudRenderThread::frameReady, this, &GLSLViewer::onFrameReady);
+    connect(thread.get(), &PointCloudRenderThread::pickReady, this, &GLSLViewer::onPickReady);
+    m_renderThread = std::move(thread);
+    // 新线程没有任何帧，下次绘制时重新提交
+    m_postedState = PointCloudFrameState();
+}
 
-    // --- 2. 构建顶点数据：轴线 + 字母（Z/X/Y）---
-    struct Vertex {
-        float x, y, z;
-        float r, g, b;
-    };
-    std::vector<Vertex> vertices;
-
-    const float L = 30.0f; // 轴长度
-    const float W = 5.0f;  // 字母大小
-
-    // ---- Z 轴（蓝色）----
-    // 轴线
-    vertices.push_back({ 0, 0, 0, 0, 0, 1 });
-    vertices.push_back({ 0, 0, L, 0, 0, 1 });
-    // 字母 "Z"（在 Z=L 平面）
-    vertices.push_back({ -W,  W, L, 0, 0, 1 });
-    vertices.push_back({ W,  W, L, 0, 0, 1 });
-    vertices.push_back({ W,  W, L, 0, 0, 1 });
-    vertices.push_back({ -W, -W, L, 0, 0, 1 });
-    vertices.push_back({ -W, -W, L, 0, 0, 1 });
-    vertices.push_back({ W, -W, L, 0, 0, 1 });
-
-    // ---- X 轴（红色）----
-    // 轴线
-    vertices.push_back({ 0, 0, 0, 1, 0, 0 });
-    vertices.push_back({ L, 0, 0, 1, 0, 0 });
-    // 字母 "X"
-    vertices.push_back({ L + W,  W, 0, 1, 0, 0 });
-    vertices.push_back({ L - W, -W, 0, 1, 0, 0 });
-    vertices.push_back({ L + W, -W, 0, 1, 0, 0 });
-    vertices.push_back({ L - W,  W, 0, 1, 0, 0 });
-
-    // ---- Y 轴（绿色）----
-    // 轴线
-    vertices.push_back({ 0, 0, 0, 0, 1, 0 });
-    vertices.push_back({ 0, L, 0, 0, 1, 0 });
-    // 字母 "Y"
-    vertices.push_back({ 0, L + W, 0, 0, 1, 0 });
-    vertices.push_back({ 0, L + W + 5, 0, 0, 1, 0 });
-    vertices.push_back({ 0, L + W + 5, 0, 0, 1, 0 });
-    vertices.push_back({ -W, L + W + 10, 0, 0, 1, 0 });
-    vertices.push_back({ 0, L + W + 5, 0, 0, 1, 0 });
-    vertices.push_back({ W, L + W + 10, 0, 0, 1, 0 });
-
-    // 3. 创建VBO VAO
-    m_axisVao.create();
-    m_axisVao.bind();
-    m_axisVbo.create();
-    m_axisVbo.bind();
-    m_axisVbo.allocate(vertices.data(),
-        static_cast<int>(vertices.size() * sizeof(vertices)));
-
-    glEnableVertexAttribArray(0);
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE,
-        sizeof(float) * 6, nullptr);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE,
-        sizeof(float) * 6,
-        reinterpret_cast<void*>(sizeof(float) * 3));
-    m_axisVbo.release();
-    m_axisVao.release();
-
-    m_axisInitialized = true;
-}
-
-void GLSLViewer::renderScreenAxisOrtho()
-{
-    if (!m_axisInitialized) return;
-
-    glDisable(GL_DEPTH_TEST);
-    glLineWidth(3.0f);
-    glEnable(GL_LINE_SMOOTH);
-
-    // 创建正交投影矩阵（覆盖整个屏幕）
-    // 屏幕左下角偏移（像素）
-    float margin = 50.0f;
-    float posX = -static_cast<float>(m_glWidth) / 2.0f + margin;
-    float posY = -static_cast<float>(m_glHeight) / 2.0f + margin;
-
-    // 构建正交投影（像素空间）
-    QMatrix4x4 ortho;
-    ortho.setToIdentity();
-    ortho.ortho(
-        -static_cast<float>(m_glWidth) / 2.0f,
-        static_cast<float>(m_glWidth) / 2.0f,
-        -static_cast<float>(m_glHeight) / 2.0f,
-        static_cast<float>(m_glHeight) / 2.0f,
-        -1000.0f, 1000.0f
-    );
-
-    QMatrix4x4 viewMatrix = m_view; // 假设这是你的视图矩阵
-    QMatrix3x3 rotationMatrix = viewMatrix.normalMatrix(); // 获取用于法线变换的3x3子矩阵，实际上就是旋转部分
-    // 创建坐标轴的模型矩阵
-    QMatrix4x4 modelMatrix;
-    modelMatrix.setToIdentity(); // 初始化为单位矩阵
-
-    // 将提取的旋转应用到模型矩阵上
-    // 注意，这里可能需要根据实际情况调整旋转的方向或顺序
-    modelMatrix.rotate(QQuaternion::fromRotationMatrix(rotationMatrix));
-    //平移到posX posY
-    QMatrix4x4 model;
-    model.translate(posX, posY, 0.0f);
-    QMatrix4x4 mvp = ortho * model * modelMatrix;
-
-    // 渲染
-    m_axisShader->bind();
-    m_axisShader->setUniformValue("uProjection", mvp);
-
-    m_axisVao.bind();
-    glDrawArrays(GL_LINES, 0, 24);
-
-    // 清理
-    m_axisVao.release();
-    m_axisShader->release();
-}
-
-void GLSLViewer::renderCornerAxisLabels(const QMatrix4x4& rotation)
+void GLSLViewer::stopRenderThread()
 {
-    QPainter painter(this);
-    painter.setRenderHint(QPainter::Antialiasing);
-
-    // 计算标签位置（屏幕坐标）
-    int axisSize = width() * 0.15f;
-    int startX = width() * 0.05f;
-    int startY = height() * 0.75f;
-
-    // 应用相同的旋转到单位向量
-    QVector3D xDir = rotation.map(QVector3D(1, 0, 0));
-    QVector3D yDir = rotation.map(QVector3D(0, 1, 0));
-    QVector3D zDir = rotation.map(QVector3D(0, 0, 1));
+    if (!m_renderThread) return;
+
+    m_renderThread->stopRendering();
+    m_renderThread.reset();
+    m_postedState = PointCloudFrameState();
+    // 在途的拾取随线程丢弃
+    m_pickPending = false;
+    m_depthPickPending = false;
+}
 
-    // 绘制标签
-    painter.setPen(Qt::red);
-    painter.drawText(startX + xDir.x() * axisSize + 10,
-        startY - xDir.y() * axisSize, "X");
+// 渲染线程完成一帧（排队连接，在 GUI 线程中执行）
+void GLSLViewer::onFrameReady()
+{
+    if (!m_renderThread) return;
 
-    painter.setPen(Qt::green);
-    painter.drawText(startX + yDir.x() * axisSize + 10,
-        startY - yDir.y() * axisSize, "Y");
+    updateInteractionScale(m_renderThread->takeFrameTime());
+    requestRedraw(eFrameDirty);
+}
 
-    painter.setPen(Qt::blue);
-    painter.drawText(startX + zDir.x() * axisSize + 10,
-        startY - zDir.y() * axisSize, "Z");
+// 渲染线程读回了拾取结果（排队连接）
+void GLSLViewer::onPickReady()
+{
+    if (!m_renderThread) return;
 
-    painter.end();
+    handlePickResults(m_renderThread->takePickResults());
 }
 
-void GLSLViewer::updateBoundingBoxGeometry()
-{
-    if (m_points.empty()) return;
-
-    // 使用世界坐标系的实际顶点创建边界盒
-    float minX = m_bboxMin.x();
-    float minY = m_bboxMin.y();
-    float minZ = m_bboxMin.z();
-    float maxX = m_bboxMax.x();
-    float maxY = m_bboxMax.y();
-    float maxZ = m_bboxMax.z();
-
-    // 边界盒的8个顶点（世界坐标）
-    m_boxVertices = {
-        // 底面4个顶点
-        minX, minY, minZ,  // 0: 左前下
-        maxX, minY, minZ,  // 1: 右前下
-        maxX, maxY, minZ,  // 2: 右后下
-        minX, maxY, minZ,  // 3: 左后下
-
-        // 顶面4个顶点
-        minX, minY, maxZ,  // 4: 左前上
-        maxX, minY, maxZ,  // 5: 右前上
-        maxX, maxY, maxZ,  // 6: 右后上
-        minX, maxY, maxZ   // 7: 左后上
-    };
-
-    // 12条边的索引（24个索引）
-    m_boxIndices = {
-        // 底面矩形
-        0, 1,  // 底面前边
-        1, 2,  // 底面右边
-        2, 3,  // 底面后边
-        3, 0,  // 底面左边
-
-        // 顶面矩形
-        4, 5,  // 顶面前边
-        5, 6,  // 顶面右边
-        6, 7,  // 顶面后边
-        7, 4,  // 顶面左边
-
-        // 垂直边
-        0, 4,  // 左前垂直边
-        1, 5,  // 右前垂直边
-        2, 6,  // 右后垂直边
-        3, 7   // 左后垂直边
-    };
-
-    // 如果VBO已经创建，更新数据
-    if (m_boxInitialized) {
-        makeCurrent();
-
-        // 更新顶点数据
-        m_boxVbo.bind();
-        m_boxVbo.allocate(m_boxVertices.data(),
-            static_cast<int>(m_boxVertices.size() * sizeof(float)));
-        m_boxVbo.release();
-
-        // 如果有EBO，更新索引数据
-        doneCurrent();
-    }
-}
-
-void GLSLViewer::initBoundingBoxGeometry()
-{
-    if (m_boxInitialized) return;
-
-    // 1. 创建着色器
-    m_boxShader = new QOpenGLShaderProgram(this);
-    m_boxShader->addShaderFromSourceCode(QOpenGLShader::Vertex,
-        "#version 330 core\n"
-        "layout (location = 0) in vec3 aPos;\n"
-        "uniform mat4 uMVP;\n"
-        "void main() {\n"
-        "   gl_Position = uMVP * vec4(aPos, 1.0);\n"
-        "}"
-    );
-    m_boxShader->addShaderFromSourceCode(QOpenGLShader::Fragment,
-        "#version 330 core\n"
-        "out vec4 FragColor;\n"
-        "uniform vec3 uColor;\n"
-        "uniform float uAlpha;\n"
-        "void main() {\n"
-        "   FragColor = vec4(uColor, uAlpha);\n"
-        "}"
-    );
-
-    if (!m_boxShader->link()) {
-        qWarning() << "Box shader link failed:" << m_boxShader->log();
+// 把渲染线程最新完成的一帧复制（必要时线性放大）到窗口的帧缓冲，叠加层随后在 paintEvent 中绘制
+void GLSLViewer::presentThreadFrame(const QSize& fboSize)
+{
+    PointCloudRenderThread::Frame* frame = m_renderThread->latestFrame();
+    if (!frame || !frame->texture) {
+        // 第一帧还没有完成
+        glBindFramebuffer(GL_FRAMEBUFFER, defaultFramebufferObject());
+        glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
         return;
     }
 
-    // 2. 初始化为空数据，稍后由 updateBoundingBoxGeometry 填充
-    m_boxVao.create();
-    m_boxVao.bind();
-    m_boxVbo.create();
-    m_boxVbo.bind();
+    // 等渲染线程的命令执行完再读纹理（GPU 端等待）
+    if (frame->renderDone) {
+        glWaitSync(frame->renderDone, 0, GL_TIMEOUT_IGNORED);
+        glDeleteSync(frame->renderDone);
+        frame->renderDone = nullptr;
+    }
 
-    m_boxVbo.setUsagePattern(QOpenGLBuffer::DynamicDraw);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), nullptr);
-    m_boxInitialized = true;
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, m_presentFbo);
+    glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, frame->texture, 0);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, defaultFramebufferObject());
+    glBlitFramebuffer(0, 0, frame->renderSize.width(), frame->renderSize.height(),
+        0, 0, fboSize.width(), fboSize.height(), GL_COLOR_BUFFER_BIT,
+        frame->renderSize == fboSize ? GL_NEAREST : GL_LINEAR);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, m_presentFbo);
+    glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, 0, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, defaultFramebufferObject());
+
+    // 渲染线程覆盖这块纹理前等待复制完成
+    if (frame->readDone) glDeleteSync(frame->readDone);
+    frame->readDone = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    glFlush();
+
+    reportFirstFrame();
 }
 
+void GLSLViewer::presentSceneFbo(const QSize& fboSize)
+{
+    // 合成：把场景缓存复制（必要时线性放大）到窗口的帧缓冲，叠加层随后在 paintEvent 中绘制
+    const QSize renderSize = m_postedState.renderSize;
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, m_sceneFbo->handle());
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, defaultFramebufferObject());
+    glBlitFramebuffer(0, 0, renderSize.width(), renderSize.height(),
+        0, 0, fboSize.width(), fboSize.height(), GL_COLOR_BUFFER_BIT,
+        renderSize == fboSize ? GL_NEAREST : GL_LINEAR);
+    glBindFramebuffer(GL_FRAMEBUFFER, defaultFramebufferObject());
+
+    reportFirstFrame();
+}
 
-void GLSLViewer::renderBoundingBox()
+void GLSLViewer::reportFirstFrame()
 {
-    if (!m_boxInitialized || m_boxVertices.empty() || m_points.empty()) {
-        qDebug() << "Cannot render bounding box: not initialized or empty";
-        return;
-    }
+    if (m_firstFramePresented) return;
 
-    qDebug() << "Rendering bounding box with" << m_boxVertices.size() / 3 << "vertices";
+    m_firstFramePresented = true;
+    qDebug() << "Time to first frame:" << m_firstFrameTimer.elapsed() << "ms";
+}
 
-    // 保存当前状态
-    GLboolean depthMask;
-    glGetBooleanv(GL_DEPTH_WRITEMASK, &depthMask);
+// 根据换算到全分辨率的场景耗时调整交互时的渲染比例
+// 填充开销与像素数成正比，比例取 sqrt(目标帧时间 / 全分辨率帧时间)
+void GLSLViewer::updateInteractionScale(double fullFrameMs)
+{
+    if (fullFrameMs <= 0.0) return;
 
-    // 禁用深度写入，确保边界盒始终可见
-    glDepthMask(GL_FALSE);
+    const float target = static_cast<float>(qBound(kMinRenderScale, std::sqrt(kTargetFrameMs / fullFrameMs), 1.0));
+    // 平滑，避免比例来回跳动
+    m_interactionScale = qBound(static_cast<float>(kMinRenderScale), 0.5f * (m_interactionScale + target), 1.0f);
+}
 
-    // 启用混合，使边界盒半透明
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+// 拖动或缩放时调用；停止操作一段时间后恢复原始分辨率
+void GLSLViewer::beginInteraction()
+{
+    m_interacting = true;
+    m_settleTimer.start();
+}
 
-    // 设置线条渲染
-    glEnable(GL_LINE_SMOOTH);
-    glHint(GL_LINE_SMOOTH_HINT, GL_NICEST);
-    glLineWidth(3.0f); // 更粗的线
+void GLSLViewer::endInteraction()
+{
+    m_interacting = false;
+    // 交互时降过分辨率：渲染尺寸属于帧状态，重绘时会按原始分辨率重画场景
+    if (m_postedState.renderSize != m_postedState.targetSize) requestRedraw(eOverlayDirty);
+}
 
-    m_boxShader->bind();
+void GLSLViewer::setDynamicResolution(bool enabled)
+{
+    m_dynamicResolution = enabled;
+}
 
-    // 设置MVP矩阵
-    QMatrix4x4 mvp = m_projection * m_view;
-    m_boxShader->setUniformValue("uMVP", mvp);
-    m_boxShader->setUniformValue("uColor", QVector3D(1.0f, 0.5f, 0.0f)); // 橙色
-    m_boxShader->setUniformValue("uAlpha", 0.8f); // 80%不透明度
+void GLSLViewer::mousePressEvent(QMouseEvent* event)
+{
+    m_lastMousePos = event->pos();
+    m_pressPos = event->pos();
+    m_rangeDrag = eNoRangeDrag;
+
+    // 在颜色条上拖动编辑显示范围：两端各 8 像素调整上下限，中间平移
+    if (event->button() == Qt::LeftButton && m_showColorBar && hasPoints()) {
+        const QRect bar = colorBarRect();
+        if (bar.adjusted(-4, -6, 4, 6).contains(event->pos())) {
+            const int handle = 8;
+            if (event->pos().y() < bar.top() + handle) m_rangeDrag = eDragMax;
+            else if (event->pos().y() > bar.bottom() - handle) m_rangeDrag = eDragMin;
+            else m_rangeDrag = eDragShift;
+            m_rangeDragStartY = event->pos().y();
+            m_rangeDragStartMin = m_displayMinZ;
+            m_rangeDragStartMax = m_displayMaxZ;
+        }
+    }
 
-    // 绑定顶点数据
-    m_boxVao.bind();
-    // 绘制所有边
-    glDrawElements(GL_LINES,
-        static_cast<GLsizei>(m_boxIndices.size()),
-        GL_UNSIGNED_INT,
-        m_boxIndices.data());
-    m_boxVao.release();
-    m_boxShader->release();
+    // 选择工具打开时左键拖动画选择形状，不旋转
+    if (event->button() == Qt::LeftButton && m_rangeDrag == eNoRangeDrag && m_selectionTool != eSelectNone && hasPoints()) {
+        m_selecting = true;
+        m_selectionShape = QPolygon() << event->pos();
+        return;
+    }
 
-    // 恢复渲染状态
-    glLineWidth(1.0f);
-    glDepthMask(GL_TRUE);
-    glDisable(GL_BLEND);
+    // 动态旋转中心：按下时读取光标处的深度，结果通常在下一帧到达，之后的拖动绕该点旋转
+    if (event->button() == Qt::LeftButton && m_rangeDrag == eNoRangeDrag && m_dynamicPivot && hasPoints()) {
+        m_orbiting = true;
+        requestDepthPick(event->pos());
+    }
 }
 
+void GLSLViewer::mouseReleaseEvent(QMouseEvent* event)
+{
+    if (m_selecting && event->button() == Qt::LeftButton) {
+        // 几乎没有移动视为单击，形状为空
+        if ((event->pos() - m_pressPos).manhattanLength() <= 3) m_selectionShape.clear();
+        applySelection(event->modifiers());
+        m_selecting = false;
+        m_selectionShape.clear();
+        requestRedraw(eOverlayDirty);
+        return;
+    }
 
+    // 量测时左键单击（几乎没有移动）拾取点，拖动只旋转视图；颜色条上的操作不拾取
+    if (event->button() == Qt::LeftButton && m_measureMode != eMeasureNone && m_rangeDrag == eNoRangeDrag
+        && (event->pos() - m_pressPos).manhattanLength() <= 3) {
+        requestPick(event->pos());
+    }
+    m_rangeDrag = eNoRangeDrag;
+    if (m_orbiting && event->button() == Qt::LeftButton) {
+        m_orbiting = false;
+        requestRedraw(eOverlayDirty);
+    }
+}
 
-
-void GLSLViewer::mousePressEvent(QMouseEvent* event)
+void GLSLViewer::mouseDoubleClickEvent(QMouseEvent* event)
 {
-    m_lastMousePos = event->pos();
+    // 双击颜色条恢复 1%–99% 分位数范围
+    if (m_showColorBar && hasPoints() && colorBarRect().adjusted(-4, -6, 4, 6).contains(event->pos())) {
+        resetElevationRange();
+    }
 }
 
 void GLSLViewer::mouseMoveEvent(QMouseEvent* event)
 {
+    if (m_rangeDrag != eNoRangeDrag) {
+        // 按开始拖动时的比例换算，颜色条高度对应原来的显示范围
+        const float span = std::max(m_rangeDragStartMax - m_rangeDragStartMin, 1e-6f);
+        const float delta = -(event->pos().y() - m_rangeDragStartY) * span / std::max(1, colorBarRect().height());
+        float minZ = m_rangeDragStartMin;
+        float maxZ = m_rangeDragStartMax;
+        if (m_rangeDrag != eDragMax) minZ += delta;
+        if (m_rangeDrag != eDragMin) maxZ += delta;
+        // 拖动单端时保持上下限的顺序
+        const float minSpan = span * 0.01f;
+        if (m_rangeDrag == eDragMin) minZ = std::min(minZ, maxZ - minSpan);
+        if (m_rangeDrag == eDragMax) maxZ = std::max(maxZ, minZ + minSpan);
+
+        m_displayMinZ = minZ;
+        m_displayMaxZ = maxZ;
+        m_rangePercentiles = false;
+        requestRedraw(eDataDirty | eOverlayDirty);
+        m_lastMousePos = event->pos();
+        return;
+    }
+
+    if (m_selecting) {
+        // 矩形只保留起点和当前点；套索移动超过 2 像素才加点
+        if (m_selectionTool == eSelectRectangle) {
+            if (m_selectionShape.size() < 2) m_selectionShape << event->pos();
+            else m_selectionShape.last() = event->pos();
+        }
+        else if ((event->pos() - m_selectionShape.last()).manhattanLength() >= 2) {
+            m_selectionShape << event->pos();
+        }
+        requestRedraw(eOverlayDirty);
+        m_lastMousePos = event->pos();
+        return;
+    }
+
     if (event->buttons() & Qt::LeftButton) {
         float dx = event->pos().x() - m_lastMousePos.x();
         float dy = event->pos().y() - m_lastMousePos.y();
-        m_yaw += dx * 0.3f;
-        m_pitch = qBound(-89.0f, m_pitch - dy * 0.3f, 89.0f);
-        updateCamera();
-        update();
+        beginInteraction();
+        orbit(dx * 0.3f, -dy * 0.3f);
     }
     m_lastMousePos = event->pos();
 }
@@ -813,25 +1197,52 @@ void GLSLViewer::wheelEvent(QWheelEvent* event)
     }
     m_distance = std::exp(m_logDistance);
     m_distance = std::max(0.01f, m_distance); // 仅限制最小值
+    beginInteraction();
     updateCamera();
-    update();
 }
 
 
+// 相机朝向（世界到相机的旋转）：沿球坐标方向看向注视点
+QMatrix4x4 GLSLViewer::orbitRotation(float yaw, float pitch)
+{
+    const double yawRad = qDegreesToRadians(static_cast<double>(yaw));
+    const double pitchRad = qDegreesToRadians(static_cast<double>(pitch));
+    const QVector3D dir(static_cast<float>(std::cos(pitchRad) * std::cos(yawRad)),
+        static_cast<float>(std::sin(pitchRad)),
+        static_cast<float>(std::cos(pitchRad) * std::sin(yawRad)));
+
+    QMatrix4x4 rotation;
+    rotation.lookAt(QVector3D(0.0f, 0.0f, 0.0f), -dir, QVector3D(0.0f, 1.0f, 0.0f));
+    return rotation;
+}
+
+// 整个相机（位置、朝向、注视点）绕旋转中心转动，旋转中心在屏幕上的位置保持不变
+// 旋转中心就是注视点时与原来绕中心旋转相同
+void GLSLViewer::orbit(float deltaYaw, float deltaPitch)
+{
+    const QMatrix4x4 before = orbitRotation(m_yaw, m_pitch);
+    m_yaw += deltaYaw;
+    m_pitch = qBound(-89.0f, m_pitch + deltaPitch, 89.0f);
+    const QMatrix4x4 after = orbitRotation(m_yaw, m_pitch);
+
+    // 世界空间中的旋转 R = after^T * before（纯旋转矩阵的逆为转置）
+    const QMatrix4x4 rotation = after.transposed() * before;
+    m_center = m_pivot + rotation.mapVector(m_center - m_pivot);
+    updateCamera();
+}
+
 void GLSLViewer::updateCamera()
 {
     // 相机位置：从中心点出发，沿球坐标方向后退 m_distance
-    float yawRad = qDegreesToRadians(m_yaw);
-    float pitchRad = qDegreesToRadians(m_pitch);
-
-    float x = m_center.x() + m_distance * cos(pitchRad) * cos(yawRad);
-    float y = m_center.y() + m_distance * sin(pitchRad);
-    float z = m_center.z() + m_distance * cos(pitchRad) * sin(yawRad);
+    // 所有坐标都相对数据的局部原点（加载时以双精度减去），数值与数据范围同量级，float 足够
+    const QMatrix4x4 rotation = orbitRotation(m_yaw, m_pitch);
+    const QVector3D back = rotation.row(2).toVector3D();   // 相机 +z 轴，即视线的反方向
+    const QVector3D eye = m_center + m_distance * back;
 
-    QVector3D cameraPos(x, y, z);
-    QVector3D target = m_center;
-    QVector3D up(0, 1, 0);
+    // 视图矩阵 = 旋转 * 平移(-eye)
+    m_view = rotation;
+    m_view.translate(-eye);
 
-    m_view.setToIdentity();
-    m_view.lookAt(cameraPos, target, up);
+    updateProjection();
+    requestRedraw(eCameraDirty);
 }
@@ -1,10 +1,15 @@
 #pragma once
 
 #include "glslviewer_global.h"
+#include "PointCloudData.h"
+#include "PointCloudStats.h"
+#include "PointCloudDataset.h"
+#include "PointCloudRenderer.h"
+#include "PointCloudColormap.h"
+#include "PointCloudSelection.h"
 
 #include <QOpenGLWidget>
 #include <QOpenGLFunctions_3_3_Core>
-#include <QOpenGLShaderProgram>
 #include <QMatrix4x4>
 #include <QVector3D>
 #include <QMouseEvent>
@@ -12,9 +17,15 @@
 #include <QFile>
 #include <QTextStream>
 #include <vector>
+#include <memory>
 #include <limits>
-#include <QOpenGLBuffer>
-#include <QOpenGLVertexArrayObject>
+#include <QOpenGLFramebufferObject>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QPainter>
+#include <QPolygon>
+
+class PointCloudRenderThread;
 
 class GLSLVIEWER_EXPORT GLSLViewer : public QOpenGLWidget, protected QOpenGLFunctions_3_3_Core
 {
@@ -27,6 +38,112 @@ public:
     void loadPointCloud(const QString& filename);
     void setRenderMode(int mode); // 0: elevation, 1: RGB
     void resetView();
+
+    // 窗口被激活时调用（MDI 切换），用于内存预算的最近使用记录
+    void activate();
+
+    // 高程色带，着色器和颜色条使用同一张查找表；切换色带不重新上传点数据
+    void setColormap(std::shared_ptr<const PointCloudColormap> colormap);
+    std::shared_ptr<const PointCloudColormap> colormap() const { return m_colormap; }
+
+    // 高程显示范围（真实高程），色带铺满这个范围，超出部分取两端颜色
+    // 加载后默认取 1%–99% 分位数；也可以在颜色条上拖动两端或中间交互调整，双击恢复
+    // 只改变着色器 uniform，不重新上传点数据
+    void setElevationRange(double minZ, double maxZ);
+    void elevationRange(double& minZ, double& maxZ) const;
+    // 按分位数（百分比）设置显示范围，并行统计
+    bool setElevationPercentiles(double lowPercent, double highPercent);
+    void resetElevationRange();
+
+    // 点大小：默认按加载时估计的点间距自适应，可改为固定大小
+    void setPointSize(const PointCloudPointSizeSettings& settings);
+    const PointCloudPointSizeSettings& pointSize() const { return m_pointSize; }
+
+    // 视觉着色（Eye-Dome Lighting）：按点云深度缓冲做屏幕空间明暗，无需法线即可看出三维结构
+    void setEyeDomeLighting(const PointCloudEdlSettings& settings);
+    const PointCloudEdlSettings& eyeDomeLighting() const { return m_edl; }
+
+    // 屏幕空间补洞：点稀疏或放大查看时用相邻像素填满点之间的空隙，只补被点包围的空洞
+    void setHoleFilling(const PointCloudHoleFillSettings& settings);
+    const PointCloudHoleFillSettings& holeFilling() const { return m_holeFill; }
+
+    // 旋转中心：默认绕包围盒中心旋转；开启动态旋转中心后，左键按下时读取光标处画面的深度，
+    // 反投影得到的点作为旋转中心（深度经 PBO 异步读回，不等待 GPU），点击背景时保留原来的中心
+    void setDynamicPivot(bool enabled);
+    bool dynamicPivot() const { return m_dynamicPivot; }
+
+    // 动态分辨率：拖动和缩放时按测得的帧时间降低场景分辨率，停止后恢复
+    void setDynamicResolution(bool enabled);
+    bool dynamicResolution() const { return m_dynamicResolution; }
+
+    // 当前点云（导出等后台任务持有引用，窗口关闭后数据仍然有效）
+    std::shared_ptr<const PointCloudData> pointCloud() const { return m_dataset ? m_dataset->cloud() : nullptr; }
+    const PointCloudStats& statistics() const { return m_stats; }
+    bool hasPoints() const { return m_dataset && m_dataset->pointCount() > 0; }
+
+    // 当前数据集（可能与其它窗口共享）
+    std::shared_ptr<PointCloudDataset> dataset() const { return m_dataset; }
+
+    // 量测工具：单击拾取画面上可见的点（GPU 点序号缓冲，不在 CPU 上搜索），拖动仍然旋转视图
+    enum MeasureMode
+    {
+        eMeasureNone,
+        eMeasurePoint,      // 点坐标
+        eMeasureDistance    // 两点距离
+    };
+    void setMeasureMode(MeasureMode mode);
+    MeasureMode measureMode() const { return m_measureMode; }
+    void clearMeasurement();
+
+    // 选择工具：左键拖动画矩形或套索，选中投影落在形状内的点（包括被遮挡的点），按块并行判断
+    // Shift 加选，Ctrl 减选，否则替换原来的选择；选择工具打开时左键不旋转视图
+    // 选中的点高亮显示，选择变化时渲染器只更新变化的块
+    enum SelectionTool
+    {
+        eSelectNone,
+        eSelectRectangle,
+        eSelectLasso
+    };
+    void setSelectionTool(SelectionTool tool);
+    SelectionTool selectionTool() const { return m_selectionTool; }
+    void clearSelection();
+    std::shared_ptr<const PointCloudSelection> selection() const { return m_selection; }
+    size_t selectedCount() const { return m_selection ? m_selection->selectedCount() : 0; }
+    // 视图对准选中的点：注视点和旋转中心移到选中点的包围盒中心，距离按包围盒大小调整
+    bool centerOnSelection();
+
+    // 裁剪：最多 PointCloudClipping::kMaxBoxes 个裁剪盒、kMaxPlanes 个剖切面，在顶点着色器中剔除，
+    // 渲染器按块跳过整块被裁掉的点；不复制、不修改点数据，修改后只需重画
+    // 被裁掉的点不能拾取和选择；需要保存裁剪结果时用 PointCloudClipping::bake 生成新的点云
+    void setClipping(const PointCloudClipping& clipping);
+    std::shared_ptr<const PointCloudClipping> clipping() const { return m_clipping; }
+    void clearClipping();
+    // 用选中点的包围盒添加裁剪盒：keepInside 时只显示盒内的点，否则隐藏盒内的点；用过的选择清空
+    bool clipToSelection(bool keepInside);
+    // 过旋转中心、垂直于视线的剖切面，隐藏旋转中心靠近相机一侧的点
+    bool addViewClipPlane();
+    void invertClipping();
+
+    // 删除：删除选中的点，只记录删除标记，可撤销、重做；删除的点不显示、不能拾取和选择，统计和导出都跳过
+    // 数据集被多个窗口共享，删除对所有窗口生效，其它窗口收到 pointsEdited 后调用 refreshEdits()
+    // 删除的点达到 kCompactRatio 且 kCompactIdleMs 内没有再编辑时在后台压缩（真正移除），之后不能撤销
+    bool deleteSelection();
+    bool undoEdit();
+    bool redoEdit();
+    size_t deletedCount() const { return m_dataset ? m_dataset->deletedCount() : 0; }
+    // 数据集的删除标记或点数变化后重画，统计量已更新时刷新包围盒
+    void refreshEdits();
+
+signals:
+    // 拾取到点（真实坐标）
+    void pointPicked(double x, double y, double z);
+    // 两点距离量测完成，d 为真实坐标的差
+    void distanceMeasured(double distance, double dx, double dy, double dz);
+    // 选择变化
+    void selectionChanged(qulonglong selectedCount, qulonglong pointCount);
+    // 删除、撤销、重做或压缩改变了数据集，以及删除后的统计量计算完成
+    void pointsEdited();
+
 protected:
     void initializeGL() override;
     void resizeGL(int w, int h) override;
@@ -34,25 +151,95 @@ protected:
 
     void mousePressEvent(QMouseEvent* event) override;
     void mouseMoveEvent(QMouseEvent* event) override;
+    void mouseReleaseEvent(QMouseEvent* event) override;
+    void mouseDoubleClickEvent(QMouseEvent* event) override;
     void wheelEvent(QWheelEvent* event) override;
 
     void paintEvent(QPaintEvent* event) override;
+    void showEvent(QShowEvent* event) override;
+    void hideEvent(QHideEvent* event) override;
 private:
+    // 按需绘制：只有相机、数据或叠加层变化时才重绘
+    enum RedrawFlag
+    {
+        eCameraDirty = 0x1,    // 相机变化，三维内容需要重画
+        eDataDirty = 0x2,      // 数据或渲染模式变化，三维内容需要重画
+        eOverlayDirty = 0x4,   // 颜色条等二维叠加层
+        eFrameDirty = 0x8,     // 渲染线程完成了新的一帧，需要呈现
+        eRedrawAll = eCameraDirty | eDataDirty | eOverlayDirty | eFrameDirty
+    };
+    int m_dirty = eRedrawAll;
+
+    void requestRedraw(int flags);
+    bool isRenderable() const;
+    void releaseTransientTargets();
+
+    // 场景渲染：默认在渲染线程中进行，窗口只呈现最新完成的一帧
+    // 渲染线程不可用时退回到窗口上下文中同步渲染到场景缓存
+    // 场景按相机和数据版本失效，叠加层变化时只复制已有的帧
+    std::unique_ptr<PointCloudRenderThread> m_renderThread;
+    bool m_renderThreadFailed = false;
+    GLuint m_presentFbo = 0;    // 挂载渲染线程的纹理用于复制，FBO 不能跨上下文共享
+
+    std::unique_ptr<PointCloudRenderer> m_renderer;   // 同步渲染
+    std::unique_ptr<QOpenGLFramebufferObject> m_sceneFbo;
+
+    quint64 m_cameraVersion = 0;
+    quint64 m_dataVersion = 0;
+    PointCloudFrameState m_postedState;   // 最近一次交给渲染器的状态
+
+    PointCloudFrameState frameState() const;
+    void startRenderThread();
+    void stopRenderThread();
+    void onFrameReady();
+    void onPickReady();
+    void presentThreadFrame(const QSize& fboSize);
+    void presentSceneFbo(const QSize& fboSize);
+
+    // 新建窗口到第一次呈现场景的耗时，用于评估着色器缓存等启动开销
+    QElapsedTimer m_firstFrameTimer;
+    bool m_firstFramePresented = false;
+    void reportFirstFrame();
+
+    // 动态分辨率
+    static constexpr double kTargetFrameMs = 16.0;
+    static constexpr double kMinRenderScale = 0.25;
+    bool m_dynamicResolution = true;
+    bool m_interacting = false;
+    float m_interactionScale = 1.0f;   // 交互时的渲染比例，随帧时间调整并在交互之间保留
+    QTimer m_settleTimer;
+
+    void updateInteractionScale(double fullFrameMs);
+    void beginInteraction();
+    void endInteraction();
+    void paintOverlay(QPainter& painter);
+    void paintColorBar(QPainter& painter);
+    void paintMeasurement(QPainter& painter);
+    void paintSelectionShape(QPainter& painter);
+    void applySelection(Qt::KeyboardModifiers modifiers);
+    void finishEdit();
+    void applyEditedStatistics();
+    void compactDataset();
+    bool projectToWidget(const QVector3D& local, QPointF& pos) const;
+
+    void requestPick(const QPoint& pos);
+    void requestDepthPick(const QPoint& pos);
+    QPoint renderPixel(const QPoint& pos, const QSize& renderSize) const;
+    void handlePickResults(const std::vector<PointCloudPickResult>& results);
+    QRect colorBarRect() const;
+
     void updateCamera();
+    void orbit(float deltaYaw, float deltaPitch);
+    static QMatrix4x4 orbitRotation(float yaw, float pitch);
+    void paintPivot(QPainter& painter);
+    void updateProjection();
+    void updateStatistics();
 
     int m_glWidth;
     int m_glHeight;
 
-    //
-    QOpenGLShaderProgram* m_program = nullptr;
-    QOpenGLVertexArrayObject m_vao;
-    QOpenGLBuffer m_vbo;
-
-    void initPointCloud();
-    void renderPointCloud();
-
-    //
-    std::vector<float> m_points; // [x, y, z, r, g, b]
+    //相机场景相关
+    std::shared_ptr<PointCloudDataset> m_dataset; // [x, y, z, r, g, b]，多个窗口共享
     float m_minZ = 0.0f, m_maxZ = 1.0f;
 
     QMatrix4x4 m_projection;
@@ -66,40 +253,77 @@ private:
 
     int m_renderMode = 0; // 0: elevation, 1: RGB
 
-    QVector3D m_bboxMin;   // ʵϵµС
-    QVector3D m_bboxMax;   // ʵϵµ
-    QVector3D m_center;    // Χ
+    QVector3D m_bboxMin;   // 局部坐标系（相对数据集 origin）下的最小点
+    QVector3D m_bboxMax;   // 局部坐标系（相对数据集 origin）下的最大点
+    QVector3D m_center;    // 相机注视点，初始为包围盒中心，绕其它点旋转时随之移动
+    QVector3D m_pivot;     // 旋转中心
     QVector3D m_bboxSize;
-    float m_sceneRadius = 0.0f;   // 뾶룩
-
-    bool m_showColorBar = false; // Ƿʾɫ
-
-    // 
-    QOpenGLShaderProgram* m_axisShader = nullptr;
-    QOpenGLBuffer m_axisVbo;
-    QOpenGLVertexArrayObject m_axisVao;
-    bool m_axisInitialized = false;
-    // ѡ᳤صλ
-    float m_axisLength = 40.0f; // 
-
-    //Ʒһ
-    void initScreenAxis();
-    void renderScreenAxis();
-    void renderCornerAxisLabels(const QMatrix4x4& rotation);
-
-    //Ʒ
-    void initScreenAxisOrtho();
-    void renderScreenAxisOrtho();
-
-    // ߽
-    QOpenGLShaderProgram* m_boxShader;
-    QOpenGLBuffer m_boxVbo;
-    QOpenGLVertexArrayObject m_boxVao;
-    bool m_boxInitialized = false;
-    std::vector<float> m_boxVertices; // 洢߽ж
-    std::vector<unsigned int> m_boxIndices; // 洢߽
-
-    void initBoundingBoxGeometry();
-    void renderBoundingBox();
-    void updateBoundingBoxGeometry();
+    float m_sceneRadius = 0.0f;   // 场景半径（用于设置相机距离）
+    PointCloudStats m_stats;      // 当前点云的统计量
+
+    bool m_showColorBar = false; // 是否显示颜色条
+    std::shared_ptr<const PointCloudColormap> m_colormap = PointCloudColormap::preset(PointCloudColormap::eElevation);
+    QImage m_colorBarImage;      // 色带的竖直图像，颜色条直接缩放绘制
+
+    // 高程显示范围（局部坐标）
+    float m_displayMinZ = 0.0f;
+    float m_displayMaxZ = 1.0f;
+    bool m_rangePercentiles = true;   // 范围来自分位数，颜色条注明分位
+    double m_lowPercent = PointCloudStats::kDefaultLowPercent;
+    double m_highPercent = PointCloudStats::kDefaultHighPercent;
+
+    PointCloudPointSizeSettings m_pointSize;
+    PointCloudEdlSettings m_edl;
+    PointCloudHoleFillSettings m_holeFill;
+
+    // 颜色条上的范围拖动
+    enum RangeDrag
+    {
+        eNoRangeDrag,
+        eDragMin,
+        eDragMax,
+        eDragShift
+    };
+    RangeDrag m_rangeDrag = eNoRangeDrag;
+    int m_rangeDragStartY = 0;
+    float m_rangeDragStartMin = 0.0f;
+    float m_rangeDragStartMax = 0.0f;
+
+    // 量测：拾取请求随下一帧提交给渲染器，结果按序号对应
+    MeasureMode m_measureMode = eMeasureNone;
+    struct MeasuredPoint
+    {
+        double world[3];    // 真实坐标
+        QVector3D local;    // 局部坐标，用于投影到屏幕
+    };
+    std::vector<MeasuredPoint> m_measuredPoints;
+    QPoint m_pressPos;
+    QPoint m_pickPos;               // 窗口坐标
+    quint64 m_pickSerial = 0;
+    bool m_pickPending = false;
+
+    // 选择：拖动中的形状为窗口坐标，矩形只保存两个角点
+    SelectionTool m_selectionTool = eSelectNone;
+    std::shared_ptr<const PointCloudSelection> m_selection;
+    bool m_selecting = false;
+    QPolygon m_selectionShape;
+
+    // 裁剪，修改时整体替换，渲染器持有的快照不受影响
+    std::shared_ptr<const PointCloudClipping> m_clipping;
+
+    // 删除后的压缩：压缩期间点云占两份内存，只在删除的点足够多、停止编辑一段时间后进行
+    static constexpr int kCompactIdleMs = 10000;
+    static constexpr double kCompactRatio = 0.25;
+    QTimer m_compactTimer;
+    bool m_compacting = false;
+
+    // 动态旋转中心
+    bool m_dynamicPivot = false;
+    bool m_orbiting = false;        // 左键按下旋转中，显示旋转中心
+    QPoint m_depthPickPos;
+    quint64 m_depthPickSerial = 0;
+    bool m_depthPickPending = false;
+
+    // 可选：缓存轴长（像素单位）
+    float m_axisLength = 40.0f; // 像素
 };
\ No newline at end of file
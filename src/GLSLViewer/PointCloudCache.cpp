@@ -0,0 +1,150 @@
+﻿#include "PointCloudCache.h"
+
+#include <QFile>
+#include <QSaveFile>
+#include <QDebug>
+
+#include <cstring>
+
+namespace
+{
+    const char kMagic[4] = { 'B', 'C', 'P', 'C' };
+    const quint32 kVersion = 1;
+
+    enum CacheFlag : quint32
+    {
+        eHasColor = 0x1,
+        eHasIntensity = 0x2
+    };
+
+#pragma pack(push, 1)
+    struct CacheHeader
+    {
+        char magic[4];
+        quint32 version;
+        quint64 pointCount;
+        quint32 flags;
+        quint32 schema;
+        double origin[3];
+    };
+#pragma pack(pop)
+
+    // 大块读写，单次不超过 64MB
+    const qint64 kIoBlock = qint64(64) << 20;
+
+    bool writeAll(QIODevice& device, const char* data, qint64 size)
+    {
+        while (size > 0) {
+            const qint64 written = device.write(data, qMin(size, kIoBlock));
+            if (written <= 0) return false;
+            data += written;
+            size -= written;
+        }
+        return true;
+    }
+
+    bool readAll(QIODevice& device, char* data, qint64 size)
+    {
+        while (size > 0) {
+            const qint64 got = device.read(data, qMin(size, kIoBlock));
+            if (got <= 0) return false;
+            data += got;
+            size -= got;
+        }
+        return true;
+    }
+}
+
+bool PointCloudCache::isCacheFile(const QString& filename)
+{
+    QFile file(filename);
+    if (!file.open(QIODevice::ReadOnly)) return false;
+
+    char magic[4];
+    return file.read(magic, 4) == 4 && std::memcmp(magic, kMagic, 4) == 0;
+}
+
+bool PointCloudCache::write(const PointCloudData& cloud, const QString& filename)
+{
+    QSaveFile file(filename);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Cannot write cache file:" << filename;
+        return false;
+    }
+
+    const bool hasIntensity = !cloud.intensity.empty();
+
+    CacheHeader header;
+    std::memcpy(header.magic, kMagic, 4);
+    header.version = kVersion;
+    header.pointCount = cloud.pointCount();
+    header.flags = (cloud.hasColor ? eHasColor : 0u) | (hasIntensity ? eHasIntensity : 0u);
+    header.schema = static_cast<quint32>(cloud.schema);
+    header.origin[0] = cloud.origin.x;
+    header.origin[1] = cloud.origin.y;
+    header.origin[2] = cloud.origin.z;
+
+    bool ok = writeAll(file, reinterpret_cast<const char*>(&header), sizeof(header));
+    ok = ok && writeAll(file, reinterpret_cast<const char*>(cloud.points.data()),
+        static_cast<qint64>(cloud.points.size() * sizeof(float)));
+    if (hasIntensity) {
+        ok = ok && writeAll(file, reinterpret_cast<const char*>(cloud.intensity.data()),
+            static_cast<qint64>(cloud.intensity.size() * sizeof(float)));
+    }
+
+    if (!ok) {
+        file.cancelWriting();
+        qWarning() << "Failed to write cache file:" << filename;
+        return false;
+    }
+    return file.commit();
+}
+
+bool PointCloudCache::read(const QString& filename, PointCloudData& cloud)
+{
+    QFile file(filename);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "Cannot open cache file:" << filename;
+        return false;
+    }
+
+    CacheHeader header;
+    if (file.read(reinterpret_cast<char*>(&header), sizeof(header)) != sizeof(header)
+        || std::memcmp(header.magic, kMagic, 4) != 0
+        || header.version != kVersion
+        || header.schema > static_cast<quint32>(PointSchema::XYZIRGB)) {
+        qWarning() << "Invalid cache file:" << filename;
+        return false;
+    }
+
+    // 先按文件大小限制点数再计算字节数，损坏的点数不会溢出，也不会按它分配内存
+    const bool hasIntensity = (header.flags & eHasIntensity) != 0;
+    const quint64 bytesPerPoint = (PointCloudData::kFloatsPerPoint + (hasIntensity ? 1 : 0)) * sizeof(float);
+    const quint64 payload = static_cast<quint64>(file.size()) - sizeof(header);
+    if (header.pointCount > payload / bytesPerPoint) {
+        qWarning() << "Truncated cache file:" << filename;
+        return false;
+    }
+
+    cloud = PointCloudData();
+    cloud.origin.x = header.origin[0];
+    cloud.origin.y = header.origin[1];
+    cloud.origin.z = header.origin[2];
+    cloud.hasColor = (header.flags & eHasColor) != 0;
+    cloud.schema = static_cast<PointSchema>(header.schema);
+
+    cloud.points.resize(header.pointCount * PointCloudData::kFloatsPerPoint);
+    bool ok = readAll(file, reinterpret_cast<char*>(cloud.points.data()),
+        static_cast<qint64>(cloud.points.size() * sizeof(float)));
+    if (ok && hasIntensity) {
+        cloud.intensity.resize(header.pointCount);
+        ok = readAll(file, reinterpret_cast<char*>(cloud.intensity.data()),
+            static_cast<qint64>(cloud.intensity.size() * sizeof(float)));
+    }
+
+    if (!ok) {
+        cloud = PointCloudData();
+        qWarning() << "Failed to read cache file:" << filename;
+    }
+    return ok;
+}
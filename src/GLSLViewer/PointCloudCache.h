@@ -0,0 +1,21 @@
+﻿#pragma once
+
+#include "glslviewer_global.h"
+#include "PointCloudData.h"
+
+#include <QString>
+
+// 点云二进制缓存（*.bcpc）
+// 文件头之后直接是交错顶点数组和可选的强度数组，与内存布局一致，
+// 读取时不需要解析，整块读入后即可上传 GPU
+class GLSLVIEWER_EXPORT PointCloudCache
+{
+public:
+    static QString suffix() { return QStringLiteral("bcpc"); }
+
+    // 按文件头魔数判断，不依赖扩展名
+    static bool isCacheFile(const QString& filename);
+
+    static bool write(const PointCloudData& cloud, const QString& filename);
+    static bool read(const QString& filename, PointCloudData& cloud);
+};
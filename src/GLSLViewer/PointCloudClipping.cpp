@@ -0,0 +1,152 @@
+﻿#include "PointCloudClipping.h"
+
+#include <QtConcurrent>
+#include <QElapsedTimer>
+#include <QDebug>
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <numeric>
+
+bool PointCloudClipping::contains(const float position[3]) const
+{
+    for (const PointCloudClipBox& box : boxes) {
+        const bool inside = position[0] >= box.min.x() && position[0] <= box.max.x()
+            && position[1] >= box.min.y() && position[1] <= box.max.y()
+            && position[2] >= box.min.z() && position[2] <= box.max.z();
+        if (inside != box.keepInside) return inverted;
+    }
+    for (const PointCloudClipPlane& plane : planes) {
+        const float distance = plane.normal.x() * position[0] + plane.normal.y() * position[1]
+            + plane.normal.z() * position[2] + plane.offset;
+        if (distance < 0.0f) return inverted;
+    }
+    return !inverted;
+}
+
+// 所有裁剪体的交：任一裁剪体整块裁掉则整块裁掉，全部整块保留才整块保留；取反时整块裁掉与整块保留互换
+PointCloudClipping::Coverage PointCloudClipping::classify(const PointCloudBox& chunk) const
+{
+    const Coverage outside = inverted ? eAll : eNone;
+    bool all = true;
+    for (const PointCloudClipBox& clip : boxes) {
+        const float clipMin[3] = { clip.min.x(), clip.min.y(), clip.min.z() };
+        const float clipMax[3] = { clip.max.x(), clip.max.y(), clip.max.z() };
+        bool disjoint = false;
+        bool contained = true;
+        for (int a = 0; a < 3; ++a) {
+            disjoint = disjoint || chunk.max[a] < clipMin[a] || chunk.min[a] > clipMax[a];
+            contained = contained && chunk.min[a] >= clipMin[a] && chunk.max[a] <= clipMax[a];
+        }
+        const bool none = clip.keepInside ? disjoint : contained;
+        const bool kept = clip.keepInside ? contained : disjoint;
+        if (none) return outside;
+        all = all && kept;
+    }
+    for (const PointCloudClipPlane& plane : planes) {
+        // 包围盒角点到平面的最小、最大有向距离
+        const float normal[3] = { plane.normal.x(), plane.normal.y(), plane.normal.z() };
+        float nearest = plane.offset;
+        float farthest = plane.offset;
+        for (int a = 0; a < 3; ++a) {
+            nearest += normal[a] * (normal[a] >= 0.0f ? chunk.min[a] : chunk.max[a]);
+            farthest += normal[a] * (normal[a] >= 0.0f ? chunk.max[a] : chunk.min[a]);
+        }
+        if (farthest < 0.0f) return outside;
+        all = all && nearest >= 0.0f;
+    }
+    if (!all) return ePartial;
+    return inverted ? eNone : eAll;
+}
+
+std::vector<PointCloudBox> PointCloudClipping::computeChunkBounds(const PointCloudData& cloud)
+{
+    const size_t count = cloud.pointCount();
+    std::vector<PointCloudBox> bounds((count + kChunkPoints - 1) / kChunkPoints);
+    std::vector<size_t> chunkIndices(bounds.size());
+    std::iota(chunkIndices.begin(), chunkIndices.end(), size_t(0));
+
+    QtConcurrent::blockingMap(chunkIndices, [&](size_t c) {
+        const float inf = std::numeric_limits<float>::infinity();
+        PointCloudBox box{ { inf, inf, inf }, { -inf, -inf, -inf } };
+        const size_t end = std::min(count, (c + 1) * kChunkPoints);
+        for (size_t i = c * kChunkPoints; i < end; ++i) {
+            const float* p = cloud.points.data() + i * PointCloudData::kFloatsPerPoint;
+            for (int a = 0; a < 3; ++a) {
+                box.min[a] = std::min(box.min[a], p[a]);
+                box.max[a] = std::max(box.max[a], p[a]);
+            }
+        }
+        bounds[c] = box;
+    });
+    return bounds;
+}
+
+// 两遍：先按块统计保留的点（部分保留的块记下位集），前缀和得到各块的输出位置，再并行复制
+std::shared_ptr<PointCloudData> PointCloudClipping::bake(const PointCloudData& cloud) const
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    const size_t count = cloud.pointCount();
+    const std::vector<PointCloudBox> bounds = computeChunkBounds(cloud);
+    std::vector<size_t> chunkIndices(bounds.size());
+    std::iota(chunkIndices.begin(), chunkIndices.end(), size_t(0));
+    std::vector<Coverage> coverage(bounds.size());
+    std::vector<std::vector<quint64>> masks(bounds.size());
+    std::vector<size_t> kept(bounds.size() + 1, 0);
+
+    QtConcurrent::blockingMap(chunkIndices, [&](size_t c) {
+        const size_t begin = c * kChunkPoints;
+        const size_t end = std::min(count, begin + kChunkPoints);
+        coverage[c] = classify(bounds[c]);
+        if (coverage[c] == eAll) kept[c + 1] = end - begin;
+        if (coverage[c] != ePartial) return;
+
+        std::vector<quint64>& mask = masks[c];
+        mask.assign((end - begin + 63) / 64, 0);
+        size_t n = 0;
+        for (size_t i = begin; i < end; ++i) {
+            const quint64 inside = contains(cloud.points.data() + i * PointCloudData::kFloatsPerPoint);
+            mask[(i - begin) / 64] |= inside << ((i - begin) % 64);
+            n += inside;
+        }
+        kept[c + 1] = n;
+    });
+    std::partial_sum(kept.begin(), kept.end(), kept.begin());
+
+    auto result = std::make_shared<PointCloudData>();
+    result->origin = cloud.origin;
+    result->hasColor = cloud.hasColor;
+    result->schema = cloud.schema;
+    const bool hasIntensity = cloud.intensity.size() == count;
+    result->points.resize(kept.back() * PointCloudData::kFloatsPerPoint);
+    if (hasIntensity) result->intensity.resize(kept.back());
+
+    QtConcurrent::blockingMap(chunkIndices, [&](size_t c) {
+        const size_t begin = c * kChunkPoints;
+        const size_t end = std::min(count, begin + kChunkPoints);
+        size_t out = kept[c];
+        if (coverage[c] == eAll) {
+            std::memcpy(result->points.data() + out * PointCloudData::kFloatsPerPoint,
+                cloud.points.data() + begin * PointCloudData::kFloatsPerPoint,
+                (end - begin) * PointCloudData::kFloatsPerPoint * sizeof(float));
+            if (hasIntensity) std::copy(cloud.intensity.begin() + begin, cloud.intensity.begin() + end, result->intensity.begin() + out);
+        }
+        else if (coverage[c] == ePartial) {
+            const std::vector<quint64>& mask = masks[c];
+            for (size_t i = begin; i < end; ++i) {
+                if (!(mask[(i - begin) / 64] >> ((i - begin) % 64) & 1u)) continue;
+                std::copy_n(cloud.points.data() + i * PointCloudData::kFloatsPerPoint, PointCloudData::kFloatsPerPoint,
+                    result->points.data() + out * PointCloudData::kFloatsPerPoint);
+                if (hasIntensity) result->intensity[out] = cloud.intensity[i];
+                ++out;
+            }
+        }
+    });
+
+    qDebug().nospace() << "Clipping baked: " << result->pointCount() << " of " << count
+        << " points, " << timer.elapsed() << " ms";
+    return result;
+}
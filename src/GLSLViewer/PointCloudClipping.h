@@ -0,0 +1,68 @@
+﻿#pragma once
+
+#include "glslviewer_global.h"
+#include "PointCloudData.h"
+
+#include <QVector3D>
+#include <vector>
+#include <memory>
+
+// 轴对齐包围盒（局部坐标）
+struct PointCloudBox
+{
+    float min[3];
+    float max[3];
+};
+
+// 裁剪盒（局部坐标，含边界），keepInside 为 false 时隐藏盒内的点
+struct PointCloudClipBox
+{
+    QVector3D min;
+    QVector3D max;
+    bool keepInside = true;
+};
+
+// 剖切面：保留 dot(normal, p) + offset >= 0 的一侧
+struct PointCloudClipPlane
+{
+    QVector3D normal;
+    float offset = 0.0f;
+};
+
+// 裁剪：点同时满足所有裁剪盒和剖切面时显示，inverted 时反过来，只显示不同时满足的点
+// 交互裁剪只改变着色器 uniform，在顶点着色器中剔除，不复制、不修改点数据；
+// 渲染器另按块包围盒跳过整块被裁掉的点；需要真正得到裁剪结果时调用 bake()
+class GLSLVIEWER_EXPORT PointCloudClipping
+{
+public:
+    static constexpr int kMaxBoxes = 8;
+    static constexpr int kMaxPlanes = 6;
+    // 块包围盒的点数：扫描数据按采集顺序存放，相邻的点在空间上也相近
+    static constexpr size_t kChunkPoints = size_t(1) << 14;
+
+    // 块中被保留的点
+    enum Coverage
+    {
+        eNone,
+        eAll,
+        ePartial
+    };
+
+    std::vector<PointCloudClipBox> boxes;
+    std::vector<PointCloudClipPlane> planes;
+    bool inverted = false;
+
+    bool empty() const { return boxes.empty() && planes.empty(); }
+    bool contains(const float position[3]) const;
+    Coverage classify(const PointCloudBox& box) const;
+
+    // 显示与隐藏互换：对所有裁剪体的交整体取反（不是逐个反转，多个裁剪体时两者不同）
+    void invert() { inverted = !inverted; }
+
+    // 每 kChunkPoints 个点的包围盒，按块并行
+    static std::vector<PointCloudBox> computeChunkBounds(const PointCloudData& cloud);
+
+    // 生成裁剪后的点云（坐标、颜色、强度），保持原来的顺序和原点；按块并行
+    // 整块保留或整块裁掉的块不逐点判断
+    std::shared_ptr<PointCloudData> bake(const PointCloudData& cloud) const;
+};
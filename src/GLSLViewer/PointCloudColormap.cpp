@@ -0,0 +1,110 @@
+﻿#include "PointCloudColormap.h"
+
+#include <algorithm>
+
+namespace
+{
+    QColor rgbF(float r, float g, float b)
+    {
+        return QColor::fromRgbF(r, g, b);
+    }
+}
+
+PointCloudColormap::PointCloudColormap(const QString& name, const QList<Stop>& stops)
+    : m_name(name)
+    , m_stops(stops)
+    , m_table(kTableSize, qRgb(255, 255, 255))
+{
+    std::sort(m_stops.begin(), m_stops.end(),
+        [](const Stop& a, const Stop& b) { return a.first < b.first; });
+    if (m_stops.isEmpty()) return;
+
+    // 各级取所在区间两端节点的线性插值，区间外取端点颜色
+    int next = 0;
+    for (int i = 0; i < kTableSize; ++i) {
+        const qreal t = static_cast<qreal>(i) / (kTableSize - 1);
+        while (next < m_stops.size() && m_stops[next].first < t) ++next;
+
+        QColor color;
+        if (next == 0) {
+            color = m_stops.first().second;
+        }
+        else if (next == m_stops.size()) {
+            color = m_stops.last().second;
+        }
+        else {
+            const Stop& lo = m_stops[next - 1];
+            const Stop& hi = m_stops[next];
+            const qreal span = hi.first - lo.first;
+            const qreal f = span > 0.0 ? (t - lo.first) / span : 1.0;
+            color = QColor::fromRgbF(
+                static_cast<float>(lo.second.redF() + (hi.second.redF() - lo.second.redF()) * f),
+                static_cast<float>(lo.second.greenF() + (hi.second.greenF() - lo.second.greenF()) * f),
+                static_cast<float>(lo.second.blueF() + (hi.second.blueF() - lo.second.blueF()) * f));
+        }
+        m_table[i] = color.rgb();
+    }
+}
+
+std::shared_ptr<const PointCloudColormap> PointCloudColormap::preset(Preset preset)
+{
+    switch (preset) {
+    case eViridis:
+        return std::make_shared<const PointCloudColormap>(QStringLiteral("viridis"), QList<Stop>{
+            { 0.0, QColor(0x44, 0x01, 0x54) }, { 0.125, QColor(0x47, 0x2d, 0x7b) },
+            { 0.25, QColor(0x3b, 0x52, 0x8b) }, { 0.375, QColor(0x2c, 0x72, 0x8e) },
+            { 0.5, QColor(0x21, 0x91, 0x8c) }, { 0.625, QColor(0x28, 0xae, 0x80) },
+            { 0.75, QColor(0x5e, 0xc9, 0x62) }, { 0.875, QColor(0xad, 0xdc, 0x30) },
+            { 1.0, QColor(0xfd, 0xe7, 0x25) } });
+    case eJet:
+        return std::make_shared<const PointCloudColormap>(QStringLiteral("jet"), QList<Stop>{
+            { 0.0, rgbF(0.0f, 0.0f, 0.5f) }, { 0.125, rgbF(0.0f, 0.0f, 1.0f) },
+            { 0.375, rgbF(0.0f, 1.0f, 1.0f) }, { 0.625, rgbF(1.0f, 1.0f, 0.0f) },
+            { 0.875, rgbF(1.0f, 0.0f, 0.0f) }, { 1.0, rgbF(0.5f, 0.0f, 0.0f) } });
+    case eTerrain:
+        return std::make_shared<const PointCloudColormap>(QStringLiteral("terrain"), QList<Stop>{
+            { 0.0, rgbF(0.2f, 0.2f, 0.6f) }, { 0.15, rgbF(0.0f, 0.6f, 1.0f) },
+            { 0.25, rgbF(0.0f, 0.8f, 0.4f) }, { 0.5, rgbF(1.0f, 1.0f, 0.6f) },
+            { 0.75, rgbF(0.5f, 0.36f, 0.33f) }, { 1.0, rgbF(1.0f, 1.0f, 1.0f) } });
+    case eGrayscale:
+        return std::make_shared<const PointCloudColormap>(QStringLiteral("grayscale"), QList<Stop>{
+            { 0.0, rgbF(0.0f, 0.0f, 0.0f) }, { 1.0, rgbF(1.0f, 1.0f, 1.0f) } });
+    case eElevation:
+    default:
+        return std::make_shared<const PointCloudColormap>(QStringLiteral("elevation"), QList<Stop>{
+            { 0.0, rgbF(0.0f, 0.0f, 0.5f) }, { 0.25, rgbF(0.0f, 0.5f, 0.0f) },
+            { 0.5, rgbF(0.8f, 0.8f, 0.0f) }, { 0.75, rgbF(1.0f, 1.0f, 1.0f) },
+            { 1.0, rgbF(1.0f, 1.0f, 1.0f) } });
+    }
+}
+
+std::shared_ptr<const PointCloudColormap> PointCloudColormap::preset(const QString& name)
+{
+    const QString key = name.trimmed().toLower();
+    if (key == QLatin1String("elevation")) return preset(eElevation);
+    if (key == QLatin1String("viridis")) return preset(eViridis);
+    if (key == QLatin1String("jet")) return preset(eJet);
+    if (key == QLatin1String("terrain")) return preset(eTerrain);
+    if (key == QLatin1String("grayscale")) return preset(eGrayscale);
+    return nullptr;
+}
+
+std::shared_ptr<const PointCloudColormap> PointCloudColormap::fromColors(const QString& name, const QList<QColor>& colors)
+{
+    QList<Stop> stops;
+    for (int i = 0; i < colors.size(); ++i) {
+        if (!colors[i].isValid()) continue;
+        stops.append({ colors.size() > 1 ? static_cast<qreal>(i) / (colors.size() - 1) : 0.0, colors[i] });
+    }
+    if (stops.isEmpty()) return nullptr;
+    return std::make_shared<const PointCloudColormap>(name, stops);
+}
+
+QImage PointCloudColormap::image() const
+{
+    QImage image(1, kTableSize, QImage::Format_RGB32);
+    for (int i = 0; i < kTableSize; ++i) {
+        image.setPixel(0, kTableSize - 1 - i, m_table[i]);
+    }
+    return image;
+}
@@ -0,0 +1,53 @@
+﻿#pragma once
+
+#include "glslviewer_global.h"
+
+#include <QString>
+#include <QColor>
+#include <QImage>
+#include <QList>
+#include <QPair>
+#include <vector>
+#include <memory>
+
+// 高程着色用的色带：若干颜色节点线性插值成 256 级查找表
+// 着色器以一维纹理采样同一张表，颜色条也由这张表绘制，两处颜色始终一致
+// 创建后不再修改，窗口之间可以共享；切换色带只替换纹理，不重新上传点数据
+class GLSLVIEWER_EXPORT PointCloudColormap
+{
+public:
+    static constexpr int kTableSize = 256;
+
+    enum Preset
+    {
+        eElevation,   // 深蓝-绿-黄-白，原有的高程色
+        eViridis,
+        eJet,
+        eTerrain,
+        eGrayscale
+    };
+
+    // 节点位置在 [0, 1] 内，按位置排序
+    using Stop = QPair<qreal, QColor>;
+
+    PointCloudColormap(const QString& name, const QList<Stop>& stops);
+
+    static std::shared_ptr<const PointCloudColormap> preset(Preset preset);
+    // 按名称（elevation、viridis、jet、terrain、grayscale）查找预设，未知名称返回空
+    static std::shared_ptr<const PointCloudColormap> preset(const QString& name);
+    // 自定义色带，颜色等间距排列（例如来自颜色表的命名颜色）
+    static std::shared_ptr<const PointCloudColormap> fromColors(const QString& name, const QList<QColor>& colors);
+
+    const QString& name() const { return m_name; }
+    const QList<Stop>& stops() const { return m_stops; }
+
+    // 256 级查找表，0 对应最小值
+    const std::vector<QRgb>& table() const { return m_table; }
+    // 宽 1、高 256 的竖直色带，最上面一行对应最大值，用于颜色条
+    QImage image() const;
+
+private:
+    QString m_name;
+    QList<Stop> m_stops;
+    std::vector<QRgb> m_table;
+};
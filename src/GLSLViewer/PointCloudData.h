@@ -0,0 +1,48 @@
+﻿#pragma once
+
+#include <vector>
+#include <cstddef>
+
+// 文本点云的列格式
+enum class PointSchema
+{
+    Generic,    // 逐行按列数判断（混合格式）
+    XYZ,
+    XYZI,
+    XYZRGB,
+    XYZIRGB
+};
+
+// 双精度局部原点
+// UTM、国家坐标等数值很大，直接存 float 会丢掉厘米级精度；
+// 加载时选一个原点，顶点只保存相对原点的 float 偏移，真实坐标 = 原点 + 偏移
+struct PointCloudOrigin
+{
+    double x = 0.0;
+    double y = 0.0;
+    double z = 0.0;
+};
+
+// 内存中的点云
+struct PointCloudData
+{
+    static constexpr int kFloatsPerPoint = 6;
+
+    PointCloudOrigin origin;        // 数据集的局部原点
+    std::vector<float> points;      // 交错存储 [x, y, z, r, g, b]，xyz 为相对 origin 的偏移，没有颜色时为白色
+    std::vector<float> intensity;   // 强度，仅 XYZI / XYZIRGB 有值
+    bool hasColor = false;
+    PointSchema schema = PointSchema::Generic;
+
+    size_t pointCount() const { return points.size() / kFloatsPerPoint; }
+    bool empty() const { return points.empty(); }
+
+    // 第 i 个点的真实坐标
+    void worldPosition(size_t i, double& x, double& y, double& z) const
+    {
+        const float* p = points.data() + i * kFloatsPerPoint;
+        x = origin.x + p[0];
+        y = origin.y + p[1];
+        z = origin.z + p[2];
+    }
+};
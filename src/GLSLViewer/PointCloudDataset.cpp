@@ -0,0 +1,466 @@
+﻿#include "PointCloudDataset.h"
+#include "PointCloudReader.h"
+#include "PointCloudCache.h"
+#include "PointCloudRegistry.h"
+#include "PointCloudUploader.h"
+
+#include <QCryptographicHash>
+#include <QStandardPaths>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QMutexLocker>
+#include <QElapsedTimer>
+#include <QOpenGLContext>
+#include <QOpenGLFunctions>
+#include <QtConcurrent>
+#include <QDebug>
+
+PointCloudDataset::PointCloudDataset(const QString& filename)
+    : m_fileName(filename)
+    , m_vbo(QOpenGLBuffer::VertexBuffer)
+{
+}
+
+PointCloudDataset::~PointCloudDataset()
+{
+    m_rehydrateTask.waitForFinished();
+    m_cacheWriteTask.waitForFinished();
+
+    // 没有当前上下文时 Qt 会推迟到共享组内下一次 makeCurrent 再释放
+    releaseUploadFence();
+    m_vbo.destroy();
+
+    if (m_ownsCacheFile) QFile::remove(m_cacheFile);
+}
+
+bool PointCloudDataset::load()
+{
+    auto cloud = std::make_shared<PointCloudData>();
+    if (!PointCloudReader::readFile(m_fileName, *cloud)) return false;
+
+    if (cloud->empty()) {
+        qWarning() << "No valid points loaded.";
+        return false;
+    }
+
+    m_fileKey = PointCloudRegistry::fileKey(m_fileName);
+    m_stats = PointCloudStats::compute(*cloud);
+    m_spacing = PointCloudSpacing::compute(*cloud, m_stats);
+    m_chunkBounds = PointCloudClipping::computeChunkBounds(*cloud);
+    m_pointCount = cloud->pointCount();
+    m_origin = cloud->origin;
+    m_hasColor = cloud->hasColor;
+
+    // 源文件本身就是二进制缓存时直接用它恢复
+    if (PointCloudCache::isCacheFile(m_fileName)) m_cacheFile = m_fileName;
+
+    m_cloud = std::move(cloud);
+    return true;
+}
+
+std::shared_ptr<const PointCloudData> PointCloudDataset::cloud()
+{
+    QMutexLocker locker(&m_cpuMutex);
+    if (!m_cloud) rehydrate();
+    return m_cloud;
+}
+
+// 构建期间只持有树的锁，渲染线程上传时取 CPU 数据不受影响
+// 构建期间数据集可能被压缩：点数、缓存路径在开始时取一次，压缩过的结果丢弃
+std::shared_ptr<const PointCloudKdTree> PointCloudDataset::kdTree()
+{
+    QMutexLocker buildLocker(&m_kdTreeMutex);
+    int compactions = 0;
+    size_t pointCount = 0;
+    QString path;
+    {
+        QMutexLocker locker(&m_cpuMutex);
+        if (m_kdTree) return m_kdTree;
+        compactions = m_compactions;
+        pointCount = m_pointCount;
+        path = cachePath(PointCloudKdTree::suffix());
+    }
+
+    // 缓存按文件路径、大小和修改时间命名，文件变化后不会读到旧的树；压缩后的点与文件不一致，不读写缓存
+    const bool compacted = compactions > 0;
+    auto tree = std::make_shared<PointCloudKdTree>();
+    if (compacted || !QFileInfo::exists(path) || !tree->read(path, pointCount)) {
+        // 压缩总会移除点，点数不同即已压缩
+        std::shared_ptr<const PointCloudData> data = cloud();
+        if (!data || data->pointCount() != pointCount || !tree->build(*data)) return nullptr;
+        // 写入失败只影响下次打开
+        if (!compacted && QDir().mkpath(QFileInfo(path).absolutePath()) && tree->write(path)) pruneTreeCache(path);
+    }
+    else {
+        // 修改时间即最近使用时间，淘汰时据此排序
+        QFile file(path);
+        if (file.open(QIODevice::ReadWrite)) file.setFileTime(QDateTime::currentDateTime(), QFileDevice::FileModificationTime);
+    }
+
+    QMutexLocker locker(&m_cpuMutex);
+    if (m_compactions != compactions) return nullptr;
+    m_kdTree = tree;
+    return tree;
+}
+
+std::shared_ptr<const PointCloudSelection> PointCloudDataset::deletedPoints() const
+{
+    QMutexLocker locker(&m_editMutex);
+    return m_deleted;
+}
+
+size_t PointCloudDataset::deletedCount() const
+{
+    QMutexLocker locker(&m_editMutex);
+    return m_deleted ? m_deleted->selectedCount() : 0;
+}
+
+quint64 PointCloudDataset::editVersion() const
+{
+    QMutexLocker locker(&m_editMutex);
+    return m_editVersion;
+}
+
+// 新标记与原来的共享未变的块，撤销记录只多占被修改的块
+bool PointCloudDataset::deletePoints(const PointCloudSelection& points)
+{
+    QMutexLocker locker(&m_editMutex);
+    if (points.pointCount() != m_pointCount || points.empty()) return false;
+
+    std::shared_ptr<const PointCloudSelection> deleted = PointCloudSelection::united(m_deleted, points);
+    if (!deleted || (m_deleted && deleted->selectedCount() == m_deleted->selectedCount())) return false;
+
+    m_undo.push_back(m_deleted);
+    m_redo.clear();
+    m_deleted = std::move(deleted);
+    ++m_editVersion;
+    return true;
+}
+
+bool PointCloudDataset::undoEdit()
+{
+    QMutexLocker locker(&m_editMutex);
+    if (m_undo.empty()) return false;
+
+    m_redo.push_back(m_deleted);
+    m_deleted = m_undo.back();
+    m_undo.pop_back();
+    ++m_editVersion;
+    return true;
+}
+
+bool PointCloudDataset::redoEdit()
+{
+    QMutexLocker locker(&m_editMutex);
+    if (m_redo.empty()) return false;
+
+    m_undo.push_back(m_deleted);
+    m_deleted = m_redo.back();
+    m_redo.pop_back();
+    ++m_editVersion;
+    return true;
+}
+
+bool PointCloudDataset::canUndo() const
+{
+    QMutexLocker locker(&m_editMutex);
+    return !m_undo.empty();
+}
+
+bool PointCloudDataset::canRedo() const
+{
+    QMutexLocker locker(&m_editMutex);
+    return !m_redo.empty();
+}
+
+// 全部删除时统计量无效，保留原来的，包围盒等不会变成空
+bool PointCloudDataset::updateStats(const PointCloudStats& stats, quint64 editVersion)
+{
+    QMutexLocker locker(&m_editMutex);
+    if (editVersion != m_editVersion || !stats.valid()) return false;
+
+    m_stats = stats;
+    m_statsVersion = editVersion;
+    return true;
+}
+
+quint64 PointCloudDataset::statsVersion() const
+{
+    QMutexLocker locker(&m_editMutex);
+    return m_statsVersion;
+}
+
+std::shared_ptr<PointCloudDataset::Compaction> PointCloudDataset::prepareCompaction()
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    quint64 version = 0;
+    std::shared_ptr<const PointCloudSelection> deleted;
+    {
+        QMutexLocker locker(&m_editMutex);
+        version = m_editVersion;
+        deleted = m_deleted;
+    }
+    std::shared_ptr<const PointCloudData> data = cloud();
+    if (!deleted || deleted->empty() || !data) return nullptr;
+
+    auto compaction = std::make_shared<Compaction>();
+    compaction->editVersion = version;
+    compaction->cloud = deleted->extractUnselected(*data);
+    if (compaction->cloud->empty()) return nullptr;
+    compaction->stats = PointCloudStats::compute(*compaction->cloud);
+    compaction->spacing = PointCloudSpacing::compute(*compaction->cloud, compaction->stats);
+    compaction->chunkBounds = PointCloudClipping::computeChunkBounds(*compaction->cloud);
+
+    qDebug().nospace() << "Compaction prepared: " << compaction->cloud->pointCount() << " of " << data->pointCount()
+        << " points, " << timer.elapsed() << " ms";
+    return compaction;
+}
+
+// 先 GPU 锁再 CPU 锁，与渲染线程上传时的顺序一致
+bool PointCloudDataset::applyCompaction(const Compaction& compaction)
+{
+    QMutexLocker gpuLocker(&m_gpuMutex);
+    QMutexLocker cpuLocker(&m_cpuMutex);
+    QMutexLocker editLocker(&m_editMutex);
+    if (compaction.editVersion != m_editVersion || !compaction.cloud) return false;
+
+    // 原来的缓存对应压缩前的点，换一个键，之后释放 CPU 数据时写出的缓存不覆盖原文件的
+    if (m_ownsCacheFile) QFile::remove(m_cacheFile);
+    m_cacheFile.clear();
+    m_ownsCacheFile = false;
+    m_fileKey = PointCloudRegistry::fileKey(m_fileName) + QStringLiteral("#compact%1").arg(++m_compactions);
+    m_kdTree.reset();
+
+    m_cloud = compaction.cloud;
+    m_pointCount = compaction.cloud->pointCount();
+    m_stats = compaction.stats;
+    m_spacing = compaction.spacing;
+    ++m_spacingGeneration;
+    m_chunkBounds = compaction.chunkBounds;
+
+    m_deleted.reset();
+    m_undo.clear();
+    m_redo.clear();
+    ++m_editVersion;
+    m_statsVersion = m_editVersion;
+
+    evictGpu();
+    qDebug() << "Compacted" << m_fileName << "to" << m_pointCount << "points";
+    return true;
+}
+
+bool PointCloudDataset::bindVertexBuffer()
+{
+    QMutexLocker locker(&m_gpuMutex);
+    if (m_vbo.isCreated()) return m_vbo.bind();
+
+    if (!m_vbo.create()) {
+        qWarning() << "Failed to create vertex buffer for" << m_fileName;
+        return false;
+    }
+    m_vbo.bind();
+    // 只分配存储，数据由 streamVertexBuffer 分片写入，首帧不会因整块上传而卡住
+    // QOpenGLBuffer::allocate 的大小是 int，超过 2 GiB（约 8900 万点）会截断，直接调用 glBufferData
+    m_gpuBytes = static_cast<qint64>(m_pointCount * 6 * sizeof(float));
+    QOpenGLFunctions* functions = QOpenGLContext::currentContext()->functions();
+    functions->glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(m_gpuBytes), nullptr, GL_STATIC_DRAW);
+    if (functions->glGetError() == GL_OUT_OF_MEMORY) {
+        qWarning() << "Cannot allocate" << m_gpuBytes / (1 << 20) << "MB vertex buffer for" << m_fileName;
+        m_vbo.release();
+        m_vbo.destroy();
+        m_gpuBytes = 0;
+        return false;
+    }
+    m_uploadedBytes = 0;
+    ++m_gpuGeneration;
+    return true;
+}
+
+bool PointCloudDataset::streamVertexBuffer(PointCloudUploader& uploader, double budgetMs)
+{
+    QMutexLocker locker(&m_gpuMutex);
+    if (!m_vbo.isCreated()) return false;
+    if (m_uploadedBytes >= m_gpuBytes) return true;
+
+    // 从缓存恢复可能需要数秒，不能在持有 gpuMutex 时进行（GUI 线程的释放和统计会被阻塞）
+    // 数据无法从缓存恢复时放弃，只绘制已上传的部分
+    std::shared_ptr<const PointCloudData> data;
+    {
+        QMutexLocker cpuLocker(&m_cpuMutex);
+        data = m_cloud;
+        if (!data) {
+            if (m_rehydrateFailed) return true;
+            if (m_rehydrateTask.isFinished()) {
+                m_rehydrateTask = QtConcurrent::run([this]() {
+                    QMutexLocker locker(&m_cpuMutex);
+                    if (!m_cloud && !rehydrate()) m_rehydrateFailed = true;
+                });
+            }
+            return false;
+        }
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    const char* src = reinterpret_cast<const char*>(data->points.data());
+    const qint64 before = m_uploadedBytes;
+    do {
+        const qint64 bytes = qMin(PointCloudUploader::kSliceBytes, m_gpuBytes - m_uploadedBytes);
+        if (!uploader.copy(m_vbo.bufferId(), m_uploadedBytes, src + m_uploadedBytes, bytes)) break;
+        m_uploadedBytes += bytes;
+    } while (m_uploadedBytes < m_gpuBytes && timer.nsecsElapsed() < budgetMs * 1e6);
+
+    if (m_uploadedBytes != before) uploader.replaceFence(m_uploadFence);
+    return m_uploadedBytes >= m_gpuBytes;
+}
+
+void PointCloudDataset::syncVertexBuffer(PointCloudUploader& uploader)
+{
+    QMutexLocker locker(&m_gpuMutex);
+    // 上传结束且已执行完后删除同步对象，之后的绘制不再等待
+    if (m_uploadFence) uploader.finishFence(m_uploadFence);
+}
+
+size_t PointCloudDataset::uploadedPointCount() const
+{
+    QMutexLocker locker(&m_gpuMutex);
+    if (!m_vbo.isCreated()) return 0;
+    return static_cast<size_t>(m_uploadedBytes / static_cast<qint64>(6 * sizeof(float)));
+}
+
+void PointCloudDataset::releaseVertexBuffer()
+{
+    m_vbo.release();
+}
+
+bool PointCloudDataset::hasCpuData() const
+{
+    QMutexLocker locker(&m_cpuMutex);
+    return m_cloud != nullptr;
+}
+
+bool PointCloudDataset::hasGpuData() const
+{
+    QMutexLocker locker(&m_gpuMutex);
+    return m_vbo.isCreated();
+}
+
+qint64 PointCloudDataset::cpuBytes() const
+{
+    QMutexLocker locker(&m_cpuMutex);
+    const qint64 treeBytes = m_kdTree ? m_kdTree->memoryBytes() : 0;
+    if (!m_cloud) return treeBytes;
+    return static_cast<qint64>((m_cloud->points.capacity() + m_cloud->intensity.capacity()) * sizeof(float)) + treeBytes;
+}
+
+qint64 PointCloudDataset::gpuBytes() const
+{
+    QMutexLocker locker(&m_gpuMutex);
+    return m_vbo.isCreated() ? m_gpuBytes : 0;
+}
+
+void PointCloudDataset::evictGpu()
+{
+    QMutexLocker locker(&m_gpuMutex);
+    if (!m_vbo.isCreated()) return;
+
+    releaseUploadFence();
+    m_vbo.destroy();
+    m_gpuBytes = 0;
+    m_uploadedBytes = 0;
+    qDebug() << "Evicted GPU buffer:" << m_fileName;
+}
+
+// 大数据的缓存有数 GB，写入不占用调用线程（GUI 线程），也不持有 CPU 数据的锁
+bool PointCloudDataset::evictCpu()
+{
+    QMutexLocker locker(&m_cpuMutex);
+    // k-d 树已写到缓存目录，需要时重新读取
+    m_kdTree.reset();
+    if (!m_cloud) return true;
+
+    // 导出等后台任务持有的引用不受影响
+    if (!m_cacheFile.isEmpty()) {
+        m_cloud.reset();
+        qDebug() << "Evicted CPU data:" << m_fileName << "cache:" << m_cacheFile;
+        return true;
+    }
+    if (!m_cacheWriteTask.isFinished()) return true;
+
+    const std::shared_ptr<const PointCloudData> data = m_cloud;
+    const QString path = cachePath(PointCloudCache::suffix());
+    m_cacheWriteTask = QtConcurrent::run([this, data, path]() {
+        const bool written = QDir().mkpath(QFileInfo(path).absolutePath()) && PointCloudCache::write(*data, path);
+
+        QMutexLocker locker(&m_cpuMutex);
+        if (!written) {
+            qWarning() << "Cannot write cache, keeping points in memory:" << m_fileName;
+            return;
+        }
+        // 写入期间被压缩替换了数据：缓存对应旧的点，删除
+        if (m_cloud != data) {
+            QFile::remove(path);
+            return;
+        }
+        m_cacheFile = path;
+        m_ownsCacheFile = true;
+        m_cloud.reset();
+        qDebug() << "Evicted CPU data:" << m_fileName << "cache:" << m_cacheFile;
+    });
+    return true;
+}
+
+bool PointCloudDataset::rehydrate()
+{
+    if (m_cacheFile.isEmpty()) return false;
+
+    auto cloud = std::make_shared<PointCloudData>();
+    if (!PointCloudCache::read(m_cacheFile, *cloud) || cloud->pointCount() != m_pointCount) {
+        qWarning() << "Failed to restore points from cache:" << m_cacheFile;
+        return false;
+    }
+
+    m_cloud = std::move(cloud);
+    qDebug() << "Restored points from cache:" << m_cacheFile;
+    return true;
+}
+
+// 上传中途释放缓冲时残留的同步对象，没有当前上下文时由下一次绘制删除
+void PointCloudDataset::releaseUploadFence()
+{
+    PointCloudUploader::releaseFence(m_uploadFence);
+    m_uploadFence = nullptr;
+}
+
+// keep 为刚写好的树，总是保留；源文件修改后旧的树不会再被读取，也按过期淘汰
+void PointCloudDataset::pruneTreeCache(const QString& keep)
+{
+    const QFileInfo kept(keep);
+    const QFileInfoList files = kept.absoluteDir().entryInfoList(
+        QStringList(QStringLiteral("*.") + PointCloudKdTree::suffix()), QDir::Files, QDir::Time);
+    const QDateTime expiry = QDateTime::currentDateTime().addDays(-kTreeCacheDays);
+
+    // 按修改时间从新到旧，累计大小超出预算或已过期的删除
+    qint64 total = 0;
+    for (const QFileInfo& info : files) {
+        const bool isKept = info.absoluteFilePath() == kept.absoluteFilePath();
+        if (isKept || (total + info.size() <= kTreeCacheBytes && info.lastModified() >= expiry)) {
+            total += info.size();
+            continue;
+        }
+        if (QFile::remove(info.absoluteFilePath())) qDebug() << "Removed cached k-d tree:" << info.absoluteFilePath();
+    }
+}
+
+// 同一文件的二进制缓存和 k-d 树放在一起，只有扩展名不同
+QString PointCloudDataset::cachePath(const QString& suffix) const
+{
+    const QByteArray hash = QCryptographicHash::hash(m_fileKey.toUtf8(), QCryptographicHash::Sha1).toHex();
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation)
+        + QStringLiteral("/pointclouds/") + QString::fromLatin1(hash)
+        + QLatin1Char('.') + suffix;
+}
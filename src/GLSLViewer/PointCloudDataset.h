@@ -0,0 +1,170 @@
+﻿#pragma once
+
+#include "glslviewer_global.h"
+#include "PointCloudData.h"
+#include "PointCloudStats.h"
+#include "PointCloudSpacing.h"
+#include "PointCloudKdTree.h"
+#include "PointCloudClipping.h"
+#include "PointCloudSelection.h"
+
+#include <QString>
+#include <QOpenGLBuffer>
+#include <QRecursiveMutex>
+#include <QMutex>
+#include <QOpenGLFunctions_3_3_Core>
+#include <QFuture>
+#include <memory>
+
+class PointCloudUploader;
+
+// 一个已加载的点云文件：CPU 数据、统计量和 GPU 顶点缓冲
+// 由 PointCloudRegistry 创建，多个窗口共享同一个实例；
+// 窗口之间开启了共享 OpenGL 上下文（Qt::AA_ShareOpenGLContexts），VBO 可以在任意窗口的上下文中使用，
+// VAO 不能跨上下文共享，由各窗口自己维护
+//
+// 内存超出预算时 PointCloudMemoryBudget 会释放 GPU 缓冲或 CPU 数据，
+// 点数、原点、统计量、点间距和块包围盒始终保留；CPU 数据释放前写入二进制缓存，再次使用时从缓存恢复
+//
+// 渲染线程上传和绘制时持有 gpuMutex()，GUI 线程的释放和统计同样加锁；CPU 数据另有一把锁
+//
+// 删除点时只记录删除标记（墓碑），顶点缓冲和 CPU 数据不变，渲染、选择、统计和导出按标记跳过；
+// 删除的点足够多时由 compact() 真正移除，之后点的序号改变
+class GLSLVIEWER_EXPORT PointCloudDataset
+{
+public:
+    explicit PointCloudDataset(const QString& filename);
+    ~PointCloudDataset();
+
+    PointCloudDataset(const PointCloudDataset&) = delete;
+    PointCloudDataset& operator=(const PointCloudDataset&) = delete;
+
+    // 读取文件并统计，成功且非空时返回 true
+    bool load();
+
+    const QString& fileName() const { return m_fileName; }
+    const PointCloudStats& stats() const { return m_stats; }
+    // 按网格估计的局部点间距，用于自适应点大小；加载和压缩时计算，spacingGeneration() 随之递增
+    const PointCloudSpacing& spacing() const { return m_spacing; }
+    int spacingGeneration() const { return m_spacingGeneration; }
+    // 每 PointCloudClipping::kChunkPoints 个点的包围盒，裁剪时按块剔除
+    const std::vector<PointCloudBox>& chunkBounds() const { return m_chunkBounds; }
+    size_t pointCount() const { return m_pointCount; }
+    const PointCloudOrigin& origin() const { return m_origin; }
+    bool hasColor() const { return m_hasColor; }
+
+    // CPU 数据，已被释放时从缓存恢复，失败返回空
+    std::shared_ptr<const PointCloudData> cloud();
+
+    // 近邻查询用的 k-d 树，第一次使用时构建并写到缓存目录，之后再打开同一文件直接读取
+    // 缓存的树不随数据集删除，超过 kTreeCacheDays 天未用或总大小超过 kTreeCacheBytes 时从最久未用的删起
+    // 在调用线程中构建（大数据需要数秒），界面中使用时放到后台线程；失败或构建期间数据集被压缩时返回空
+    std::shared_ptr<const PointCloudKdTree> kdTree();
+
+    // 绑定顶点缓冲，没有时按总大小分配（不上传数据）；需要当前上下文属于共享组，调用方持有 gpuMutex()
+    bool bindVertexBuffer();
+    void releaseVertexBuffer();
+
+    // 流式上传：在 budgetMs 内经由 uploader 写入后续的若干片，没有剩余可上传的数据时返回 true
+    // 已上传的前缀可以先绘制；多个窗口同时绘制时各自推进同一个进度
+    // CPU 数据已释放时不在锁内从缓存恢复，交给后台线程，恢复完成前返回 false、不上传
+    bool streamVertexBuffer(PointCloudUploader& uploader, double budgetMs);
+    // 绘制前调用：确保其它上下文中的上传对当前上下文可见
+    void syncVertexBuffer(PointCloudUploader& uploader);
+    size_t uploadedPointCount() const;
+
+    // 每次上传递增，渲染器据此判断 VAO 是否需要重建
+    int gpuGeneration() const { return m_gpuGeneration; }
+
+    // 绑定、绘制期间持有，防止其它线程同时释放缓冲
+    QRecursiveMutex* gpuMutex() const { return &m_gpuMutex; }
+
+    //!--------------------------编辑----------------------------------
+    // 删除标记：选中的点为已删除的点，没有删除时为空；与当前点数一致
+    std::shared_ptr<const PointCloudSelection> deletedPoints() const;
+    size_t deletedCount() const;
+    // 删除、撤销、重做和压缩时递增
+    quint64 editVersion() const;
+
+    // 删除 points 中的点（与已删除的合并），可撤销；没有新删除的点时返回 false
+    bool deletePoints(const PointCloudSelection& points);
+    bool undoEdit();
+    bool redoEdit();
+    bool canUndo() const;
+    bool canRedo() const;
+
+    // 删除后的统计量在后台计算，GUI 线程中 editVersion 未变时替换 stats()；statsVersion() 为统计量对应的编辑版本
+    // stats() 返回引用，只在 GUI 线程中调用
+    bool updateStats(const PointCloudStats& stats, quint64 editVersion);
+    quint64 statsVersion() const;
+
+    // 压缩：按当前删除标记生成新的点云、统计量、点间距和块包围盒，不修改数据集，可在后台线程调用
+    struct Compaction
+    {
+        quint64 editVersion = 0;
+        std::shared_ptr<PointCloudData> cloud;
+        PointCloudStats stats;
+        PointCloudSpacing spacing;
+        std::vector<PointCloudBox> chunkBounds;
+    };
+    std::shared_ptr<Compaction> prepareCompaction();
+    // GUI 线程：期间没有新的编辑时替换数据、清空删除标记和撤销记录，GPU 缓冲释放后重新上传
+    bool applyCompaction(const Compaction& compaction);
+
+    //!--------------------------内存预算----------------------------------
+    bool hasCpuData() const;
+    bool hasGpuData() const;
+    qint64 cpuBytes() const;
+    qint64 gpuBytes() const;
+
+    // 释放 GPU 缓冲；没有当前上下文时由 Qt 推迟到共享组下次 makeCurrent，上传同步对象由下一次绘制删除
+    void evictGpu();
+    // 释放 CPU 数据：已有缓存时立即释放，否则在后台线程写缓存，写入提交后才释放
+    // 已释放或已开始写入时返回 true；写入失败、期间数据被压缩替换时保留数据
+    bool evictCpu();
+
+private:
+    static constexpr int kTreeCacheDays = 30;
+    static constexpr qint64 kTreeCacheBytes = qint64(4) << 30;
+
+    bool rehydrate();
+    void releaseUploadFence();
+    QString cachePath(const QString& suffix) const;
+    static void pruneTreeCache(const QString& keep);
+
+    mutable QRecursiveMutex m_cpuMutex;
+    QFuture<void> m_rehydrateTask;   // 流式上传触发的后台恢复
+    QFuture<void> m_cacheWriteTask;  // 释放 CPU 数据前的后台缓存写入
+    bool m_rehydrateFailed = false;  // 缓存无法读取，不再重试
+    QMutex m_kdTreeMutex;   // 构建期间持有，不占用 CPU 数据的锁
+    mutable QRecursiveMutex m_gpuMutex;
+
+    QString m_fileName;
+    QString m_fileKey;
+    std::shared_ptr<const PointCloudData> m_cloud;
+    std::shared_ptr<const PointCloudKdTree> m_kdTree;   // 与 CPU 数据一起计入内存预算、一起释放
+    PointCloudStats m_stats;
+    PointCloudSpacing m_spacing;
+    int m_spacingGeneration = 0;
+    std::vector<PointCloudBox> m_chunkBounds;
+    size_t m_pointCount = 0;
+    PointCloudOrigin m_origin;
+    bool m_hasColor = false;
+
+    QOpenGLBuffer m_vbo;
+    qint64 m_gpuBytes = 0;
+    qint64 m_uploadedBytes = 0;
+    GLsync m_uploadFence = nullptr;   // 最近一次上传的同步对象
+    int m_gpuGeneration = 0;
+
+    QString m_cacheFile;          // 已写好的缓存文件
+    bool m_ownsCacheFile = false; // 缓存由本实例写出，析构时删除
+
+    mutable QMutex m_editMutex;
+    std::shared_ptr<const PointCloudSelection> m_deleted;
+    std::vector<std::shared_ptr<const PointCloudSelection>> m_undo;   // 之前的删除标记，与当前的共享未变的块
+    std::vector<std::shared_ptr<const PointCloudSelection>> m_redo;
+    quint64 m_editVersion = 0;
+    quint64 m_statsVersion = 0;
+    int m_compactions = 0;
+};
@@ -0,0 +1,333 @@
+﻿#include "PointCloudExporter.h"
+#include "PointCloudCache.h"
+
+#include <QSaveFile>
+#include <QFileInfo>
+#include <QDate>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QThread>
+#include <QtConcurrent>
+
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <limits>
+#include <string>
+
+namespace
+{
+    // 每个编码块的点数
+    const size_t kChunkPoints = 256 * 1024;
+
+    const qint64 kIoBlock = qint64(64) << 20;
+
+    bool writeAll(QIODevice& device, const char* data, qint64 size)
+    {
+        while (size > 0) {
+            const qint64 written = device.write(data, qMin(size, kIoBlock));
+            if (written <= 0) return false;
+            data += written;
+            size -= written;
+        }
+        return true;
+    }
+
+    using EncodeFn = std::function<std::string(size_t begin, size_t end)>;
+
+    // 分块并行编码，按块顺序写出；同时在途的块数有上限，内存占用与文件大小无关
+    bool writeOrdered(QIODevice& device, size_t pointCount, const EncodeFn& encode)
+    {
+        const size_t chunkCount = (pointCount + kChunkPoints - 1) / kChunkPoints;
+        const size_t maxInFlight = static_cast<size_t>(qMax(2, QThread::idealThreadCount() * 2));
+
+        std::deque<QFuture<std::string>> pending;
+        size_t next = 0;
+        auto submit = [&]() {
+            const size_t begin = next * kChunkPoints;
+            const size_t end = qMin(pointCount, begin + kChunkPoints);
+            pending.push_back(QtConcurrent::run([&encode, begin, end]() { return encode(begin, end); }));
+            ++next;
+        };
+
+        while (next < chunkCount && pending.size() < maxInFlight) submit();
+
+        // 出错后不再提交新块，但要等在途的块结束
+        bool ok = true;
+        while (!pending.empty()) {
+            const std::string block = pending.front().result();
+            pending.pop_front();
+            if (ok && next < chunkCount) submit();
+            ok = ok && writeAll(device, block.data(), static_cast<qint64>(block.size()));
+        }
+        return ok;
+    }
+
+    //////////////////////////////////////////////////////////////////////////
+    // 文本：x y z [intensity] [r g b]，与读取时的列顺序一致
+
+    std::string encodeAscii(const PointCloudData& cloud, size_t begin, size_t end)
+    {
+        const bool hasIntensity = !cloud.intensity.empty();
+        const size_t kLineReserve = 2048;   // 单行最坏情况的长度上限
+
+        std::string out;
+        out.resize((end - begin) * 64 + kLineReserve);
+        size_t used = 0;
+
+        for (size_t i = begin; i < end; ++i) {
+            if (out.size() - used < kLineReserve) out.resize(out.size() * 2);
+
+            char* p = &out[0] + used;
+            char* const limit = &out[0] + out.size();
+
+            double xyz[3];
+            cloud.worldPosition(i, xyz[0], xyz[1], xyz[2]);
+            for (int k = 0; k < 3; ++k) {
+                if (k > 0) *p++ = ' ';
+                p = std::to_chars(p, limit, xyz[k], std::chars_format::fixed, 3).ptr;
+            }
+
+            if (hasIntensity) {
+                *p++ = ' ';
+                p = std::to_chars(p, limit, cloud.intensity[i]).ptr;
+            }
+
+            if (cloud.hasColor) {
+                const float* c = cloud.points.data() + i * PointCloudData::kFloatsPerPoint + 3;
+                for (int k = 0; k < 3; ++k) {
+                    *p++ = ' ';
+                    p = std::to_chars(p, limit, static_cast<int>(c[k] * 255.0f + 0.5f)).ptr;
+                }
+            }
+
+            *p++ = '\n';
+            used = static_cast<size_t>(p - out.data());
+        }
+
+        out.resize(used);
+        return out;
+    }
+
+    bool writeAscii(const PointCloudData& cloud, QIODevice& device)
+    {
+        return writeOrdered(device, cloud.pointCount(), [&cloud](size_t begin, size_t end) {
+            return encodeAscii(cloud, begin, end);
+        });
+    }
+
+    //////////////////////////////////////////////////////////////////////////
+    // LAS 1.2，点格式 0（无颜色）或 2（带 RGB）
+
+#pragma pack(push, 1)
+    struct LasHeader
+    {
+        char signature[4];
+        quint16 fileSourceId;
+        quint16 globalEncoding;
+        quint32 guid1;
+        quint16 guid2;
+        quint16 guid3;
+        quint8 guid4[8];
+        quint8 versionMajor;
+        quint8 versionMinor;
+        char systemIdentifier[32];
+        char generatingSoftware[32];
+        quint16 creationDay;
+        quint16 creationYear;
+        quint16 headerSize;
+        quint32 pointDataOffset;
+        quint32 numberOfVlrs;
+        quint8 pointFormat;
+        quint16 pointRecordLength;
+        quint32 pointCount;
+        quint32 pointsByReturn[5];
+        double scale[3];
+        double offset[3];
+        double maxX, minX, maxY, minY, maxZ, minZ;
+    };
+
+    struct LasPoint
+    {
+        qint32 x, y, z;
+        quint16 intensity;
+        quint8 returnInfo;
+        quint8 classification;
+        qint8 scanAngle;
+        quint8 userData;
+        quint16 pointSourceId;
+        quint16 red, green, blue;   // 仅格式 2
+    };
+#pragma pack(pop)
+
+    static_assert(sizeof(LasHeader) == 227, "LAS 1.2 header must be 227 bytes");
+    static_assert(sizeof(LasPoint) == 26, "LAS point format 2 must be 26 bytes");
+
+    const double kLasScale = 0.001;   // 毫米
+
+    std::string encodeLas(const PointCloudData& cloud, size_t begin, size_t end, quint16 recordLength)
+    {
+        const bool hasIntensity = !cloud.intensity.empty();
+
+        std::string out;
+        out.resize((end - begin) * recordLength);
+        char* dst = &out[0];
+
+        for (size_t i = begin; i < end; ++i, dst += recordLength) {
+            const float* p = cloud.points.data() + i * PointCloudData::kFloatsPerPoint;
+
+            LasPoint point = {};
+            // 偏移量就是局部原点，局部坐标直接按比例换算
+            point.x = static_cast<qint32>(std::llround(p[0] / kLasScale));
+            point.y = static_cast<qint32>(std::llround(p[1] / kLasScale));
+            point.z = static_cast<qint32>(std::llround(p[2] / kLasScale));
+            if (hasIntensity) {
+                point.intensity = static_cast<quint16>(qBound(0.0f, cloud.intensity[i], 65535.0f) + 0.5f);
+            }
+            point.returnInfo = 0x09;   // 第 1 次回波，共 1 次
+            point.red = static_cast<quint16>(p[3] * 65535.0f + 0.5f);
+            point.green = static_cast<quint16>(p[4] * 65535.0f + 0.5f);
+            point.blue = static_cast<quint16>(p[5] * 65535.0f + 0.5f);
+
+            std::memcpy(dst, &point, recordLength);
+        }
+        return out;
+    }
+
+    bool writeLas(const PointCloudData& cloud, QIODevice& device)
+    {
+        const size_t count = cloud.pointCount();
+        if (count > std::numeric_limits<quint32>::max()) {
+            qWarning() << "LAS 1.2 supports at most 2^32-1 points";
+            return false;
+        }
+
+        float minLocal[3] = { 0.0f, 0.0f, 0.0f };
+        float maxLocal[3] = { 0.0f, 0.0f, 0.0f };
+        for (size_t i = 0; i < count; ++i) {
+            const float* p = cloud.points.data() + i * PointCloudData::kFloatsPerPoint;
+            for (int k = 0; k < 3; ++k) {
+                if (i == 0 || p[k] < minLocal[k]) minLocal[k] = p[k];
+                if (i == 0 || p[k] > maxLocal[k]) maxLocal[k] = p[k];
+            }
+        }
+
+        // 毫米精度下的整数坐标必须落在 int32 范围内
+        const double limit = std::numeric_limits<qint32>::max() * kLasScale;
+        for (int k = 0; k < 3; ++k) {
+            if (std::fabs(minLocal[k]) > limit || std::fabs(maxLocal[k]) > limit) {
+                qWarning() << "Point cloud extent too large for LAS millimetre scale";
+                return false;
+            }
+        }
+
+        const quint16 recordLength = cloud.hasColor ? 26 : 20;
+
+        LasHeader header = {};
+        std::memcpy(header.signature, "LASF", 4);
+        header.versionMajor = 1;
+        header.versionMinor = 2;
+        std::strncpy(header.systemIdentifier, "EXPORT", sizeof(header.systemIdentifier));
+        std::strncpy(header.generatingSoftware, "BCGP GLSLViewer", sizeof(header.generatingSoftware));
+        const QDate today = QDate::currentDate();
+        header.creationDay = static_cast<quint16>(today.dayOfYear());
+        header.creationYear = static_cast<quint16>(today.year());
+        header.headerSize = sizeof(LasHeader);
+        header.pointDataOffset = sizeof(LasHeader);
+        header.pointFormat = cloud.hasColor ? 2 : 0;
+        header.pointRecordLength = recordLength;
+        header.pointCount = static_cast<quint32>(count);
+        header.pointsByReturn[0] = static_cast<quint32>(count);
+        header.scale[0] = header.scale[1] = header.scale[2] = kLasScale;
+        header.offset[0] = cloud.origin.x;
+        header.offset[1] = cloud.origin.y;
+        header.offset[2] = cloud.origin.z;
+        header.minX = cloud.origin.x + minLocal[0];
+        header.maxX = cloud.origin.x + maxLocal[0];
+        header.minY = cloud.origin.y + minLocal[1];
+        header.maxY = cloud.origin.y + maxLocal[1];
+        header.minZ = cloud.origin.z + minLocal[2];
+        header.maxZ = cloud.origin.z + maxLocal[2];
+
+        if (!writeAll(device, reinterpret_cast<const char*>(&header), sizeof(header))) return false;
+
+        return writeOrdered(device, count, [&cloud, recordLength](size_t begin, size_t end) {
+            return encodeLas(cloud, begin, end, recordLength);
+        });
+    }
+}
+
+PointCloudExporter::Format PointCloudExporter::formatFromFileName(const QString& filename)
+{
+    const QString suffix = QFileInfo(filename).suffix().toLower();
+    if (suffix == PointCloudCache::suffix()) return BinaryCache;
+    if (suffix == QLatin1String("las")) return Las;
+    return Ascii;
+}
+
+QString PointCloudExporter::fileFilter()
+{
+    return QStringLiteral("Point cloud text (*.txt *.xyz *.csv);;LAS 1.2 (*.las);;Binary cache (*.%1)")
+        .arg(PointCloudCache::suffix());
+}
+
+bool PointCloudExporter::exportToFile(const PointCloudData& cloud, const QString& filename, Format format)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    bool ok = false;
+    if (format == BinaryCache) {
+        ok = PointCloudCache::write(cloud, filename);
+    }
+    else {
+        QSaveFile file(filename);
+        if (!file.open(QIODevice::WriteOnly)) {
+            qWarning() << "Cannot write file:" << filename;
+            return false;
+        }
+
+        ok = (format == Las) ? writeLas(cloud, file) : writeAscii(cloud, file);
+        if (ok) {
+            ok = file.commit();
+        }
+        else {
+            file.cancelWriting();
+        }
+    }
+
+    if (!ok) {
+        qWarning() << "Failed to export point cloud:" << filename;
+        return false;
+    }
+
+    const double seconds = qMax(timer.nsecsElapsed() * 1e-9, 1e-9);
+    qDebug() << "Exported" << cloud.pointCount() << "points to" << filename
+             << "MB/s:" << QFileInfo(filename).size() / seconds / 1e6;
+    return true;
+}
+
+QFuture<bool> PointCloudExporter::exportAsync(std::shared_ptr<const PointCloudData> cloud,
+    const QString& filename, Format format)
+{
+    return QtConcurrent::run([cloud, filename, format]() {
+        return cloud && exportToFile(*cloud, filename, format);
+    });
+}
+
+QFuture<bool> PointCloudExporter::exportAsync(std::shared_ptr<const PointCloudData> cloud,
+    std::shared_ptr<const PointCloudSelection> deleted, std::shared_ptr<const PointCloudClipping> clipping,
+    const QString& filename, Format format)
+{
+    return QtConcurrent::run([cloud, deleted, clipping, filename, format]() {
+        if (!cloud) return false;
+        std::shared_ptr<const PointCloudData> data = cloud;
+        if (deleted && !deleted->empty() && deleted->pointCount() == cloud->pointCount()) {
+            data = deleted->extractUnselected(*data);
+        }
+        if (clipping && !clipping->empty()) data = clipping->bake(*data);
+        return exportToFile(*data, filename, format);
+    });
+}
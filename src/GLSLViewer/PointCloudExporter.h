@@ -0,0 +1,42 @@
+﻿#pragma once
+
+#include "glslviewer_global.h"
+#include "PointCloudData.h"
+#include "PointCloudClipping.h"
+#include "PointCloudSelection.h"
+
+#include <QString>
+#include <QFuture>
+
+#include <memory>
+
+// 点云导出：二进制缓存、LAS 1.2、文本
+// 文本和 LAS 按块并行编码、按顺序写出；写入先到临时文件，成功后再替换目标文件
+class GLSLVIEWER_EXPORT PointCloudExporter
+{
+public:
+    enum Format
+    {
+        BinaryCache,
+        Las,
+        Ascii
+    };
+
+    // 按扩展名选择格式，未知扩展名按文本处理
+    static Format formatFromFileName(const QString& filename);
+
+    // 保存对话框使用的过滤器
+    static QString fileFilter();
+
+    static bool exportToFile(const PointCloudData& cloud, const QString& filename, Format format);
+
+    // 在后台线程导出，cloud 的引用保持到导出结束
+    static QFuture<bool> exportAsync(std::shared_ptr<const PointCloudData> cloud,
+        const QString& filename, Format format);
+
+    // 导出编辑、裁剪结果：在后台线程中先去掉 deleted 中（已删除）的点、再按 clipping 裁剪后写出，
+    // 两者都可以为空；deleted 与 cloud 点数不一致时忽略
+    static QFuture<bool> exportAsync(std::shared_ptr<const PointCloudData> cloud,
+        std::shared_ptr<const PointCloudSelection> deleted, std::shared_ptr<const PointCloudClipping> clipping,
+        const QString& filename, Format format);
+};
@@ -0,0 +1,418 @@
+﻿#include "PointCloudKdTree.h"
+
+#include <QtConcurrent>
+#include <QThread>
+#include <QFile>
+#include <QSaveFile>
+#include <QElapsedTimer>
+#include <QDebug>
+
+#include <algorithm>
+#include <cstring>
+#include <random>
+
+namespace
+{
+    const char kMagic[4] = { 'B', 'C', 'K', 'D' };
+    const quint32 kVersion = 1;
+
+    // 并行构建和批量查询的分块
+    const size_t kChunkPoints = 256 * 1024;
+    const size_t kChunkQueries = 1024;
+
+#pragma pack(push, 1)
+    struct TreeHeader
+    {
+        char magic[4];
+        quint32 version;
+        quint64 pointCount;
+        quint32 leafSize;
+    };
+#pragma pack(pop)
+
+    struct Range
+    {
+        size_t begin;
+        size_t end;
+    };
+
+    using Entry = PointCloudKdTree::Entry;
+    using Neighbor = PointCloudKdTree::Neighbor;
+
+    inline float distanceSquared(const Entry& entry, const float q[3])
+    {
+        const float dx = entry.position[0] - q[0];
+        const float dy = entry.position[1] - q[1];
+        const float dz = entry.position[2] - q[2];
+        return dx * dx + dy * dy + dz * dz;
+    }
+
+    inline bool closer(const Neighbor& a, const Neighbor& b)
+    {
+        return a.distanceSquared < b.distanceSquared;
+    }
+
+    // 按区间包围盒的最长轴在中点处划分，返回分割轴；叶子不划分
+    void splitRange(Entry* entries, quint8* axes, const Range& range)
+    {
+        if (range.end - range.begin <= static_cast<size_t>(PointCloudKdTree::kLeafSize)) return;
+
+        float lo[3] = { entries[range.begin].position[0], entries[range.begin].position[1], entries[range.begin].position[2] };
+        float hi[3] = { lo[0], lo[1], lo[2] };
+        for (size_t i = range.begin + 1; i < range.end; ++i) {
+            for (int k = 0; k < 3; ++k) {
+                lo[k] = std::min(lo[k], entries[i].position[k]);
+                hi[k] = std::max(hi[k], entries[i].position[k]);
+            }
+        }
+        int axis = 0;
+        if (hi[1] - lo[1] > hi[axis] - lo[axis]) axis = 1;
+        if (hi[2] - lo[2] > hi[axis] - lo[axis]) axis = 2;
+
+        const size_t middle = (range.begin + range.end) / 2;
+        std::nth_element(entries + range.begin, entries + middle, entries + range.end,
+            [axis](const Entry& a, const Entry& b) { return a.position[axis] < b.position[axis]; });
+        axes[middle] = static_cast<quint8>(axis);
+    }
+
+    void splitChildren(const Range& range, std::vector<Range>& children)
+    {
+        if (range.end - range.begin <= static_cast<size_t>(PointCloudKdTree::kLeafSize)) return;
+
+        const size_t middle = (range.begin + range.end) / 2;
+        children.push_back({ range.begin, middle });
+        children.push_back({ middle + 1, range.end });
+    }
+
+    // 一个线程完成整棵子树
+    void buildSubtree(Entry* entries, quint8* axes, const Range& root)
+    {
+        std::vector<Range> stack(1, root);
+        while (!stack.empty()) {
+            const Range range = stack.back();
+            stack.pop_back();
+            splitRange(entries, axes, range);
+            splitChildren(range, stack);
+        }
+    }
+
+    // 递归深度约为 log2(n / kLeafSize)，先进入查询点所在的一侧，另一侧只在可能更近时访问
+    // Visitor::bound() 为当前的剪枝距离（平方），visit 处理一个点
+    template <typename Visitor>
+    void search(const Entry* entries, const quint8* axes, size_t begin, size_t end, const float q[3], Visitor& visitor)
+    {
+        if (end - begin <= static_cast<size_t>(PointCloudKdTree::kLeafSize)) {
+            for (size_t i = begin; i < end; ++i) visitor.visit(entries[i], distanceSquared(entries[i], q));
+            return;
+        }
+
+        const size_t middle = (begin + end) / 2;
+        const int axis = axes[middle];
+        const float diff = q[axis] - entries[middle].position[axis];
+        visitor.visit(entries[middle], distanceSquared(entries[middle], q));
+
+        if (diff < 0.0f) {
+            search(entries, axes, begin, middle, q, visitor);
+            if (diff * diff <= visitor.bound()) search(entries, axes, middle + 1, end, q, visitor);
+        }
+        else {
+            search(entries, axes, middle + 1, end, q, visitor);
+            if (diff * diff <= visitor.bound()) search(entries, axes, begin, middle, q, visitor);
+        }
+    }
+
+    // 最大堆保存当前最近的 k 个点
+    struct KnnVisitor
+    {
+        Neighbor* heap;
+        int k;
+        int size = 0;
+
+        float bound() const
+        {
+            return size < k ? std::numeric_limits<float>::infinity() : heap[0].distanceSquared;
+        }
+
+        void visit(const Entry& entry, float d2)
+        {
+            if (size < k) {
+                heap[size++] = { entry.index, d2 };
+                std::push_heap(heap, heap + size, closer);
+            }
+            else if (d2 < heap[0].distanceSquared) {
+                std::pop_heap(heap, heap + size, closer);
+                heap[size - 1] = { entry.index, d2 };
+                std::push_heap(heap, heap + size, closer);
+            }
+        }
+    };
+
+    struct RadiusVisitor
+    {
+        std::vector<Neighbor>& result;
+        float radiusSquared;
+
+        float bound() const { return radiusSquared; }
+
+        void visit(const Entry& entry, float d2)
+        {
+            if (d2 <= radiusSquared) result.push_back({ entry.index, d2 });
+        }
+    };
+
+    std::vector<Range> chunks(size_t count, size_t chunkSize)
+    {
+        std::vector<Range> ranges;
+        for (size_t begin = 0; begin < count; begin += chunkSize) {
+            ranges.push_back({ begin, std::min(count, begin + chunkSize) });
+        }
+        return ranges;
+    }
+
+    bool writeAll(QIODevice& device, const char* data, qint64 size)
+    {
+        const qint64 block = qint64(64) << 20;
+        while (size > 0) {
+            const qint64 written = device.write(data, qMin(size, block));
+            if (written <= 0) return false;
+            data += written;
+            size -= written;
+        }
+        return true;
+    }
+
+    bool readAll(QIODevice& device, char* data, qint64 size)
+    {
+        const qint64 block = qint64(64) << 20;
+        while (size > 0) {
+            const qint64 got = device.read(data, qMin(size, block));
+            if (got <= 0) return false;
+            data += got;
+            size -= got;
+        }
+        return true;
+    }
+}
+
+// 上面几层子树少，逐层并行划分；子树数达到线程数的几倍后各自整体构建
+bool PointCloudKdTree::build(const PointCloudData& cloud)
+{
+    clear();
+    const size_t count = cloud.pointCount();
+    if (count == 0) return false;
+    if (count >= kInvalidIndex) {
+        qWarning() << "Too many points for k-d tree:" << count;
+        return false;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    m_entries.resize(count);
+    m_axes.assign(count, 0);
+    Entry* entries = m_entries.data();
+    quint8* axes = m_axes.data();
+
+    std::vector<Range> fill = chunks(count, kChunkPoints);
+    QtConcurrent::blockingMap(fill, [&](const Range& range) {
+        const float* p = cloud.points.data() + range.begin * PointCloudData::kFloatsPerPoint;
+        for (size_t i = range.begin; i < range.end; ++i, p += PointCloudData::kFloatsPerPoint) {
+            entries[i] = { { p[0], p[1], p[2] }, static_cast<quint32>(i) };
+        }
+    });
+
+    const size_t subtreeTarget = static_cast<size_t>(std::max(1, QThread::idealThreadCount())) * 4;
+    std::vector<Range> level(1, Range{ 0, count });
+    while (!level.empty() && level.size() < subtreeTarget) {
+        if (level.size() == 1) splitRange(entries, axes, level.front());
+        else QtConcurrent::blockingMap(level, [&](const Range& range) { splitRange(entries, axes, range); });
+
+        std::vector<Range> next;
+        next.reserve(level.size() * 2);
+        for (const Range& range : level) splitChildren(range, next);
+        level.swap(next);
+    }
+    QtConcurrent::blockingMap(level, [&](const Range& range) { buildSubtree(entries, axes, range); });
+
+    qDebug() << "Built k-d tree for" << count << "points in" << timer.elapsed() << "ms";
+    return true;
+}
+
+void PointCloudKdTree::clear()
+{
+    m_entries.clear();
+    m_entries.shrink_to_fit();
+    m_axes.clear();
+    m_axes.shrink_to_fit();
+}
+
+qint64 PointCloudKdTree::memoryBytes() const
+{
+    return static_cast<qint64>(m_entries.capacity() * sizeof(Entry) + m_axes.capacity());
+}
+
+void PointCloudKdTree::knn(const float query[3], int k, std::vector<Neighbor>& result) const
+{
+    result.resize(static_cast<size_t>(std::max(0, k)));
+    if (k <= 0 || empty()) {
+        result.clear();
+        return;
+    }
+
+    KnnVisitor visitor{ result.data(), k };
+    search(m_entries.data(), m_axes.data(), 0, m_entries.size(), query, visitor);
+    result.resize(visitor.size);
+    std::sort_heap(result.begin(), result.end(), closer);
+}
+
+void PointCloudKdTree::radius(const float query[3], float radius, std::vector<Neighbor>& result) const
+{
+    result.clear();
+    if (radius < 0.0f || empty()) return;
+
+    RadiusVisitor visitor{ result, radius * radius };
+    search(m_entries.data(), m_axes.data(), 0, m_entries.size(), query, visitor);
+    std::sort(result.begin(), result.end(), closer);
+}
+
+void PointCloudKdTree::knnBatch(const float* queries, size_t count, int k,
+    std::vector<quint32>& indices, std::vector<float>& distancesSquared) const
+{
+    const size_t stride = static_cast<size_t>(std::max(0, k));
+    indices.assign(count * stride, kInvalidIndex);
+    distancesSquared.assign(count * stride, std::numeric_limits<float>::infinity());
+    if (stride == 0 || empty()) return;
+
+    std::vector<Range> ranges = chunks(count, kChunkQueries);
+    QtConcurrent::blockingMap(ranges, [&](const Range& range) {
+        std::vector<Neighbor> neighbors;
+        for (size_t i = range.begin; i < range.end; ++i) {
+            knn(queries + i * 3, k, neighbors);
+            for (size_t j = 0; j < neighbors.size(); ++j) {
+                indices[i * stride + j] = neighbors[j].index;
+                distancesSquared[i * stride + j] = neighbors[j].distanceSquared;
+            }
+        }
+    });
+}
+
+void PointCloudKdTree::radiusBatch(const float* queries, size_t count, float radius,
+    std::vector<std::vector<Neighbor>>& results) const
+{
+    results.resize(count);
+    std::vector<Range> ranges = chunks(count, kChunkQueries);
+    QtConcurrent::blockingMap(ranges, [&](const Range& range) {
+        for (size_t i = range.begin; i < range.end; ++i) this->radius(queries + i * 3, radius, results[i]);
+    });
+}
+
+void PointCloudKdTree::benchmark(size_t queryCount, int k, float radius) const
+{
+    if (empty() || queryCount == 0) return;
+
+    // 查询点取自数据本身，每个查询至少有一个近邻，与吸附、法线等实际用法一致
+    std::mt19937 random(12345);
+    std::uniform_int_distribution<size_t> pick(0, m_entries.size() - 1);
+    std::vector<float> queries(queryCount * 3);
+    for (size_t i = 0; i < queryCount; ++i) {
+        const Entry& entry = m_entries[pick(random)];
+        std::memcpy(&queries[i * 3], entry.position, sizeof(entry.position));
+    }
+
+    auto rate = [queryCount](qint64 nsecs) { return queryCount * 1e9 / std::max<qint64>(nsecs, 1); };
+    QElapsedTimer timer;
+
+    std::vector<Neighbor> neighbors;
+    size_t found = 0;
+    timer.start();
+    for (size_t i = 0; i < queryCount; ++i) {
+        knn(&queries[i * 3], k, neighbors);
+        found += neighbors.size();
+    }
+    const double knnSingle = rate(timer.nsecsElapsed());
+
+    std::vector<quint32> indices;
+    std::vector<float> distances;
+    timer.restart();
+    knnBatch(queries.data(), queryCount, k, indices, distances);
+    const double knnParallel = rate(timer.nsecsElapsed());
+
+    timer.restart();
+    for (size_t i = 0; i < queryCount; ++i) {
+        this->radius(&queries[i * 3], radius, neighbors);
+        found += neighbors.size();
+    }
+    const double radiusSingle = rate(timer.nsecsElapsed());
+
+    std::vector<std::vector<Neighbor>> radiusResults;
+    timer.restart();
+    radiusBatch(queries.data(), queryCount, radius, radiusResults);
+    const double radiusParallel = rate(timer.nsecsElapsed());
+
+    qDebug().nospace() << "k-d tree benchmark (" << m_entries.size() << " points, " << queryCount << " queries): "
+        << "kNN k=" << k << " " << qRound64(knnSingle) << " q/s single, " << qRound64(knnParallel) << " q/s batched; "
+        << "radius r=" << radius << " " << qRound64(radiusSingle) << " q/s single, " << qRound64(radiusParallel) << " q/s batched"
+        << " (" << found << " neighbors)";
+}
+
+// 文件头之后直接是重排后的点和分割轴，与内存布局一致
+bool PointCloudKdTree::write(const QString& filename) const
+{
+    QSaveFile file(filename);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Cannot write k-d tree file:" << filename;
+        return false;
+    }
+
+    TreeHeader header;
+    std::memcpy(header.magic, kMagic, 4);
+    header.version = kVersion;
+    header.pointCount = m_entries.size();
+    header.leafSize = kLeafSize;
+
+    bool ok = writeAll(file, reinterpret_cast<const char*>(&header), sizeof(header));
+    ok = ok && writeAll(file, reinterpret_cast<const char*>(m_entries.data()),
+        static_cast<qint64>(m_entries.size() * sizeof(Entry)));
+    ok = ok && writeAll(file, reinterpret_cast<const char*>(m_axes.data()), static_cast<qint64>(m_axes.size()));
+
+    if (!ok) {
+        file.cancelWriting();
+        qWarning() << "Failed to write k-d tree file:" << filename;
+        return false;
+    }
+    return file.commit();
+}
+
+bool PointCloudKdTree::read(const QString& filename, size_t pointCount)
+{
+    clear();
+
+    QFile file(filename);
+    if (!file.open(QIODevice::ReadOnly)) return false;
+
+    TreeHeader header;
+    if (file.read(reinterpret_cast<char*>(&header), sizeof(header)) != sizeof(header)
+        || std::memcmp(header.magic, kMagic, 4) != 0
+        || header.version != kVersion
+        || header.leafSize != static_cast<quint32>(kLeafSize)
+        || header.pointCount != pointCount) {
+        qWarning() << "Stale or invalid k-d tree file:" << filename;
+        return false;
+    }
+
+    const quint64 expected = sizeof(header) + header.pointCount * (sizeof(Entry) + 1);
+    if (static_cast<quint64>(file.size()) < expected) {
+        qWarning() << "Truncated k-d tree file:" << filename;
+        return false;
+    }
+
+    m_entries.resize(pointCount);
+    m_axes.resize(pointCount);
+    const bool ok = readAll(file, reinterpret_cast<char*>(m_entries.data()), static_cast<qint64>(pointCount * sizeof(Entry)))
+        && readAll(file, reinterpret_cast<char*>(m_axes.data()), static_cast<qint64>(pointCount));
+    if (!ok) {
+        clear();
+        qWarning() << "Failed to read k-d tree file:" << filename;
+    }
+    return ok;
+}
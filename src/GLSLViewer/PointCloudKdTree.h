@@ -0,0 +1,67 @@
+﻿#pragma once
+
+#include "glslviewer_global.h"
+#include "PointCloudData.h"
+
+#include <QString>
+#include <vector>
+#include <limits>
+
+// 点云 k-d 树（隐式布局），用于近邻查询（kNN、半径）：量测吸附、滤波、法线、配准、聚类等
+// 点按树的顺序重排为 {x, y, z, 原序号} 连续存放：区间 [b, e) 的中点 m = (b + e) / 2 为节点，
+// 左子树为 [b, m)，右子树为 [m + 1, e)，不存子节点指针，每个节点另存 1 字节分割轴；
+// 不超过 kLeafSize 个点的区间为叶子，线性扫描。查询访问的点在内存中基本连续
+// 构建按层并行划分，子树足够多后每个子树整体交给一个线程
+// 查询只读，可以在多个线程中同时进行；批量查询按块并行
+// 坐标为局部坐标（相对数据集 origin），与 PointCloudData::points 一致
+class GLSLVIEWER_EXPORT PointCloudKdTree
+{
+public:
+    static constexpr int kLeafSize = 16;
+    static constexpr quint32 kInvalidIndex = std::numeric_limits<quint32>::max();
+
+    struct Entry
+    {
+        float position[3];
+        quint32 index;      // 点在数据集中的序号
+    };
+
+    struct Neighbor
+    {
+        quint32 index;
+        float distanceSquared;
+    };
+
+    // 文件扩展名，放在二进制缓存旁边
+    static QString suffix() { return QStringLiteral("bckd"); }
+
+    bool build(const PointCloudData& cloud);
+    void clear();
+
+    size_t size() const { return m_entries.size(); }
+    bool empty() const { return m_entries.empty(); }
+    qint64 memoryBytes() const;
+
+    // 最近的 k 个点，按距离从近到远
+    void knn(const float query[3], int k, std::vector<Neighbor>& result) const;
+    // 距离不超过 radius 的所有点，按距离从近到远
+    void radius(const float query[3], float radius, std::vector<Neighbor>& result) const;
+
+    // 批量查询，queries 为 count 个 xyz
+    // kNN 结果每个查询占 k 项，不足 k 个时用 kInvalidIndex 和无穷大补齐
+    void knnBatch(const float* queries, size_t count, int k,
+        std::vector<quint32>& indices, std::vector<float>& distancesSquared) const;
+    void radiusBatch(const float* queries, size_t count, float radius,
+        std::vector<std::vector<Neighbor>>& results) const;
+
+    // 在数据集中随机取点作为查询，输出单线程和批量查询的每秒查询数
+    void benchmark(size_t queryCount, int k, float radius) const;
+
+    // 持久化：pointCount 与数据集不一致时视为过期
+    bool write(const QString& filename) const;
+    bool read(const QString& filename, size_t pointCount);
+
+private:
+    std::vector<Entry> m_entries;
+    std::vector<quint8> m_axes;   // 以节点（区间中点）的位置索引
+};
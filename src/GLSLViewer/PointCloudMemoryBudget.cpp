@@ -0,0 +1,153 @@
+﻿#include "PointCloudMemoryBudget.h"
+
+#include <QMutex>
+#include <QMutexLocker>
+#include <QDebug>
+
+#include <algorithm>
+#include <vector>
+
+namespace
+{
+    struct Entry
+    {
+        std::weak_ptr<PointCloudDataset> dataset;
+        quint64 lastUse = 0;
+    };
+
+    struct Budget
+    {
+        QMutex mutex;
+        qint64 cpuBudget = qint64(8) << 30;   // 8GB
+        qint64 gpuBudget = qint64(2) << 30;   // 2GB
+        quint64 clock = 0;
+        std::vector<Entry> entries;
+
+        // 去掉已释放的数据集，按最近最少使用排序
+        std::vector<std::pair<quint64, std::shared_ptr<PointCloudDataset>>> lruOrder()
+        {
+            entries.erase(std::remove_if(entries.begin(), entries.end(),
+                [](const Entry& e) { return e.dataset.expired(); }), entries.end());
+
+            std::vector<std::pair<quint64, std::shared_ptr<PointCloudDataset>>> order;
+            for (const Entry& e : entries) {
+                if (auto d = e.dataset.lock()) order.emplace_back(e.lastUse, std::move(d));
+            }
+            std::sort(order.begin(), order.end(),
+                [](const auto& a, const auto& b) { return a.first < b.first; });
+            return order;
+        }
+    };
+
+    Budget& budget()
+    {
+        static Budget b;
+        return b;
+    }
+}
+
+void PointCloudMemoryBudget::setCpuBudget(qint64 bytes)
+{
+    QMutexLocker locker(&budget().mutex);
+    budget().cpuBudget = bytes;
+}
+
+void PointCloudMemoryBudget::setGpuBudget(qint64 bytes)
+{
+    QMutexLocker locker(&budget().mutex);
+    budget().gpuBudget = bytes;
+}
+
+qint64 PointCloudMemoryBudget::cpuBudget()
+{
+    QMutexLocker locker(&budget().mutex);
+    return budget().cpuBudget;
+}
+
+qint64 PointCloudMemoryBudget::gpuBudget()
+{
+    QMutexLocker locker(&budget().mutex);
+    return budget().gpuBudget;
+}
+
+void PointCloudMemoryBudget::touch(const std::shared_ptr<PointCloudDataset>& dataset)
+{
+    if (!dataset) return;
+
+    Budget& b = budget();
+    QMutexLocker locker(&b.mutex);
+    const quint64 now = ++b.clock;
+    for (Entry& e : b.entries) {
+        if (e.dataset.lock() == dataset) {
+            e.lastUse = now;
+            return;
+        }
+    }
+    b.entries.push_back({ dataset, now });
+}
+
+qint64 PointCloudMemoryBudget::cpuUsage()
+{
+    Budget& b = budget();
+    QMutexLocker locker(&b.mutex);
+    qint64 total = 0;
+    for (const auto& item : b.lruOrder()) total += item.second->cpuBytes();
+    return total;
+}
+
+qint64 PointCloudMemoryBudget::gpuUsage()
+{
+    Budget& b = budget();
+    QMutexLocker locker(&b.mutex);
+    qint64 total = 0;
+    for (const auto& item : b.lruOrder()) total += item.second->gpuBytes();
+    return total;
+}
+
+// 持锁只决定释放哪些数据集，释放在锁外进行：CPU 数据的缓存写入在后台线程，
+// 其它线程查询预算时不会等待
+void PointCloudMemoryBudget::enforce()
+{
+    std::vector<std::shared_ptr<PointCloudDataset>> gpuVictims;
+    std::vector<std::shared_ptr<PointCloudDataset>> cpuVictims;
+    qint64 gpu = 0, cpu = 0, gpuLimit = 0, cpuLimit = 0;
+    {
+        Budget& b = budget();
+        QMutexLocker locker(&b.mutex);
+
+        auto order = b.lruOrder();
+        for (const auto& item : order) {
+            gpu += item.second->gpuBytes();
+            cpu += item.second->cpuBytes();
+        }
+        gpuLimit = b.gpuBudget;
+        cpuLimit = b.cpuBudget;
+        if (gpu <= gpuLimit && cpu <= cpuLimit) return;
+
+        // 最近使用的一个不参与释放
+        if (!order.empty()) order.pop_back();
+
+        // 先释放 GPU，再释放 CPU
+        for (const auto& item : order) {
+            if (gpu <= gpuLimit) break;
+            const qint64 bytes = item.second->gpuBytes();
+            if (bytes == 0) continue;
+            gpuVictims.push_back(item.second);
+            gpu -= bytes;
+        }
+        for (const auto& item : order) {
+            if (cpu <= cpuLimit) break;
+            const qint64 bytes = item.second->cpuBytes();
+            if (bytes == 0) continue;
+            cpuVictims.push_back(item.second);
+            cpu -= bytes;
+        }
+    }
+
+    for (const auto& dataset : gpuVictims) dataset->evictGpu();
+    for (const auto& dataset : cpuVictims) dataset->evictCpu();
+
+    if (gpu > gpuLimit || cpu > cpuLimit) {
+        qDebug() << "Memory budget still exceeded, GPU MB:" << gpu / 1e6 << "CPU MB:" << cpu / 1e6;
+    }
+}
@@ -0,0 +1,30 @@
+﻿#pragma once
+
+#include "glslviewer_global.h"
+#include "PointCloudDataset.h"
+
+#include <QtGlobal>
+#include <memory>
+
+// 进程内的 CPU / GPU 内存预算
+// 窗口加载或被激活时登记其数据集并标记为最近使用；超出预算时按最近最少使用的顺序，
+// 先释放 GPU 缓冲，仍超出再释放 CPU 数据（在后台写入二进制缓存后释放，再次使用时恢复）。
+// 最近使用的数据集（当前窗口）不会被释放
+class GLSLVIEWER_EXPORT PointCloudMemoryBudget
+{
+public:
+    static void setCpuBudget(qint64 bytes);
+    static void setGpuBudget(qint64 bytes);
+    static qint64 cpuBudget();
+    static qint64 gpuBudget();
+
+    // 登记数据集并标记为最近使用
+    static void touch(const std::shared_ptr<PointCloudDataset>& dataset);
+
+    // 超出预算时释放；共享组内有当前上下文时 GPU 缓冲立即释放，否则推迟到下次 makeCurrent
+    // CPU 数据在后台写完缓存后才释放，调用方不等待写入
+    static void enforce();
+
+    static qint64 cpuUsage();
+    static qint64 gpuUsage();
+};
@@ -0,0 +1,398 @@
+﻿#include "PointCloudPostProcess.h"
+#include "PointCloudRenderer.h"
+#include "PointCloudShaderLibrary.h"
+
+#include <QVector2D>
+#include <QDebug>
+#include <cmath>
+
+namespace
+{
+    // 图像第 level 级的尺寸
+    QSize levelSize(const QSize& size, int level)
+    {
+        const int scale = 1 << level;
+        return QSize(qMax(1, (size.width() + scale - 1) / scale), qMax(1, (size.height() + scale - 1) / scale));
+    }
+
+    // 金字塔级数：不超过设置，最粗一级至少 1 像素
+    int pyramidLevels(const QSize& size, int requested)
+    {
+        const int limit = static_cast<int>(std::floor(std::log2(qMax(1, qMin(size.width(), size.height())))));
+        return qBound(1, requested, qMax(1, limit));
+    }
+}
+
+PointCloudPostProcess::~PointCloudPostProcess()
+{
+    // 调用方保证创建时的上下文为当前
+    if (!m_initialized) return;
+    releaseTargets();
+    m_screenVao.destroy();
+}
+
+bool PointCloudPostProcess::initialize()
+{
+    if (m_initialized) return true;
+    if (!initializeOpenGLFunctions()) return false;
+
+    m_screenVao.create();
+    m_initialized = true;
+    return true;
+}
+
+bool PointCloudPostProcess::begin(const PointCloudFrameState& state)
+{
+    if (!m_initialized) return false;
+
+    const bool fill = state.holeFill.enabled;
+    const bool edl = state.edl.enabled;
+    if (!fill && !edl) return false;
+
+    const int levels = fill ? pyramidLevels(state.targetSize, state.holeFill.levels) : 0;
+    return ensureTargets(state.targetSize, fill && edl ? 2 : 1, edl && state.edl.halfResolution, levels);
+}
+
+void PointCloudPostProcess::finish(const PointCloudFrameState& state, GLuint target)
+{
+    const bool fill = state.holeFill.enabled && m_pyramidLevels > 0;
+    const bool edl = state.edl.enabled;
+
+    // 两种都开启时先补洞，视觉着色用补好的深度
+    if (fill && edl) {
+        fillHoles(state, m_scene[0], m_scene[1].fbo);
+        eyeDome(state, m_scene[1], target);
+    }
+    else if (fill) {
+        fillHoles(state, m_scene[0], target);
+    }
+    else {
+        eyeDome(state, m_scene[0], target);
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, target);
+    glViewport(0, 0, state.renderSize.width(), state.renderSize.height());
+}
+
+// 着色器变体，创建失败时不反复编译
+QOpenGLShaderProgram* PointCloudPostProcess::program(Pass pass)
+{
+    std::unique_ptr<QOpenGLShaderProgram>& program = m_programs[pass];
+    if (program || m_programFailed[pass]) return program.get();
+
+    static const char* const kDefines[ePassCount] = {
+        nullptr, "EDL_SHADE", "EDL_HALF_RES", "PULL_FROM_SCENE", "PULL", "PUSH", "PUSH_TO_SCENE"
+    };
+    QByteArrayList defines;
+    if (kDefines[pass]) defines << QByteArray(kDefines[pass]);
+
+    const bool edlPass = pass == eEdlComposite || pass == eEdlShade || pass == eEdlCompositeHalf;
+    program = PointCloudShaderLibrary::create(
+        edlPass ? PointCloudShaderLibrary::eEyeDome : PointCloudShaderLibrary::eHoleFill, defines);
+    m_programFailed[pass] = !program;
+    return program.get();
+}
+
+// 尺寸变化时全部重新分配，其余按需补齐
+bool PointCloudPostProcess::ensureTargets(const QSize& size, int sceneTargets, bool edlShade, int pyramidLevels)
+{
+    if (size.isEmpty() || size == m_failedSize) return false;
+    if (size != m_size) {
+        releaseTargets();
+        m_size = size;
+    }
+
+    bool complete = true;
+    for (int i = 0; i < sceneTargets && complete; ++i) {
+        if (!m_scene[i].fbo) complete = createSceneTarget(m_scene[i], size);
+    }
+
+    if (complete && edlShade && !m_edlShadeFbo) {
+        // 明暗系数按线性过滤放大
+        m_edlShade = createTexture(GL_R8, GL_RED, GL_UNSIGNED_BYTE, levelSize(size, 1), GL_LINEAR);
+        glGenFramebuffers(1, &m_edlShadeFbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, m_edlShadeFbo);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_edlShade, 0);
+        complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    }
+
+    if (complete && pyramidLevels > 0 && pyramidLevels != m_pyramidLevels) {
+        complete = createPyramid(m_pull, size, pyramidLevels) && createPyramid(m_push, size, pyramidLevels);
+        m_pyramidLevels = complete ? pyramidLevels : 0;
+    }
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    if (!complete) {
+        qWarning() << "Post-processing framebuffer is incomplete at" << size << ", post-processing disabled";
+        releaseTargets();
+        m_failedSize = size;
+        return false;
+    }
+    return true;
+}
+
+// 深度格式与窗口帧缓冲（CombinedDepthStencil）一致，着色器不可用时可以直接 blit
+bool PointCloudPostProcess::createSceneTarget(SceneTarget& target, const QSize& size)
+{
+    target.color = createTexture(GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, size, GL_NEAREST);
+    target.depth = createTexture(GL_DEPTH24_STENCIL8, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, size, GL_NEAREST);
+    glGenFramebuffers(1, &target.fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, target.fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target.color, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, target.depth, 0);
+    return glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+}
+
+// 每一级一个帧缓冲，颜色和深度分别写到两个附件
+bool PointCloudPostProcess::createPyramid(Pyramid& pyramid, const QSize& size, int levels)
+{
+    for (GLuint fbo : pyramid.fbos) glDeleteFramebuffers(1, &fbo);
+    pyramid.fbos.clear();
+    if (pyramid.color) glDeleteTextures(1, &pyramid.color);
+    if (pyramid.depth) glDeleteTextures(1, &pyramid.depth);
+
+    pyramid.color = createTexture(GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, levelSize(size, 1), GL_NEAREST, levels);
+    pyramid.depth = createTexture(GL_R32F, GL_RED, GL_FLOAT, levelSize(size, 1), GL_NEAREST, levels);
+
+    const GLenum drawBuffers[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+    for (int i = 0; i < levels; ++i) {
+        GLuint fbo = 0;
+        glGenFramebuffers(1, &fbo);
+        pyramid.fbos.push_back(fbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, pyramid.color, i);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, pyramid.depth, i);
+        glDrawBuffers(2, drawBuffers);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) return false;
+    }
+    return true;
+}
+
+GLuint PointCloudPostProcess::createTexture(GLint internalFormat, GLenum format, GLenum type, const QSize& size, GLint filter, int levels)
+{
+    GLuint texture = 0;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+    for (int i = 0; i < levels; ++i) {
+        const QSize mipSize = levelSize(size, i);
+        glTexImage2D(GL_TEXTURE_2D, i, internalFormat, mipSize.width(), mipSize.height(), 0, format, type, nullptr);
+    }
+    return texture;
+}
+
+void PointCloudPostProcess::releaseTargets()
+{
+    for (SceneTarget& target : m_scene) {
+        if (target.fbo) glDeleteFramebuffers(1, &target.fbo);
+        if (target.color) glDeleteTextures(1, &target.color);
+        if (target.depth) glDeleteTextures(1, &target.depth);
+        target = SceneTarget();
+    }
+    if (m_edlShadeFbo) glDeleteFramebuffers(1, &m_edlShadeFbo);
+    if (m_edlShade) glDeleteTextures(1, &m_edlShade);
+    m_edlShadeFbo = m_edlShade = 0;
+
+    for (Pyramid* pyramid : { &m_pull, &m_push }) {
+        for (GLuint fbo : pyramid->fbos) glDeleteFramebuffers(1, &fbo);
+        if (pyramid->color) glDeleteTextures(1, &pyramid->color);
+        if (pyramid->depth) glDeleteTextures(1, &pyramid->depth);
+        *pyramid = Pyramid();
+    }
+    m_pyramidLevels = 0;
+    m_size = QSize();
+}
+
+// 读取金字塔的一级：BASE_LEVEL/MAX_LEVEL 限定为这一级，同一纹理的其它级可以同时作为渲染目标
+void PointCloudPostProcess::bindLevel(GLenum unit, GLuint texture, int level)
+{
+    glActiveTexture(unit);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, level);
+}
+
+void PointCloudPostProcess::drawScreen()
+{
+    m_screenVao.bind();
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    m_screenVao.release();
+}
+
+// pull 从第 1 级到最粗一级，push 再从最粗一级回到第 0 级，第 0 级直接写到 target
+void PointCloudPostProcess::fillHoles(const PointCloudFrameState& state, const SceneTarget& source, GLuint target)
+{
+    const QSize renderSize = state.renderSize;
+    const int levels = qMin(m_pyramidLevels, pyramidLevels(renderSize, state.holeFill.levels));
+    // 透视投影：ndc.z = (A·z + B) / -z，距离 = B / (ndc.z + A)
+    const QVector2D depthParams(state.projection(2, 2), state.projection(2, 3));
+
+    auto setCommonUniforms = [&](QOpenGLShaderProgram* program, int fineLevel) {
+        const QSize fineSize = levelSize(renderSize, fineLevel);
+        program->setUniformValue("uDepthParams", depthParams);
+        program->setUniformValue("uTolerance", state.holeFill.depthTolerance);
+        program->setUniformValue("uMinCoverage", state.holeFill.minCoverage);
+        glUniform2i(program->uniformLocation("uFineSize"), fineSize.width(), fineSize.height());
+    };
+
+    QOpenGLShaderProgram* pullFromScene = program(ePullFromScene);
+    QOpenGLShaderProgram* pull = program(ePull);
+    QOpenGLShaderProgram* push = program(ePush);
+    QOpenGLShaderProgram* pushToScene = program(ePushToScene);
+    if (!pullFromScene || !pull || !push || !pushToScene) {
+        // 着色器不可用时直接复制点云结果
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, source.fbo);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, target);
+        glBlitFramebuffer(0, 0, renderSize.width(), renderSize.height(), 0, 0, renderSize.width(), renderSize.height(),
+            GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+        return;
+    }
+
+    glDisable(GL_DEPTH_TEST);
+
+    // pull：图像第 level 级写到金字塔的第 level-1 个 mip
+    for (int level = 1; level <= levels; ++level) {
+        const QSize size = levelSize(renderSize, level);
+        glBindFramebuffer(GL_FRAMEBUFFER, m_pull.fbos[level - 1]);
+        glViewport(0, 0, size.width(), size.height());
+
+        QOpenGLShaderProgram* shader = level == 1 ? pullFromScene : pull;
+        shader->bind();
+        setCommonUniforms(shader, level - 1);
+        if (level == 1) {
+            bindLevel(GL_TEXTURE0, source.color, 0);
+            bindLevel(GL_TEXTURE1, source.depth, 0);
+            shader->setUniformValue("uSceneColor", 0);
+            shader->setUniformValue("uSceneDepth", 1);
+        }
+        else {
+            bindLevel(GL_TEXTURE0, m_pull.color, level - 2);
+            bindLevel(GL_TEXTURE1, m_pull.depth, level - 2);
+            shader->setUniformValue("uFineColor", 0);
+            shader->setUniformValue("uFineDepth", 1);
+        }
+        drawScreen();
+        shader->release();
+    }
+
+    // push：粗一级为最粗时直接读 pull 的结果，否则读上一次 push 的结果
+    for (int level = levels - 1; level >= 0; --level) {
+        const Pyramid& coarse = level + 1 == levels ? m_pull : m_push;
+        const QSize coarseSize = levelSize(renderSize, level + 1);
+        bindLevel(GL_TEXTURE2, coarse.color, level);
+        bindLevel(GL_TEXTURE3, coarse.depth, level);
+
+        QOpenGLShaderProgram* shader = level == 0 ? pushToScene : push;
+        if (level == 0) {
+            glBindFramebuffer(GL_FRAMEBUFFER, target);
+            glViewport(0, 0, renderSize.width(), renderSize.height());
+            // 覆盖整个渲染区域，深度测试总是通过以写入补好的深度
+            glEnable(GL_DEPTH_TEST);
+            glDepthFunc(GL_ALWAYS);
+        }
+        else {
+            const QSize size = levelSize(renderSize, level);
+            glBindFramebuffer(GL_FRAMEBUFFER, m_push.fbos[level - 1]);
+            glViewport(0, 0, size.width(), size.height());
+        }
+
+        shader->bind();
+        setCommonUniforms(shader, level);
+        glUniform2i(shader->uniformLocation("uCoarseSize"), coarseSize.width(), coarseSize.height());
+        shader->setUniformValue("uCoarseColor", 2);
+        shader->setUniformValue("uCoarseDepth", 3);
+        if (level == 0) {
+            bindLevel(GL_TEXTURE0, source.color, 0);
+            bindLevel(GL_TEXTURE1, source.depth, 0);
+            shader->setUniformValue("uSceneColor", 0);
+            shader->setUniformValue("uSceneDepth", 1);
+        }
+        else {
+            bindLevel(GL_TEXTURE0, m_pull.color, level - 1);
+            bindLevel(GL_TEXTURE1, m_pull.depth, level - 1);
+            shader->setUniformValue("uFineColor", 0);
+            shader->setUniformValue("uFineDepth", 1);
+        }
+        drawScreen();
+        shader->release();
+    }
+
+    glDepthFunc(GL_LESS);
+    for (GLenum unit : { GL_TEXTURE3, GL_TEXTURE2, GL_TEXTURE1, GL_TEXTURE0 }) {
+        glActiveTexture(unit);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+}
+
+// 颜色乘以明暗系数，深度原样写回
+void PointCloudPostProcess::eyeDome(const PointCloudFrameState& state, const SceneTarget& source, GLuint target)
+{
+    // 半分辨率的着色器不可用时按全分辨率计算
+    QOpenGLShaderProgram* shade = state.edl.halfResolution && m_edlShadeFbo ? program(eEdlShade) : nullptr;
+    const bool half = shade != nullptr;
+    QOpenGLShaderProgram* composite = program(half ? eEdlCompositeHalf : eEdlComposite);
+
+    const int width = state.renderSize.width();
+    const int height = state.renderSize.height();
+    // 动态分辨率时邻域半径随渲染分辨率缩小，屏幕上的效果保持不变
+    const float radius = state.edl.radius * width / qMax(1, state.targetSize.width());
+    const QVector2D depthParams(state.projection(2, 2), state.projection(2, 3));
+
+    auto setCommonUniforms = [&](QOpenGLShaderProgram* program) {
+        program->setUniformValue("uDepth", 0);
+        program->setUniformValue("uDepthParams", depthParams);
+        glUniform2i(program->uniformLocation("uDepthSize"), width, height);
+        program->setUniformValue("uRadius", qMax(1.0f, radius));
+        program->setUniformValue("uStrength", state.edl.strength);
+    };
+
+    if (!composite) {
+        // 着色器不可用时直接复制点云结果
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, source.fbo);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, target);
+        glBlitFramebuffer(0, 0, width, height, 0, 0, width, height,
+            GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+        return;
+    }
+
+    bindLevel(GL_TEXTURE0, source.depth, 0);
+
+    if (half) {
+        const QSize halfSize = levelSize(state.renderSize, 1);
+        glBindFramebuffer(GL_FRAMEBUFFER, m_edlShadeFbo);
+        glViewport(0, 0, halfSize.width(), halfSize.height());
+        glDisable(GL_DEPTH_TEST);
+        shade->bind();
+        setCommonUniforms(shade);
+        drawScreen();
+        shade->release();
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, target);
+    glViewport(0, 0, width, height);
+    bindLevel(GL_TEXTURE1, source.color, 0);
+    glActiveTexture(GL_TEXTURE2);
+    glBindTexture(GL_TEXTURE_2D, half ? m_edlShade : 0);
+
+    // 覆盖整个渲染区域，深度测试总是通过以写入点云深度
+    glEnable(GL_DEPTH_TEST);
+    glDepthFunc(GL_ALWAYS);
+    composite->bind();
+    setCommonUniforms(composite);
+    composite->setUniformValue("uColor", 1);
+    if (half) composite->setUniformValue("uShade", 2);
+    drawScreen();
+    composite->release();
+    glDepthFunc(GL_LESS);
+
+    for (GLenum unit : { GL_TEXTURE2, GL_TEXTURE1, GL_TEXTURE0 }) {
+        glActiveTexture(unit);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+}
@@ -0,0 +1,109 @@
+﻿#pragma once
+
+#include <QOpenGLFunctions_3_3_Core>
+#include <QOpenGLShaderProgram>
+#include <QOpenGLVertexArrayObject>
+#include <QSize>
+#include <vector>
+#include <memory>
+
+struct PointCloudFrameState;
+
+// 视觉着色（Eye-Dome Lighting）参数
+// 后处理只读取点云的深度缓冲，开销与窗口像素数成正比，与点数无关
+struct PointCloudEdlSettings
+{
+    bool enabled = false;
+    bool halfResolution = false;  // 明暗系数按半分辨率计算后放大，约为全分辨率开销的四分之一
+    float strength = 1.0f;
+    float radius = 1.4f;          // 邻域半径（全分辨率像素）
+};
+
+// 屏幕空间补洞参数：点稀疏时用相邻像素填满点之间的空隙，较少的点也能画出连续的表面
+struct PointCloudHoleFillSettings
+{
+    bool enabled = false;
+    int levels = 4;               // 金字塔级数，最多补约 2^levels 像素的空洞
+    float depthTolerance = 0.1f;  // 相对深度差在此范围内视为同一表面
+    float minCoverage = 0.5f;     // 周围有点的比例低于此值的空像素视为背景，轮廓不向外扩张
+};
+
+// 点云的屏幕空间后处理：补洞（pull-push）和视觉着色
+// 有后处理时点云先画到带颜色、深度纹理的帧缓冲，处理后合成到目标并写回深度，
+// 之后的坐标轴、包围盒照常按深度绘制
+// 目标按帧缓冲尺寸分配，只处理左下角的渲染区域（动态分辨率）
+// 与渲染器一样属于创建它的上下文
+class PointCloudPostProcess : protected QOpenGLFunctions_3_3_Core
+{
+public:
+    PointCloudPostProcess() = default;
+    ~PointCloudPostProcess();
+
+    PointCloudPostProcess(const PointCloudPostProcess&) = delete;
+    PointCloudPostProcess& operator=(const PointCloudPostProcess&) = delete;
+
+    bool initialize();
+
+    // 本帧是否需要后处理；需要时分配好目标，点云画到 sceneFramebuffer()
+    bool begin(const PointCloudFrameState& state);
+    GLuint sceneFramebuffer() const { return m_scene[0].fbo; }
+
+    // 处理后合成到 target 的渲染区域，结束时 target 为当前帧缓冲
+    void finish(const PointCloudFrameState& state, GLuint target);
+
+private:
+    // 颜色 + 深度纹理
+    struct SceneTarget
+    {
+        GLuint fbo = 0;
+        GLuint color = 0;
+        GLuint depth = 0;
+    };
+
+    // 补洞金字塔：第 i 个 mip 对应图像第 i+1 级（第 0 级就是点云帧缓冲）
+    struct Pyramid
+    {
+        GLuint color = 0;   // rgb + 覆盖率
+        GLuint depth = 0;   // 到相机的距离
+        std::vector<GLuint> fbos;
+    };
+
+    enum Pass
+    {
+        eEdlComposite,       // 逐像素计算明暗并合成
+        eEdlShade,           // 半分辨率明暗系数
+        eEdlCompositeHalf,   // 读取半分辨率明暗系数合成
+        ePullFromScene,
+        ePull,
+        ePush,
+        ePushToScene,
+        ePassCount
+    };
+
+    QOpenGLShaderProgram* program(Pass pass);
+
+    bool ensureTargets(const QSize& size, int sceneTargets, bool edlShade, int pyramidLevels);
+    bool createSceneTarget(SceneTarget& target, const QSize& size);
+    bool createPyramid(Pyramid& pyramid, const QSize& size, int levels);
+    GLuint createTexture(GLint internalFormat, GLenum format, GLenum type, const QSize& size, GLint filter, int levels = 1);
+    void releaseTargets();
+
+    void fillHoles(const PointCloudFrameState& state, const SceneTarget& source, GLuint target);
+    void eyeDome(const PointCloudFrameState& state, const SceneTarget& source, GLuint target);
+    void bindLevel(GLenum unit, GLuint texture, int level);
+    void drawScreen();
+
+    bool m_initialized = false;
+    std::unique_ptr<QOpenGLShaderProgram> m_programs[ePassCount];
+    bool m_programFailed[ePassCount] = {};
+    QOpenGLVertexArrayObject m_screenVao;   // 全屏三角形不需要顶点属性，core profile 仍要求绑定 VAO
+
+    QSize m_size;
+    QSize m_failedSize;          // 在这个尺寸下分配失败过，不每帧重试
+    SceneTarget m_scene[2];      // 两种后处理都开启时，补洞结果写到第二个，再做视觉着色
+    GLuint m_edlShadeFbo = 0;
+    GLuint m_edlShade = 0;
+    Pyramid m_pull;
+    Pyramid m_push;
+    int m_pyramidLevels = 0;
+};
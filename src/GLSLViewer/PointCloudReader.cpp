@@ -0,0 +1,278 @@
+﻿#include "PointCloudReader.h"
+
+#include "PointCloudTokenizer.h"
+#include "DecimalParser.h"
+#include "PointCloudCache.h"
+
+#include <QFile>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QtGlobal>
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    using Field = PointCloudTokenizer::Field;
+
+    // 列格式描述：总列数、强度列、颜色起始列（-1 表示没有）
+    template <int Columns, int IntensityColumn, int ColorColumn>
+    struct Schema
+    {
+        static constexpr int kColumns = Columns;
+        static constexpr int kIntensity = IntensityColumn;
+        static constexpr int kColor = ColorColumn;
+        static constexpr bool kHasIntensity = IntensityColumn >= 0;
+        static constexpr bool kHasColor = ColorColumn >= 0;
+    };
+
+    using SchemaXYZ = Schema<3, -1, -1>;
+    using SchemaXYZI = Schema<4, 3, -1>;
+    using SchemaXYZRGB = Schema<6, -1, 3>;
+    using SchemaXYZIRGB = Schema<7, 3, 4>;
+
+    // 颜色分量 0~255，解析失败按 0 处理（与 QString::toFloat 一致）
+    inline float parseColor(const Field& field)
+    {
+        float v;
+        if (!parseDecimal(field.begin, field.end, v)) return 0.0f;
+        return qBound(0.0f, v / 255.0f, 1.0f);
+    }
+
+    inline bool parseField(const Field& field, float& value)
+    {
+        return parseDecimal(field.begin, field.end, value);
+    }
+
+    inline bool parseField(const Field& field, double& value)
+    {
+        return parseDecimal(field.begin, field.end, value);
+    }
+
+    // 按格式特化的解析循环：坐标解析结果合并成一个标志，最后一次性决定是否提交该点
+    // 列数少于格式要求的行（样本之后格式改变、行尾截断等）按通用规则处理：
+    // 至少 3 列时保留坐标，强度取 0、颜色取白色，结束时输出这类行的数量
+    template <class S>
+    void parseRows(PointCloudTokenizer& tokenizer, PointCloudData& cloud, size_t estimatedPoints)
+    {
+        const PointCloudOrigin origin = cloud.origin;
+        constexpr int kStride = PointCloudData::kFloatsPerPoint;
+
+        size_t capacity = std::max<size_t>(estimatedPoints, 1024);
+        size_t count = 0;
+        size_t shortRows = 0;
+        cloud.points.resize(capacity * kStride);
+        if (S::kHasIntensity) cloud.intensity.resize(capacity);
+
+        Field f[S::kColumns];
+        int n;
+        while ((n = tokenizer.nextLine(f, S::kColumns)) >= 0) {
+            if (n < 3) continue;
+
+            if (count == capacity) {
+                capacity *= 2;
+                cloud.points.resize(capacity * kStride);
+                if (S::kHasIntensity) cloud.intensity.resize(capacity);
+            }
+
+            // 坐标先按双精度解析，减去局部原点后再降为 float
+            double x = 0.0, y = 0.0, z = 0.0;
+            bool ok = parseField(f[0], x) & parseField(f[1], y) & parseField(f[2], z);
+
+            float* p = cloud.points.data() + count * kStride;
+            p[0] = static_cast<float>(x - origin.x);
+            p[1] = static_cast<float>(y - origin.y);
+            p[2] = static_cast<float>(z - origin.z);
+
+            if (n < S::kColumns) {
+                if constexpr (S::kHasIntensity) cloud.intensity[count] = 0.0f;
+                p[3] = p[4] = p[5] = 1.0f;
+                shortRows += ok ? 1 : 0;
+                count += ok ? 1 : 0;
+                continue;
+            }
+
+            if constexpr (S::kHasIntensity) {
+                ok &= parseField(f[S::kIntensity], cloud.intensity[count]);
+            }
+
+            if constexpr (S::kHasColor) {
+                p[3] = parseColor(f[S::kColor]);
+                p[4] = parseColor(f[S::kColor + 1]);
+                p[5] = parseColor(f[S::kColor + 2]);
+            }
+            else {
+                p[3] = p[4] = p[5] = 1.0f;
+            }
+
+            count += ok ? 1 : 0;
+        }
+
+        cloud.points.resize(count * kStride);
+        if (S::kHasIntensity) cloud.intensity.resize(count);
+        cloud.hasColor = S::kHasColor;
+
+        if (shortRows > 0) {
+            qWarning() << shortRows << "rows have fewer than" << S::kColumns
+                       << "columns, kept with default intensity/color";
+        }
+    }
+
+    // 通用路径：逐行判断，至少 3 列，6 列及以上带颜色
+    void parseGeneric(PointCloudTokenizer& tokenizer, PointCloudData& cloud, size_t estimatedPoints)
+    {
+        const PointCloudOrigin origin = cloud.origin;
+        cloud.points.reserve(estimatedPoints * PointCloudData::kFloatsPerPoint);
+
+        Field parts[6];
+        int fieldCount;
+        while ((fieldCount = tokenizer.nextLine(parts, 6)) >= 0) {
+            if (fieldCount < 3) continue;
+
+            double x, y, z;
+            if (!parseField(parts[0], x)) continue;
+            if (!parseField(parts[1], y)) continue;
+            if (!parseField(parts[2], z)) continue;
+
+            float r = 1.0f, g = 1.0f, b = 1.0f;
+            if (fieldCount >= 6) {
+                r = parseColor(parts[3]);
+                g = parseColor(parts[4]);
+                b = parseColor(parts[5]);
+                cloud.hasColor = true;
+            }
+            cloud.points.insert(cloud.points.end(), {
+                static_cast<float>(x - origin.x),
+                static_cast<float>(y - origin.y),
+                static_cast<float>(z - origin.z),
+                r, g, b });
+        }
+    }
+}
+
+const char* PointCloudReader::schemaName(PointSchema schema)
+{
+    switch (schema) {
+    case PointSchema::XYZ: return "XYZ";
+    case PointSchema::XYZI: return "XYZI";
+    case PointSchema::XYZRGB: return "XYZRGB";
+    case PointSchema::XYZIRGB: return "XYZIRGB";
+    default: return "Generic";
+    }
+}
+
+PointSchema PointCloudReader::detectSchema(const char* data, size_t size,
+    double* bytesPerLine, PointCloudOrigin* origin, int sampleLines)
+{
+    PointCloudTokenizer tokenizer(data, size);
+    Field f[8];
+
+    int columns = -1;
+    int lines = 0;
+    bool consistent = true;
+    size_t sampleStart = 0;
+    double sum[3] = { 0.0, 0.0, 0.0 };
+
+    int n;
+    while (lines < sampleLines && (n = tokenizer.nextLine(f, 8)) >= 0) {
+        // 跳过表头等非数字行
+        double x, y, z;
+        if (n < 3 || !parseField(f[0], x) || !parseField(f[1], y) || !parseField(f[2], z)) continue;
+
+        sum[0] += x;
+        sum[1] += y;
+        sum[2] += z;
+
+        if (lines == 0) sampleStart = static_cast<size_t>(f[0].begin - data);
+        if (columns < 0) columns = n;
+        else if (columns != n) consistent = false;
+        ++lines;
+    }
+
+    if (bytesPerLine && lines > 0) {
+        const size_t sampled = tokenizer.position() > sampleStart ? tokenizer.position() - sampleStart : 0;
+        *bytesPerLine = sampled > 0 ? static_cast<double>(sampled) / lines : 40.0;
+    }
+
+    // 原点取样本中心并取整，便于导出和显示
+    if (origin) {
+        *origin = PointCloudOrigin();
+        if (lines > 0) {
+            origin->x = std::round(sum[0] / lines);
+            origin->y = std::round(sum[1] / lines);
+            origin->z = std::round(sum[2] / lines);
+        }
+    }
+
+    if (!consistent) return PointSchema::Generic;
+
+    switch (columns) {
+    case 3: return PointSchema::XYZ;
+    case 4: return PointSchema::XYZI;
+    case 6: return PointSchema::XYZRGB;
+    case 7: return PointSchema::XYZIRGB;
+    default: return PointSchema::Generic;
+    }
+}
+
+void PointCloudReader::read(const char* data, size_t size, PointSchema schema,
+    const PointCloudOrigin& origin, PointCloudData& cloud, double bytesPerLine)
+{
+    cloud = PointCloudData();
+    cloud.schema = schema;
+    cloud.origin = origin;
+
+    const size_t estimatedPoints = static_cast<size_t>(size / std::max(bytesPerLine, 8.0) * 1.05) + 1;
+
+    PointCloudTokenizer tokenizer(data, size);
+    switch (schema) {
+    case PointSchema::XYZ: parseRows<SchemaXYZ>(tokenizer, cloud, estimatedPoints); break;
+    case PointSchema::XYZI: parseRows<SchemaXYZI>(tokenizer, cloud, estimatedPoints); break;
+    case PointSchema::XYZRGB: parseRows<SchemaXYZRGB>(tokenizer, cloud, estimatedPoints); break;
+    case PointSchema::XYZIRGB: parseRows<SchemaXYZIRGB>(tokenizer, cloud, estimatedPoints); break;
+    default: parseGeneric(tokenizer, cloud, estimatedPoints); break;
+    }
+}
+
+bool PointCloudReader::readFile(const QString& filename, PointCloudData& cloud)
+{
+    // 导出的二进制缓存直接整块读入
+    if (PointCloudCache::isCacheFile(filename)) {
+        return PointCloudCache::read(filename, cloud);
+    }
+
+    QFile file(filename);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "Cannot open file:" << filename;
+        return false;
+    }
+
+    // 优先内存映射整个文件，失败时退回一次性读取
+    QByteArray fileData;
+    const char* data = nullptr;
+    size_t dataSize = static_cast<size_t>(file.size());
+    if (dataSize > 0) {
+        data = reinterpret_cast<const char*>(file.map(0, file.size()));
+    }
+    if (!data) {
+        fileData = file.readAll();
+        data = fileData.constData();
+        dataSize = static_cast<size_t>(fileData.size());
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    double bytesPerLine = 40.0;
+    PointCloudOrigin origin;
+    const PointSchema schema = detectSchema(data, dataSize, &bytesPerLine, &origin);
+    read(data, dataSize, schema, origin, cloud, bytesPerLine);
+
+    const double seconds = qMax(timer.nsecsElapsed() * 1e-9, 1e-9);
+    qDebug() << "Parsed" << cloud.pointCount() << "points from" << filename
+             << "schema:" << schemaName(schema)
+             << "simd:" << PointCloudTokenizer::simdLevel()
+             << "MB/s:" << dataSize / seconds / 1e6;
+    return true;
+}
@@ -0,0 +1,29 @@
+﻿#pragma once
+
+#include "glslviewer_global.h"
+#include "PointCloudData.h"
+
+#include <QString>
+
+// 文本点云读取
+// 先用前几行确定列格式，再分派到按格式在编译期实例化的解析函数，
+// 内层循环不再对列类型做运行时判断；样本中列数不一致的文件走通用路径，
+// 样本之后出现的短行只保留坐标，不会被丢弃。
+class GLSLVIEWER_EXPORT PointCloudReader
+{
+public:
+    // 读取文件，自动识别列格式
+    static bool readFile(const QString& filename, PointCloudData& cloud);
+
+    // 按指定格式解析内存中的文本，schema 为 Generic 时使用通用路径
+    // 坐标按双精度解析后减去 origin 再存为 float；bytesPerLine 只用于预估点数
+    static void read(const char* data, size_t size, PointSchema schema,
+        const PointCloudOrigin& origin, PointCloudData& cloud, double bytesPerLine = 40.0);
+
+    // 根据前 sampleLines 个数据行识别列格式
+    // bytesPerLine 返回平均行长（用于预分配），origin 返回样本中心取整后的局部原点
+    static PointSchema detectSchema(const char* data, size_t size,
+        double* bytesPerLine = nullptr, PointCloudOrigin* origin = nullptr, int sampleLines = 32);
+
+    static const char* schemaName(PointSchema schema);
+};
@@ -0,0 +1,66 @@
+﻿#include "PointCloudRegistry.h"
+
+#include <QFileInfo>
+#include <QDateTime>
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QDebug>
+
+namespace
+{
+    struct Registry
+    {
+        QMutex mutex;
+        QHash<QString, std::weak_ptr<PointCloudDataset>> datasets;
+    };
+
+    Registry& registry()
+    {
+        static Registry r;
+        return r;
+    }
+}
+
+QString PointCloudRegistry::fileKey(const QString& filename)
+{
+    // 文件被覆盖后大小或修改时间变化，按新文件重新加载
+    const QFileInfo info(filename);
+    const QString path = info.canonicalFilePath().isEmpty() ? info.absoluteFilePath() : info.canonicalFilePath();
+    return QStringLiteral("%1|%2|%3")
+        .arg(path)
+        .arg(info.size())
+        .arg(info.lastModified().toMSecsSinceEpoch());
+}
+
+std::shared_ptr<PointCloudDataset> PointCloudRegistry::acquire(const QString& filename)
+{
+    const QString key = fileKey(filename);
+    Registry& r = registry();
+
+    {
+        QMutexLocker locker(&r.mutex);
+        if (std::shared_ptr<PointCloudDataset> dataset = r.datasets.value(key).lock()) {
+            qDebug() << "Reusing loaded dataset:" << filename;
+            return dataset;
+        }
+    }
+
+    // 读取不持锁，其它文件的请求不受影响
+    auto dataset = std::make_shared<PointCloudDataset>(filename);
+    if (!dataset->load()) return nullptr;
+
+    QMutexLocker locker(&r.mutex);
+    // 清理已经释放的条目
+    for (auto it = r.datasets.begin(); it != r.datasets.end();) {
+        if (it.value().expired()) it = r.datasets.erase(it);
+        else ++it;
+    }
+
+    // 读取期间别处已加载了同一文件时，使用先到的那份
+    if (std::shared_ptr<PointCloudDataset> existing = r.datasets.value(key).lock()) {
+        return existing;
+    }
+    r.datasets.insert(key, dataset);
+    return dataset;
+}
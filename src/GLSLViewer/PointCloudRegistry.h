@@ -0,0 +1,18 @@
+﻿#pragma once
+
+#include "glslviewer_global.h"
+#include "PointCloudDataset.h"
+
+#include <QString>
+#include <memory>
+
+// 进程内的数据集表，按文件标识（规范路径 + 大小 + 修改时间）查找
+// 表中只保存弱引用，数据集的生命周期由持有它的窗口决定，最后一个窗口关闭时释放 CPU 和 GPU 内存
+class GLSLVIEWER_EXPORT PointCloudRegistry
+{
+public:
+    // 已加载则直接返回共享实例，否则读取文件；失败返回空
+    static std::shared_ptr<PointCloudDataset> acquire(const QString& filename);
+
+    static QString fileKey(const QString& filename);
+};
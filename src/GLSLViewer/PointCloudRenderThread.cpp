@@ -0,0 +1,198 @@
+﻿#include "PointCloudRenderThread.h"
+
+#include <QCoreApplication>
+#include <QMutexLocker>
+#include <QDebug>
+
+PointCloudRenderThread::PointCloudRenderThread(QObject* parent)
+    : QThread(parent)
+{
+}
+
+PointCloudRenderThread::~PointCloudRenderThread()
+{
+    stopRendering();
+}
+
+bool PointCloudRenderThread::startRendering(QOpenGLContext* shareContext)
+{
+    if (!shareContext || isRunning()) return false;
+
+    // 上下文和离屏表面都要在 GUI 线程创建，上下文再移交给渲染线程
+    m_context = std::make_unique<QOpenGLContext>();
+    m_context->setFormat(shareContext->format());
+    m_context->setShareContext(shareContext);
+    if (!m_context->create()) {
+        qWarning() << "Failed to create render thread context";
+        m_context.reset();
+        return false;
+    }
+
+    m_surface = std::make_unique<QOffscreenSurface>();
+    m_surface->setFormat(m_context->format());
+    m_surface->create();
+
+    m_context->moveToThread(this);
+    m_stop = false;
+    start();
+
+    m_ready.acquire();
+    if (!m_initialized) {
+        wait();
+        m_context.reset();
+        m_surface.reset();
+        return false;
+    }
+    return true;
+}
+
+void PointCloudRenderThread::stopRendering()
+{
+    if (!isRunning()) return;
+
+    m_stop = true;
+    m_wake.release();
+    wait();
+
+    // 两端都已停止，释放快照中的数据集引用
+    for (int i = 0; i < 3; ++i) m_states.slot(i) = PointCloudFrameState();
+    m_context.reset();
+    m_surface.reset();
+}
+
+void PointCloudRenderThread::post(const PointCloudFrameState& state)
+{
+    m_states.back() = state;
+    m_states.publish();
+    m_wake.release();
+}
+
+void PointCloudRenderThread::setPaused(bool paused)
+{
+    if (m_paused.exchange(paused) == paused) return;
+    // 恢复时唤醒一次，继续未完成的上传
+    if (!paused) m_wake.release();
+}
+
+PointCloudRenderThread::Frame* PointCloudRenderThread::latestFrame()
+{
+    if (m_frames.update()) m_hasFrame = true;
+    return m_hasFrame ? &m_frames.front() : nullptr;
+}
+
+void PointCloudRenderThread::run()
+{
+    m_initialized = m_context->makeCurrent(m_surface.get());
+    if (m_initialized) {
+        initializeOpenGLFunctions();
+        m_renderer = std::make_unique<PointCloudRenderer>();
+        m_initialized = m_renderer->initialize();
+    }
+    if (!m_initialized) {
+        qWarning() << "Render thread initialization failed";
+        releaseResources();
+        m_ready.release();
+        return;
+    }
+    m_ready.release();
+
+    while (true) {
+        // 还有数据在分片上传时不等待新状态，继续用当前状态渲染
+        // 有拾取读回在途时只短暂等待，醒来后查询结果
+        const bool paused = m_paused;
+        const bool uploading = m_renderer->uploadPending() && !paused;
+        if (!uploading) {
+            if (m_renderer->pickPending() && !paused) m_wake.tryAcquire(1, kPickPollMs);
+            else m_wake.acquire();
+        }
+        // 积压的唤醒合并成一次，只渲染最新的状态
+        m_wake.tryAcquire(m_wake.available());
+        if (m_stop) break;
+        if (!m_states.update() && !uploading) {
+            publishPickResults();
+            continue;
+        }
+
+        const PointCloudFrameState& state = m_states.front();
+        if (state.targetSize.isEmpty() || state.renderSize.isEmpty()) continue;
+
+        const int index = m_frames.backIndex();
+        Frame& frame = m_frames.back();
+        std::unique_ptr<QOpenGLFramebufferObject>& target = m_targets[index];
+
+        // 窗口上一次读取这块纹理的命令完成后才能覆盖（GPU 端等待，不阻塞本线程）
+        if (frame.readDone) {
+            glWaitSync(frame.readDone, 0, GL_TIMEOUT_IGNORED);
+            glDeleteSync(frame.readDone);
+            frame.readDone = nullptr;
+        }
+        // 上次渲染的结果没有被呈现过
+        if (frame.renderDone) {
+            glDeleteSync(frame.renderDone);
+            frame.renderDone = nullptr;
+        }
+
+        if (!target || target->size() != state.targetSize) {
+            target.reset();
+            target = std::make_unique<QOpenGLFramebufferObject>(state.targetSize,
+                QOpenGLFramebufferObject::CombinedDepthStencil);
+        }
+
+        m_renderer->render(state, target.get());
+
+        frame.texture = target->texture();
+        frame.size = state.targetSize;
+        frame.renderSize = state.renderSize;
+        frame.renderDone = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        // 其它上下文等待的同步对象必须先提交
+        glFlush();
+        m_frames.publish();
+
+        const double frameMs = m_renderer->takeFrameTime();
+        if (frameMs >= 0.0) m_frameTime = frameMs;
+
+        emit frameReady();
+        publishPickResults();
+    }
+
+    releaseResources();
+}
+
+void PointCloudRenderThread::publishPickResults()
+{
+    std::vector<PointCloudPickResult> results = m_renderer->takePickResults();
+    if (results.empty()) return;
+
+    {
+        QMutexLocker locker(&m_pickMutex);
+        m_pickResults.insert(m_pickResults.end(), results.begin(), results.end());
+    }
+    emit pickReady();
+}
+
+std::vector<PointCloudPickResult> PointCloudRenderThread::takePickResults()
+{
+    QMutexLocker locker(&m_pickMutex);
+    std::vector<PointCloudPickResult> results;
+    results.swap(m_pickResults);
+    return results;
+}
+
+// 在渲染线程中调用，GL 对象在创建它们的上下文中释放
+void PointCloudRenderThread::releaseResources()
+{
+    if (QOpenGLContext::currentContext() == m_context.get()) {
+        m_renderer.reset();
+        for (int i = 0; i < 3; ++i) {
+            m_targets[i].reset();
+            Frame& frame = m_frames.slot(i);
+            if (frame.renderDone) glDeleteSync(frame.renderDone);
+            if (frame.readDone) glDeleteSync(frame.readDone);
+            frame = Frame();
+        }
+        m_context->doneCurrent();
+    }
+
+    // 交还 GUI 线程，由 stopRendering 销毁
+    m_context->moveToThread(QCoreApplication::instance()->thread());
+}
@@ -0,0 +1,91 @@
+﻿#pragma once
+
+#include "PointCloudRenderer.h"
+#include "TripleBuffer.h"
+
+#include <QThread>
+#include <QSemaphore>
+#include <QMutex>
+#include <QOpenGLContext>
+#include <QOffscreenSurface>
+#include <QOpenGLFunctions_3_3_Core>
+#include <atomic>
+#include <memory>
+
+// 每个窗口一个渲染线程，拥有与窗口上下文共享的离屏上下文
+// 窗口在 GUI 线程发布帧状态快照，线程渲染到自己的 FBO 后通过三缓冲交回纹理；
+// 线程与窗口之间用同步对象（glFenceSync）保证纹理写完再读、读完再写，双方都不用 glFinish
+class PointCloudRenderThread : public QThread, protected QOpenGLFunctions_3_3_Core
+{
+    Q_OBJECT
+
+public:
+    // 渲染完成的一帧
+    struct Frame
+    {
+        GLuint texture = 0;          // 颜色附件，属于共享组
+        QSize size;                  // 纹理尺寸
+        QSize renderSize;            // 有效区域（左下角）
+        GLsync renderDone = nullptr; // 渲染线程写完，窗口呈现前等待
+        GLsync readDone = nullptr;   // 窗口读完，渲染线程覆盖前等待
+    };
+
+    explicit PointCloudRenderThread(QObject* parent = nullptr);
+    ~PointCloudRenderThread() override;
+
+    // 在 GUI 线程调用，创建与 shareContext 共享的上下文并启动线程，等待着色器等初始化完成
+    // 失败时返回 false，窗口改为在自己的上下文中同步渲染
+    bool startRendering(QOpenGLContext* shareContext);
+    // 停止线程并释放线程中的 GL 资源，阻塞到线程退出
+    void stopRendering();
+
+    // 发布新的帧状态，只保留最新一份
+    void post(const PointCloudFrameState& state);
+
+    // 窗口隐藏时暂停：线程和上下文保留，只等待新状态，不再为分片上传或拾取读回继续渲染
+    void setPaused(bool paused);
+
+    // 切换到最新完成的一帧；还没有任何帧时返回 nullptr
+    // 返回的帧属于调用方，直到下一次调用
+    Frame* latestFrame();
+
+    // 最近一帧换算到全分辨率的 GPU 耗时（毫秒），没有新结果时返回负数
+    double takeFrameTime() { return m_frameTime.exchange(-1.0); }
+
+    // 已完成的拾取结果，在 GUI 线程调用
+    std::vector<PointCloudPickResult> takePickResults();
+
+signals:
+    // 在渲染线程中发出，连接到窗口时为排队连接
+    void frameReady();
+    void pickReady();
+
+protected:
+    void run() override;
+
+private:
+    void releaseResources();
+    void publishPickResults();
+
+    // 等待拾取读回时查询同步对象的间隔
+    static constexpr int kPickPollMs = 1;
+
+    std::unique_ptr<QOpenGLContext> m_context;
+    std::unique_ptr<QOffscreenSurface> m_surface;
+
+    TripleBuffer<PointCloudFrameState> m_states;   // GUI 线程 -> 渲染线程
+    TripleBuffer<Frame> m_frames;                  // 渲染线程 -> GUI 线程
+    std::unique_ptr<QOpenGLFramebufferObject> m_targets[3]; // 与 m_frames 的槽位一一对应，只在渲染线程中使用
+    std::unique_ptr<PointCloudRenderer> m_renderer;
+
+    QSemaphore m_wake;
+    QSemaphore m_ready;
+    bool m_initialized = false;
+    bool m_hasFrame = false;
+    std::atomic<bool> m_stop{ false };
+    std::atomic<bool> m_paused{ false };
+    std::atomic<double> m_frameTime{ -1.0 };
+
+    QMutex m_pickMutex;
+    std::vector<PointCloudPickResult> m_pickResults;
+};
@@ -0,0 +1,969 @@
+﻿#include "PointCloudRenderer.h"
+#include "PointCloudShaderLibrary.h"
+
+#include <QMutexLocker>
+#include <QQuaternion>
+#include <QVector2D>
+#include <QVector4D>
+#include <QDebug>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+PointCloudRenderer::PointCloudRenderer()
+    : m_axisVbo(QOpenGLBuffer::VertexBuffer)
+    , m_boxVbo(QOpenGLBuffer::VertexBuffer)
+{
+}
+
+PointCloudRenderer::~PointCloudRenderer()
+{
+    // 调用方保证创建时的上下文为当前
+    m_vao.destroy();
+    m_axisVao.destroy();
+    m_axisVbo.destroy();
+    m_boxVao.destroy();
+    m_boxVbo.destroy();
+    if (m_frameQuery) glDeleteQueries(1, &m_frameQuery);
+    if (m_colormapTexture) glDeleteTextures(1, &m_colormapTexture);
+    if (m_spacingTexture) glDeleteTextures(1, &m_spacingTexture);
+    if (m_flagBuffer) glDeleteBuffers(1, &m_flagBuffer);
+    for (PickRead& read : m_pickReads) {
+        if (read.fence) glDeleteSync(read.fence);
+        if (read.pbo) glDeleteBuffers(1, &read.pbo);
+    }
+    if (m_pickFbo) glDeleteFramebuffers(1, &m_pickFbo);
+    if (m_pickIds) glDeleteTextures(1, &m_pickIds);
+    if (m_pickDepth) glDeleteRenderbuffers(1, &m_pickDepth);
+}
+
+bool PointCloudRenderer::initialize()
+{
+    if (m_initialized) return true;
+    if (!initializeOpenGLFunctions()) {
+        qCritical() << "OpenGL 3.3 core functions are not available";
+        return false;
+    }
+
+    // 场景渲染计时，用于动态分辨率
+    glGenQueries(1, &m_frameQuery);
+
+    m_uploader.initialize();
+
+    //点云着色器
+    initPointCloud();
+
+    // 初始化坐标轴
+    initScreenAxisOrtho();
+
+    initBoundingBoxGeometry();
+
+    m_postProcess.initialize();
+
+    m_initialized = pointProgram(0, false, false) != nullptr;
+    return m_initialized;
+}
+
+void PointCloudRenderer::render(const PointCloudFrameState& state, QOpenGLFramebufferObject* fbo)
+{
+    m_uploadPending = false;
+    if (!m_initialized || !fbo) return;
+
+    // 有后处理时点云先画到后处理的帧缓冲，目标创建失败则不做后处理
+    const bool postProcess = m_postProcess.begin(state);
+    if (postProcess) glBindFramebuffer(GL_FRAMEBUFFER, m_postProcess.sceneFramebuffer());
+    else fbo->bind();
+    glViewport(0, 0, state.renderSize.width(), state.renderSize.height());
+
+    // 坐标轴会关闭深度测试，每帧开始时恢复
+    glEnable(GL_DEPTH_TEST);
+    glEnable(GL_PROGRAM_POINT_SIZE);
+
+    // 同一时间只有一个计时查询在途，结果在之后的帧中读取，不阻塞
+    const bool measure = m_frameQuery != 0 && !m_frameQueryPending;
+    if (measure) glBeginQuery(GL_TIME_ELAPSED, m_frameQuery);
+
+    glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    renderPointCloud(state);
+
+    if (postProcess) m_postProcess.finish(state, fbo->handle());
+
+    // 2. 渲染坐标轴（半透明，无深度写入）
+    glDepthMask(GL_FALSE);
+    renderScreenAxisOrtho(state);
+    glDepthMask(GL_TRUE);
+
+    // 3. 渲染边界盒（最后渲染，确保在最前面）
+    renderBoundingBox(state);
+
+    // 新的拾取请求在同一帧中处理，相机与画面一致
+    if (state.pick.serial != 0 && state.pick.serial != m_lastPickSerial) renderPickIds(state);
+    if (state.depthPick.serial != 0 && state.depthPick.serial != m_lastDepthPickSerial) readPickDepth(state, fbo->handle());
+
+    if (measure) {
+        glEndQuery(GL_TIME_ELAPSED);
+        m_frameQueryPending = true;
+        const double renderPixels = static_cast<double>(state.renderSize.width()) * state.renderSize.height();
+        const double targetPixels = static_cast<double>(state.targetSize.width()) * state.targetSize.height();
+        m_frameQueryPixelRatio = renderPixels > 0.0 ? targetPixels / renderPixels : 1.0;
+    }
+
+    fbo->release();
+}
+
+// 填充开销与像素数成正比，按像素数之比换算到全分辨率
+double PointCloudRenderer::takeFrameTime()
+{
+    if (!m_frameQueryPending) return -1.0;
+
+    GLint available = 0;
+    glGetQueryObjectiv(m_frameQuery, GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available) return -1.0;
+
+    GLuint64 elapsed = 0;
+    glGetQueryObjectui64v(m_frameQuery, GL_QUERY_RESULT, &elapsed);
+    m_frameQueryPending = false;
+
+    return elapsed * 1e-6 * m_frameQueryPixelRatio;
+}
+
+void PointCloudRenderer::initPointCloud()
+{
+    // Create VAO，VBO 属于数据集；着色器按渲染模式在第一次使用时创建
+    m_vao.create();
+
+    glGenTextures(1, &m_colormapTexture);
+    glBindTexture(GL_TEXTURE_1D, m_colormapTexture);
+    glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexImage1D(GL_TEXTURE_1D, 0, GL_RGBA8, PointCloudColormap::kTableSize, 0, GL_BGRA, GL_UNSIGNED_BYTE, nullptr);
+    glBindTexture(GL_TEXTURE_1D, 0);
+    updateColormapTexture(PointCloudColormap::preset(PointCloudColormap::eElevation));
+
+    glGenTextures(1, &m_spacingTexture);
+    glBindTexture(GL_TEXTURE_3D, m_spacingTexture);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_3D, 0);
+
+    // 没有标志缓冲时属性 2 不启用，着色器读到的是这里的常量 0
+    glVertexAttribI4ui(2, 0, 0, 0, 0);
+}
+
+// 点间距与数据集一起保留，只在切换数据集或数据集压缩后上传（最多 kMaxCells 个 float）
+// 按 weak_ptr 记录来源：不延长数据集的生命周期，数据集释放后同一地址上的新数据集也不会误用旧纹理
+void PointCloudRenderer::updateSpacingTexture(const std::shared_ptr<const PointCloudDataset>& dataset)
+{
+    if (!dataset) return;
+    if (dataset == m_spacingSource.lock() && dataset->spacingGeneration() == m_spacingGeneration) return;
+
+    const PointCloudSpacing& spacing = dataset->spacing();
+    if (!spacing.valid()) return;
+
+    glBindTexture(GL_TEXTURE_3D, m_spacingTexture);
+    glTexImage3D(GL_TEXTURE_3D, 0, GL_R32F, spacing.dims[0], spacing.dims[1], spacing.dims[2], 0,
+        GL_RED, GL_FLOAT, spacing.spacing.data());
+    glBindTexture(GL_TEXTURE_3D, 0);
+    m_spacingSource = dataset;
+    m_spacingGeneration = dataset->spacingGeneration();
+}
+
+// 查找表为 QRgb（0xAARRGGBB），以 GL_UNSIGNED_INT_8_8_8_8_REV 按 32 位整数读取，与字节序无关
+void PointCloudRenderer::updateColormapTexture(const std::shared_ptr<const PointCloudColormap>& colormap)
+{
+    if (!colormap || colormap == m_colormap) return;
+
+    glBindTexture(GL_TEXTURE_1D, m_colormapTexture);
+    glTexSubImage1D(GL_TEXTURE_1D, 0, 0, PointCloudColormap::kTableSize, GL_BGRA, GL_UNSIGNED_INT_8_8_8_8_REV,
+        colormap->table().data());
+    glBindTexture(GL_TEXTURE_1D, 0);
+    m_colormap = colormap;
+}
+
+// 渲染模式对应的着色器变体，切换模式只是换程序，不在顶点着色器中分支
+// 创建失败时记录空指针，不反复编译
+// 拾取变体输出点序号，与渲染模式无关；没有裁剪体时用不含裁剪判断的变体
+QOpenGLShaderProgram* PointCloudRenderer::pointProgram(int renderMode, bool adaptiveSize, bool clipping, bool pickId)
+{
+    const int key = (pickId ? 0x200 : renderMode) | (adaptiveSize ? 0x100 : 0) | (clipping ? 0x400 : 0);
+    auto it = m_programs.find(key);
+    if (it != m_programs.end()) return it->second.get();
+
+    QByteArrayList defines;
+    if (pickId) defines << QByteArrayLiteral("PICK_ID");
+    else defines << (renderMode == 1 ? QByteArrayLiteral("COLOR_RGB") : QByteArrayLiteral("COLOR_ELEVATION"));
+    if (adaptiveSize) defines << QByteArrayLiteral("ADAPTIVE_SIZE");
+    if (clipping) defines << QByteArrayLiteral("CLIPPING");
+    std::unique_ptr<QOpenGLShaderProgram>& program = m_programs[key];
+    program = PointCloudShaderLibrary::create(PointCloudShaderLibrary::ePointCloud, defines);
+    return program.get();
+}
+
+// VAO 记录的是绑定时的 VBO，切换数据集或数据集重新上传后需要重新设置
+// 调用方持有数据集的 GPU 锁
+void PointCloudRenderer::setupVertexArray()
+{
+    if (!m_dataset || !m_vao.isCreated()) return;
+
+    m_vao.bind();
+    if (m_dataset->bindVertexBuffer()) {
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
+        glEnableVertexAttribArray(1);
+        m_dataset->releaseVertexBuffer();
+        if (m_flagBuffer) {
+            glBindBuffer(GL_ARRAY_BUFFER, m_flagBuffer);
+            glVertexAttribIPointer(2, 1, GL_UNSIGNED_BYTE, 0, nullptr);
+            glEnableVertexAttribArray(2);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+        }
+        else {
+            glDisableVertexAttribArray(2);
+        }
+        m_vaoGeneration = m_dataset->gpuGeneration();
+    }
+    m_vao.release();
+}
+
+void PointCloudRenderer::renderPointCloud(const PointCloudFrameState& state)
+{
+    const std::shared_ptr<PointCloudDataset>& dataset = state.dataset;
+    if (!dataset || dataset->pointCount() == 0) return;
+
+    // 绘制期间 GUI 线程不能释放缓冲（内存预算）
+    QMutexLocker locker(dataset->gpuMutex());
+
+    // 切换了数据集，或 GPU 缓冲被内存预算释放过、数据集压缩过，已重新上传，重建 VAO
+    if (dataset != m_dataset || !dataset->hasGpuData() || m_vaoGeneration != dataset->gpuGeneration()) {
+        if (dataset != m_dataset || m_flagPointCount != dataset->pointCount()) releaseFlagBuffer();
+        m_dataset = dataset;
+        setupVertexArray();
+        if (!dataset->hasGpuData()) return;
+    }
+    updateFlagBuffer(state);
+
+    // 每帧上传一部分，先画出已上传的点
+    m_uploader.deleteReleasedFences();
+    if (!dataset->streamVertexBuffer(m_uploader, kUploadBudgetMs)) m_uploadPending = true;
+    dataset->syncVertexBuffer(m_uploader);
+    const size_t drawCount = dataset->uploadedPointCount();
+    if (drawCount == 0) return;
+
+    // 数据集没有间距估计时使用固定大小
+    const bool adaptive = state.pointSize.adaptive && dataset->spacing().valid();
+    const bool clipping = state.clipping && !state.clipping->empty();
+    QOpenGLShaderProgram* program = pointProgram(state.renderMode, adaptive, clipping);
+    if (!program) return;
+
+    program->bind();
+    program->setUniformValue("uProjection", state.projection);
+    program->setUniformValue("uView", state.view);
+    program->setUniformValue("uMinZ", state.displayMinZ);
+    program->setUniformValue("uMaxZ", state.displayMaxZ);
+    if (state.renderMode == 0) {
+        updateColormapTexture(state.colormap);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_1D, m_colormapTexture);
+        program->setUniformValue("uColormap", 0);
+    }
+    if (adaptive) updateSpacingTexture(dataset);
+    setPointSizeUniforms(program, state, adaptive);
+    if (clipping) setClipUniforms(program, state);
+
+    m_vao.bind();
+    drawPoints(state, drawCount);
+
+    m_vao.release();
+    program->release();
+    if (adaptive) {
+        glBindTexture(GL_TEXTURE_3D, 0);
+        glActiveTexture(GL_TEXTURE0);
+    }
+    glBindTexture(GL_TEXTURE_1D, 0);
+}
+
+// 裁剪体在顶点着色器中逐点判断，个数超出着色器数组大小的部分忽略
+// 只对 CLIPPING 变体调用，调用方保证裁剪体非空；每次都设置个数，不残留上一帧的裁剪体
+void PointCloudRenderer::setClipUniforms(QOpenGLShaderProgram* program, const PointCloudFrameState& state)
+{
+    const PointCloudClipping* clipping = state.clipping.get();
+    const int boxCount = std::min(static_cast<int>(clipping->boxes.size()), PointCloudClipping::kMaxBoxes);
+    const int planeCount = std::min(static_cast<int>(clipping->planes.size()), PointCloudClipping::kMaxPlanes);
+    program->setUniformValue("uClipBoxCount", boxCount);
+    program->setUniformValue("uClipPlaneCount", planeCount);
+    program->setUniformValue("uClipInvert", clipping->inverted ? 1 : 0);
+
+    if (boxCount > 0) {
+        QVector3D boxMin[PointCloudClipping::kMaxBoxes];
+        QVector3D boxMax[PointCloudClipping::kMaxBoxes];
+        GLint keepInside[PointCloudClipping::kMaxBoxes];
+        for (int i = 0; i < boxCount; ++i) {
+            boxMin[i] = clipping->boxes[i].min;
+            boxMax[i] = clipping->boxes[i].max;
+            keepInside[i] = clipping->boxes[i].keepInside ? 1 : 0;
+        }
+        program->setUniformValueArray("uClipBoxMin", boxMin, boxCount);
+        program->setUniformValueArray("uClipBoxMax", boxMax, boxCount);
+        program->setUniformValueArray("uClipBoxKeepInside", keepInside, boxCount);
+    }
+    if (planeCount > 0) {
+        QVector4D planes[PointCloudClipping::kMaxPlanes];
+        for (int i = 0; i < planeCount; ++i) planes[i] = QVector4D(clipping->planes[i].normal, clipping->planes[i].offset);
+        program->setUniformValueArray("uClipPlanes", planes, planeCount);
+    }
+}
+
+// 有裁剪时按块包围盒跳过整块被裁掉的点，有删除时跳过整块已删除的点（删除标记的块更大，整块删除时其中的小块都跳过），
+// 相邻的可见块合并为一段，一次 glMultiDrawArrays 画完；gl_VertexID 仍是点的序号，拾取和逐点标志不受影响
+void PointCloudRenderer::drawPoints(const PointCloudFrameState& state, size_t drawCount)
+{
+    const size_t pointCount = state.dataset->pointCount();
+    const std::vector<PointCloudBox>& bounds = state.dataset->chunkBounds();
+    const PointCloudClipping* clipping = state.clipping && !state.clipping->empty() && !bounds.empty()
+        ? state.clipping.get() : nullptr;
+    const PointCloudSelection* deleted = state.deleted && state.deleted->pointCount() == pointCount && !state.deleted->empty()
+        ? state.deleted.get() : nullptr;
+    if (!clipping && !deleted) {
+        glDrawArrays(GL_POINTS, 0, static_cast<GLsizei>(drawCount));
+        return;
+    }
+
+    m_drawFirsts.clear();
+    m_drawCounts.clear();
+    const size_t chunkPoints = PointCloudClipping::kChunkPoints;
+    const size_t chunkCount = (drawCount + chunkPoints - 1) / chunkPoints;
+    for (size_t c = 0; c < chunkCount; ++c) {
+        if (clipping && c < bounds.size() && clipping->classify(bounds[c]) == PointCloudClipping::eNone) continue;
+        if (deleted) {
+            const size_t d = c * chunkPoints / PointCloudSelection::kChunkPoints;
+            const size_t size = std::min(PointCloudSelection::kChunkPoints, pointCount - d * PointCloudSelection::kChunkPoints);
+            if (deleted->chunkSelectedCount(d) == size) continue;
+        }
+
+        const GLint first = static_cast<GLint>(c * chunkPoints);
+        const GLsizei count = static_cast<GLsizei>(std::min(drawCount, (c + 1) * chunkPoints) - c * chunkPoints);
+        if (!m_drawFirsts.empty() && m_drawFirsts.back() + m_drawCounts.back() == first) m_drawCounts.back() += count;
+        else {
+            m_drawFirsts.push_back(first);
+            m_drawCounts.push_back(count);
+        }
+    }
+    if (!m_drawFirsts.empty()) {
+        glMultiDrawArrays(GL_POINTS, m_drawFirsts.data(), m_drawCounts.data(), static_cast<GLsizei>(m_drawFirsts.size()));
+    }
+}
+
+// 选择集或删除标记变化时只上传块指针变化的区间，相邻的块合并为一次 glBufferSubData
+// 第一次有选中或删除的点时才创建缓冲，之前的帧不占显存也不启用属性
+void PointCloudRenderer::updateFlagBuffer(const PointCloudFrameState& state)
+{
+    const size_t pointCount = m_dataset->pointCount();
+    const PointCloudSelection* selection = state.selection && state.selection->pointCount() == pointCount
+        ? state.selection.get() : nullptr;
+    const PointCloudSelection* deleted = state.deleted && state.deleted->pointCount() == pointCount
+        ? state.deleted.get() : nullptr;
+
+    if (!m_flagBuffer) {
+        if ((!selection || selection->empty()) && (!deleted || deleted->empty())) return;
+
+        glGenBuffers(1, &m_flagBuffer);
+        glBindBuffer(GL_ARRAY_BUFFER, m_flagBuffer);
+        glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(pointCount), nullptr, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        const size_t chunkCount = (pointCount + PointCloudSelection::kChunkPoints - 1) / PointCloudSelection::kChunkPoints;
+        m_flagPointCount = pointCount;
+        m_flagSelected.assign(chunkCount, nullptr);
+        m_flagDeleted.assign(chunkCount, nullptr);
+        m_flagChunkValid.assign(chunkCount, false);
+        setupVertexArray();
+    }
+
+    // 选择集、删除标记为空或已清除时，之前上传过的块写回 0
+    static const std::shared_ptr<const PointCloudSelection::Chunk> kNoChunk;
+    auto selectedAt = [&](size_t index) -> const std::shared_ptr<const PointCloudSelection::Chunk>& {
+        return selection ? selection->chunk(index) : kNoChunk;
+    };
+    auto deletedAt = [&](size_t index) -> const std::shared_ptr<const PointCloudSelection::Chunk>& {
+        return deleted ? deleted->chunk(index) : kNoChunk;
+    };
+    auto upToDate = [&](size_t index) {
+        return m_flagChunkValid[index] && m_flagSelected[index] == selectedAt(index) && m_flagDeleted[index] == deletedAt(index);
+    };
+    const size_t chunkCount = m_flagChunkValid.size();
+    glBindBuffer(GL_ARRAY_BUFFER, m_flagBuffer);
+    size_t c = 0;
+    while (c < chunkCount) {
+        if (upToDate(c)) {
+            ++c;
+            continue;
+        }
+
+        size_t end = c + 1;
+        while (end < chunkCount && end - c < kFlagUploadChunks && !upToDate(end)) ++end;
+
+        const size_t begin = c * PointCloudSelection::kChunkPoints;
+        const size_t count = std::min(pointCount, end * PointCloudSelection::kChunkPoints) - begin;
+        m_flagStaging.assign(count, 0);
+        for (; c < end; ++c) {
+            const std::shared_ptr<const PointCloudSelection::Chunk>& selectedChunk = selectedAt(c);
+            const std::shared_ptr<const PointCloudSelection::Chunk>& deletedChunk = deletedAt(c);
+            quint8* flags = m_flagStaging.data() + (c * PointCloudSelection::kChunkPoints - begin);
+            const size_t points = std::min(PointCloudSelection::kChunkPoints, pointCount - c * PointCloudSelection::kChunkPoints);
+            if (selectedChunk) {
+                for (size_t i = 0; i < points; ++i) flags[i] = static_cast<quint8>((*selectedChunk)[i / 64] >> (i % 64) & 1u);
+            }
+            if (deletedChunk) {
+                for (size_t i = 0; i < points; ++i) flags[i] |= static_cast<quint8>(((*deletedChunk)[i / 64] >> (i % 64) & 1u) << 1);
+            }
+            m_flagSelected[c] = selectedChunk;
+            m_flagDeleted[c] = deletedChunk;
+            m_flagChunkValid[c] = true;
+        }
+        glBufferSubData(GL_ARRAY_BUFFER, static_cast<GLintptr>(begin), static_cast<GLsizeiptr>(count), m_flagStaging.data());
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void PointCloudRenderer::releaseFlagBuffer()
+{
+    if (m_flagBuffer) glDeleteBuffers(1, &m_flagBuffer);
+    m_flagBuffer = 0;
+    m_flagPointCount = 0;
+    m_flagSelected.clear();
+    m_flagDeleted.clear();
+    m_flagChunkValid.clear();
+    std::vector<quint8>().swap(m_flagStaging);
+}
+
+// 点大小相关的 uniform，拾取时与画面使用相同的点大小
+// 自适应时间距网格绑定在纹理单元 1，调用方绘制后解绑
+void PointCloudRenderer::setPointSizeUniforms(QOpenGLShaderProgram* program, const PointCloudFrameState& state, bool adaptive)
+{
+    if (!adaptive) {
+        program->setUniformValue("uPointSize", state.pointSize.fixedSize);
+        return;
+    }
+
+    const PointCloudSpacing& spacing = state.dataset->spacing();
+    const float gridScale = 1.0f / spacing.cellSize;
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_3D, m_spacingTexture);
+    program->setUniformValue("uSpacing", 1);
+    program->setUniformValue("uSpacingOrigin", QVector3D(spacing.origin[0], spacing.origin[1], spacing.origin[2]));
+    program->setUniformValue("uSpacingScale", QVector3D(gridScale / spacing.dims[0], gridScale / spacing.dims[1], gridScale / spacing.dims[2]));
+    // 距相机一个单位处，一个单位长度在渲染目标上的像素数
+    program->setUniformValue("uPixelsPerUnit", state.projection(1, 1) * state.renderSize.height() * 0.5f);
+    program->setUniformValue("uPointScale", state.pointSize.scale);
+    program->setUniformValue("uPointSizeRange", QVector2D(state.pointSize.minSize, state.pointSize.maxSize));
+}
+
+// 拾取窗口：整数颜色附件 + 深度，读回用的 PBO 环
+bool PointCloudRenderer::ensurePickTarget()
+{
+    if (m_pickFbo) return true;
+    if (m_pickFailed) return false;
+
+    glGenTextures(1, &m_pickIds);
+    glBindTexture(GL_TEXTURE_2D, m_pickIds);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R32UI, kPickWindow, kPickWindow, 0, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glGenRenderbuffers(1, &m_pickDepth);
+    glBindRenderbuffer(GL_RENDERBUFFER, m_pickDepth);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, kPickWindow, kPickWindow);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glGenFramebuffers(1, &m_pickFbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, m_pickFbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_pickIds, 0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, m_pickDepth);
+    const bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    if (!complete) {
+        qWarning() << "Pick framebuffer is incomplete, point picking disabled";
+        glDeleteFramebuffers(1, &m_pickFbo);
+        glDeleteTextures(1, &m_pickIds);
+        glDeleteRenderbuffers(1, &m_pickDepth);
+        m_pickFbo = m_pickIds = m_pickDepth = 0;
+        m_pickFailed = true;
+        return false;
+    }
+
+    for (PickRead& read : m_pickReads) {
+        glGenBuffers(1, &read.pbo);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, read.pbo);
+        glBufferData(GL_PIXEL_PACK_BUFFER, kPickWindow * kPickWindow * sizeof(GLuint), nullptr, GL_STREAM_READ);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    return true;
+}
+
+// 用与画面相同的相机和点大小，把点击位置周围 kPickWindow 见方的区域放大到整个拾取窗口（同 gluPickMatrix），
+// 深度测试保证取到的是可见的点；glReadPixels 写入 PBO 后立即返回，用同步对象判断何时可以读取
+// 调用方持有 GL_PROGRAM_POINT_SIZE 等渲染状态
+void PointCloudRenderer::renderPickIds(const PointCloudFrameState& state)
+{
+    m_lastPickSerial = state.pick.serial;
+
+    PickRead* read = acquirePickRead();
+    if (!read) {
+        // 拾取不可用或在途的读回太多，直接返回未命中
+        PointCloudPickResult result;
+        result.serial = state.pick.serial;
+        m_pickResults.push_back(result);
+        return;
+    }
+
+    const int half = kPickWindow / 2;
+    const float width = static_cast<float>(state.renderSize.width());
+    const float height = static_cast<float>(state.renderSize.height());
+    const float centerX = state.pick.pixel.x() + 0.5f;
+    const float centerY = state.pick.pixel.y() + 0.5f;
+    QMatrix4x4 pickMatrix;
+    pickMatrix.translate((width - 2.0f * centerX) / kPickWindow, (height - 2.0f * centerY) / kPickWindow, 0.0f);
+    pickMatrix.scale(width / kPickWindow, height / kPickWindow, 1.0f);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, m_pickFbo);
+    glViewport(0, 0, kPickWindow, kPickWindow);
+    const GLuint clearId[4] = { 0, 0, 0, 0 };
+    glClearBufferuiv(GL_COLOR, 0, clearId);
+    glClear(GL_DEPTH_BUFFER_BIT);
+    glEnable(GL_DEPTH_TEST);
+
+    const std::shared_ptr<PointCloudDataset>& dataset = state.dataset;
+    if (dataset && dataset == m_dataset) {
+        QMutexLocker locker(dataset->gpuMutex());
+        const size_t drawCount = dataset->uploadedPointCount();
+        const bool adaptive = state.pointSize.adaptive && dataset->spacing().valid();
+        const bool clipping = state.clipping && !state.clipping->empty();
+        QOpenGLShaderProgram* program = drawCount > 0 && dataset->hasGpuData() && m_vaoGeneration == dataset->gpuGeneration()
+            ? pointProgram(state.renderMode, adaptive, clipping, true) : nullptr;
+        if (program) {
+            program->bind();
+            program->setUniformValue("uProjection", pickMatrix * state.projection);
+            program->setUniformValue("uView", state.view);
+            setPointSizeUniforms(program, state, adaptive);
+            if (clipping) setClipUniforms(program, state);
+            m_vao.bind();
+            drawPoints(state, drawCount);
+            m_vao.release();
+            program->release();
+            if (adaptive) {
+                glBindTexture(GL_TEXTURE_3D, 0);
+                glActiveTexture(GL_TEXTURE0);
+            }
+        }
+    }
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, read->pbo);
+    glReadPixels(0, 0, kPickWindow, kPickWindow, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    read->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    read->kind = PointCloudPickResult::ePoint;
+    read->serial = state.pick.serial;
+    read->pixel = state.pick.pixel;
+    read->origin = QPoint(state.pick.pixel.x() - half, state.pick.pixel.y() - half);
+    read->window = QSize(kPickWindow, kPickWindow);
+    read->renderSize = state.renderSize;
+}
+
+// 空闲的读回槽位，拾取不可用或在途的读回太多时返回空
+PointCloudRenderer::PickRead* PointCloudRenderer::acquirePickRead()
+{
+    if (!ensurePickTarget()) return nullptr;
+    for (PickRead& read : m_pickReads) {
+        if (!read.fence) return &read;
+    }
+    return nullptr;
+}
+
+// 点云（以及补洞、视觉着色合成）写入的深度就在目标帧缓冲中，坐标轴和包围盒不写深度
+// 读取点击位置周围的窗口，点之间的空隙处取最近的有效深度
+void PointCloudRenderer::readPickDepth(const PointCloudFrameState& state, GLuint fbo)
+{
+    m_lastDepthPickSerial = state.depthPick.serial;
+
+    PickRead* read = acquirePickRead();
+    if (!read) {
+        PointCloudPickResult result;
+        result.kind = PointCloudPickResult::eDepth;
+        result.serial = state.depthPick.serial;
+        m_pickResults.push_back(result);
+        return;
+    }
+
+    // 窗口裁剪到渲染区域内
+    const int half = kPickWindow / 2;
+    const QPoint origin(qBound(0, state.depthPick.pixel.x() - half, qMax(0, state.renderSize.width() - kPickWindow)),
+        qBound(0, state.depthPick.pixel.y() - half, qMax(0, state.renderSize.height() - kPickWindow)));
+    const int width = qMin(kPickWindow, state.renderSize.width());
+    const int height = qMin(kPickWindow, state.renderSize.height());
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, read->pbo);
+    glReadPixels(origin.x(), origin.y(), width, height, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    read->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    read->kind = PointCloudPickResult::eDepth;
+    read->serial = state.depthPick.serial;
+    read->pixel = state.depthPick.pixel;
+    read->origin = origin;
+    read->window = QSize(width, height);
+    read->renderSize = state.renderSize;
+    read->inverseProjection = state.projection.inverted();
+    read->inverseView = state.view.inverted();
+}
+
+bool PointCloudRenderer::pickPending() const
+{
+    if (!m_pickResults.empty()) return true;
+    for (const PickRead& read : m_pickReads) {
+        if (read.fence) return true;
+    }
+    return false;
+}
+
+// 只查询同步对象，GPU 还没写完的读回留到下次
+std::vector<PointCloudPickResult> PointCloudRenderer::takePickResults()
+{
+    for (PickRead& read : m_pickReads) {
+        if (!read.fence) continue;
+        const GLenum status = glClientWaitSync(read.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+        if (status == GL_TIMEOUT_EXPIRED) continue;
+        glDeleteSync(read.fence);
+        read.fence = nullptr;
+        if (status == GL_WAIT_FAILED) {
+            PointCloudPickResult result;
+            result.serial = read.serial;
+            m_pickResults.push_back(result);
+        }
+        else {
+            m_pickResults.push_back(resolvePick(read));
+        }
+    }
+
+    std::vector<PointCloudPickResult> results;
+    results.swap(m_pickResults);
+    std::sort(results.begin(), results.end(),
+        [](const PointCloudPickResult& a, const PointCloudPickResult& b) { return a.serial < b.serial; });
+    return results;
+}
+
+// 窗口中离点击位置最近的点；窗口超出渲染区域的部分在画面上看不到，跳过
+// 深度读取取离点击位置最近的有效深度，按该像素反投影
+PointCloudPickResult PointCloudRenderer::resolvePick(PickRead& read)
+{
+    PointCloudPickResult result;
+    result.kind = read.kind;
+    result.serial = read.serial;
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, read.pbo);
+    if (read.kind == PointCloudPickResult::eDepth) {
+        // 深度窗口已裁剪到渲染区域
+        const int width = read.window.width();
+        const int height = read.window.height();
+        const float* depths = static_cast<const float*>(glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0,
+            static_cast<GLsizeiptr>(width) * height * sizeof(float), GL_MAP_READ_BIT));
+        if (depths) {
+            int best = std::numeric_limits<int>::max();
+            int bestX = 0;
+            int bestY = 0;
+            float bestDepth = 1.0f;
+            for (int y = 0; y < height; ++y) {
+                for (int x = 0; x < width; ++x) {
+                    const float depth = depths[y * width + x];
+                    const int dx = read.origin.x() + x - read.pixel.x();
+                    const int dy = read.origin.y() + y - read.pixel.y();
+                    if (depth < 1.0f && dx * dx + dy * dy < best) {
+                        best = dx * dx + dy * dy;
+                        bestX = x;
+                        bestY = y;
+                        bestDepth = depth;
+                    }
+                }
+            }
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+
+            if (best != std::numeric_limits<int>::max()) {
+                // 像素中心的 NDC
+                const float ndcX = (read.origin.x() + bestX + 0.5f) * 2.0f / read.renderSize.width() - 1.0f;
+                const float ndcY = (read.origin.y() + bestY + 0.5f) * 2.0f / read.renderSize.height() - 1.0f;
+                const QVector4D eye = read.inverseProjection * QVector4D(ndcX, ndcY, bestDepth * 2.0f - 1.0f, 1.0f);
+                if (std::abs(eye.w()) > 1e-12f) {
+                    result.position = (read.inverseView * QVector4D(eye.toVector3D() / eye.w(), 1.0f)).toVector3D();
+                    result.hit = true;
+                }
+            }
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        return result;
+    }
+
+    const GLuint* ids = static_cast<const GLuint*>(glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0,
+        kPickWindow * kPickWindow * sizeof(GLuint), GL_MAP_READ_BIT));
+    if (ids) {
+        const int half = kPickWindow / 2;
+        int best = std::numeric_limits<int>::max();
+        for (int y = 0; y < kPickWindow; ++y) {
+            const int renderY = read.origin.y() + y;
+            if (renderY < 0 || renderY >= read.renderSize.height()) continue;
+            for (int x = 0; x < kPickWindow; ++x) {
+                const int renderX = read.origin.x() + x;
+                if (renderX < 0 || renderX >= read.renderSize.width()) continue;
+                const GLuint id = ids[y * kPickWindow + x];
+                const int distance = (x - half) * (x - half) + (y - half) * (y - half);
+                if (id != 0 && distance < best) {
+                    best = distance;
+                    result.hit = true;
+                    result.index = id - 1;
+                }
+            }
+        }
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    return result;
+}
+
+void PointCloudRenderer::initScreenAxisOrtho()
+{
+    // 1. 着色器（使用正交投影矩阵）
+    m_axisShader = PointCloudShaderLibrary::create(PointCloudShaderLibrary::eScreenAxis);
+    if (!m_axisShader) return;
+
+    // --- 2. 构建顶点数据：轴线 + 字母（Z/X/Y）---
+    struct Vertex {
+        float x, y, z;
+        float r, g, b;
+    };
+    std::vector<Vertex> vertices;
+
+    const float L = 30.0f; // 轴长度
+    const float W = 5.0f;  // 字母大小
+
+    // ---- Z 轴（蓝色）----
+    // 轴线
+    vertices.push_back({ 0, 0, 0, 0, 0, 1 });
+    vertices.push_back({ 0, 0, L, 0, 0, 1 });
+    // 字母 "Z"（在 Z=L 平面）
+    vertices.push_back({ -W,  W, L, 0, 0, 1 });
+    vertices.push_back({ W,  W, L, 0, 0, 1 });
+    vertices.push_back({ W,  W, L, 0, 0, 1 });
+    vertices.push_back({ -W, -W, L, 0, 0, 1 });
+    vertices.push_back({ -W, -W, L, 0, 0, 1 });
+    vertices.push_back({ W, -W, L, 0, 0, 1 });
+
+    // ---- X 轴（红色）----
+    // 轴线
+    vertices.push_back({ 0, 0, 0, 1, 0, 0 });
+    vertices.push_back({ L, 0, 0, 1, 0, 0 });
+    // 字母 "X"
+    vertices.push_back({ L + W,  W, 0, 1, 0, 0 });
+    vertices.push_back({ L - W, -W, 0, 1, 0, 0 });
+    vertices.push_back({ L + W, -W, 0, 1, 0, 0 });
+    vertices.push_back({ L - W,  W, 0, 1, 0, 0 });
+
+    // ---- Y 轴（绿色）----
+    // 轴线
+    vertices.push_back({ 0, 0, 0, 0, 1, 0 });
+    vertices.push_back({ 0, L, 0, 0, 1, 0 });
+    // 字母 "Y"
+    vertices.push_back({ 0, L + W, 0, 0, 1, 0 });
+    vertices.push_back({ 0, L + W + 5, 0, 0, 1, 0 });
+    vertices.push_back({ 0, L + W + 5, 0, 0, 1, 0 });
+    vertices.push_back({ -W, L + W + 10, 0, 0, 1, 0 });
+    vertices.push_back({ 0, L + W + 5, 0, 0, 1, 0 });
+    vertices.push_back({ W, L + W + 10, 0, 0, 1, 0 });
+
+    // 3. 创建VBO VAO
+    m_axisVao.create();
+    m_axisVao.bind();
+    m_axisVbo.create();
+    m_axisVbo.bind();
+    m_axisVbo.allocate(vertices.data(),
+        static_cast<int>(vertices.size() * sizeof(Vertex)));
+
+    glEnableVertexAttribArray(0);
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE,
+        sizeof(float) * 6, nullptr);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE,
+        sizeof(float) * 6,
+        reinterpret_cast<void*>(sizeof(float) * 3));
+    m_axisVbo.release();
+    m_axisVao.release();
+}
+
+void PointCloudRenderer::renderScreenAxisOrtho(const PointCloudFrameState& state)
+{
+    if (!m_axisShader) return;
+
+    glDisable(GL_DEPTH_TEST);
+    glLineWidth(3.0f);
+    glEnable(GL_LINE_SMOOTH);
+
+    // 创建正交投影矩阵（覆盖整个屏幕）
+    // 屏幕左下角偏移（像素）
+    const float width = static_cast<float>(state.viewportSize.width());
+    const float height = static_cast<float>(state.viewportSize.height());
+    float margin = 50.0f;
+    float posX = -width / 2.0f + margin;
+    float posY = -height / 2.0f + margin;
+
+    // 构建正交投影（像素空间）
+    QMatrix4x4 ortho;
+    ortho.setToIdentity();
+    ortho.ortho(-width / 2.0f, width / 2.0f, -height / 2.0f, height / 2.0f, -1000.0f, 1000.0f);
+
+    QMatrix3x3 rotationMatrix = state.view.normalMatrix(); // 获取用于法线变换的3x3子矩阵，实际上就是旋转部分
+    // 创建坐标轴的模型矩阵
+    QMatrix4x4 modelMatrix;
+    modelMatrix.setToIdentity(); // 初始化为单位矩阵
+
+    // 将提取的旋转应用到模型矩阵上
+    modelMatrix.rotate(QQuaternion::fromRotationMatrix(rotationMatrix));
+    //平移到posX posY
+    QMatrix4x4 model;
+    model.translate(posX, posY, 0.0f);
+    QMatrix4x4 mvp = ortho * model * modelMatrix;
+
+    // 渲染
+    m_axisShader->bind();
+    m_axisShader->setUniformValue("uProjection", mvp);
+
+    m_axisVao.bind();
+    glDrawArrays(GL_LINES, 0, 24);
+
+    // 清理
+    m_axisVao.release();
+    m_axisShader->release();
+}
+
+void PointCloudRenderer::updateBoundingBoxGeometry(const PointCloudFrameState& state)
+{
+    m_boxMin = state.bboxMin;
+    m_boxMax = state.bboxMax;
+
+    // 使用世界坐标系的实际顶点创建边界盒
+    float minX = m_boxMin.x();
+    float minY = m_boxMin.y();
+    float minZ = m_boxMin.z();
+    float maxX = m_boxMax.x();
+    float maxY = m_boxMax.y();
+    float maxZ = m_boxMax.z();
+
+    // 边界盒的8个顶点（世界坐标）
+    m_boxVertices = {
+        // 底面4个顶点
+        minX, minY, minZ,  // 0: 左前下
+        maxX, minY, minZ,  // 1: 右前下
+        maxX, maxY, minZ,  // 2: 右后下
+        minX, maxY, minZ,  // 3: 左后下
+
+        // 顶面4个顶点
+        minX, minY, maxZ,  // 4: 左前上
+        maxX, minY, maxZ,  // 5: 右前上
+        maxX, maxY, maxZ,  // 6: 右后上
+        minX, maxY, maxZ   // 7: 左后上
+    };
+
+    // 12条边的索引（24个索引）
+    m_boxIndices = {
+        // 底面矩形
+        0, 1,  // 底面前边
+        1, 2,  // 底面右边
+        2, 3,  // 底面后边
+        3, 0,  // 底面左边
+
+        // 顶面矩形
+        4, 5,  // 顶面前边
+        5, 6,  // 顶面右边
+        6, 7,  // 顶面后边
+        7, 4,  // 顶面左边
+
+        // 垂直边
+        0, 4,  // 左前垂直边
+        1, 5,  // 右前垂直边
+        2, 6,  // 右后垂直边
+        3, 7   // 左后垂直边
+    };
+
+    // 更新顶点数据
+    m_boxVbo.bind();
+    m_boxVbo.allocate(m_boxVertices.data(),
+        static_cast<int>(m_boxVertices.size() * sizeof(float)));
+    m_boxVbo.release();
+}
+
+void PointCloudRenderer::initBoundingBoxGeometry()
+{
+    // 1. 着色器
+    m_boxShader = PointCloudShaderLibrary::create(PointCloudShaderLibrary::eBoundingBox);
+    if (!m_boxShader) return;
+
+    // 2. 初始化为空数据，绘制时按帧状态中的包围盒填充
+    m_boxVao.create();
+    m_boxVao.bind();
+    m_boxVbo.create();
+    m_boxVbo.bind();
+
+    m_boxVbo.setUsagePattern(QOpenGLBuffer::DynamicDraw);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), nullptr);
+    m_boxVao.release();
+    m_boxVbo.release();
+}
+
+void PointCloudRenderer::renderBoundingBox(const PointCloudFrameState& state)
+{
+    if (!m_boxShader || !state.dataset || state.dataset->pointCount() == 0) return;
+
+    if (m_boxVertices.empty() || state.bboxMin != m_boxMin || state.bboxMax != m_boxMax) {
+        updateBoundingBoxGeometry(state);
+    }
+
+    // 禁用深度写入，确保边界盒始终可见
+    glDepthMask(GL_FALSE);
+
+    // 启用混合，使边界盒半透明
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    // 设置线条渲染
+    glEnable(GL_LINE_SMOOTH);
+    glHint(GL_LINE_SMOOTH_HINT, GL_NICEST);
+    glLineWidth(3.0f); // 更粗的线
+
+    m_boxShader->bind();
+
+    // 设置MVP矩阵
+    QMatrix4x4 mvp = state.projection * state.view;
+    m_boxShader->setUniformValue("uMVP", mvp);
+    m_boxShader->setUniformValue("uColor", QVector3D(1.0f, 0.5f, 0.0f)); // 橙色
+    m_boxShader->setUniformValue("uAlpha", 0.8f); // 80%不透明度
+
+    // 绑定顶点数据
+    m_boxVao.bind();
+    // 绘制所有边
+    glDrawElements(GL_LINES,
+        static_cast<GLsizei>(m_boxIndices.size()),
+        GL_UNSIGNED_INT,
+        m_boxIndices.data());
+    m_boxVao.release();
+    m_boxShader->release();
+
+    // 恢复渲染状态
+    glLineWidth(1.0f);
+    glDepthMask(GL_TRUE);
+    glDisable(GL_BLEND);
+}
@@ -0,0 +1,226 @@
+﻿#pragma once
+
+#include "PointCloudDataset.h"
+#include "PointCloudUploader.h"
+#include "PointCloudColormap.h"
+#include "PointCloudPostProcess.h"
+#include "PointCloudSelection.h"
+#include "PointCloudClipping.h"
+
+#include <QOpenGLFunctions_3_3_Core>
+#include <QOpenGLShaderProgram>
+#include <QOpenGLBuffer>
+#include <QOpenGLVertexArrayObject>
+#include <QOpenGLFramebufferObject>
+#include <QMatrix4x4>
+#include <QVector3D>
+#include <QSize>
+#include <QPoint>
+#include <unordered_map>
+#include <memory>
+#include <vector>
+
+// 点大小：自适应时按点所在网格的点间距投影到屏幕上的像素数，再乘以全局系数
+// 稀疏处放大保持覆盖，密集处缩小减少重叠绘制
+struct PointCloudPointSizeSettings
+{
+    bool adaptive = true;
+    float scale = 1.0f;       // 全局系数
+    float fixedSize = 3.0f;   // 非自适应时的点大小（像素）
+    float minSize = 1.0f;     // 自适应时的范围（像素）
+    float maxSize = 10.0f;
+};
+
+// 点拾取请求：渲染像素坐标（左下角为原点），每次点击序号递增，0 表示没有请求
+struct PointCloudPickRequest
+{
+    quint64 serial = 0;
+    QPoint pixel;
+};
+
+// 拾取结果，与同类请求按序号对应
+struct PointCloudPickResult
+{
+    enum Kind
+    {
+        ePoint,   // 点序号缓冲，得到具体的点
+        eDepth    // 画面深度缓冲，反投影得到表面位置（含补洞填出的表面）
+    };
+    Kind kind = ePoint;
+    quint64 serial = 0;
+    bool hit = false;
+    quint32 index = 0;     // 点在数据集中的序号（ePoint）
+    QVector3D position;    // 局部坐标（eDepth）
+};
+
+// 一帧场景需要的全部状态，由窗口在 GUI 线程生成快照后交给渲染器
+// 渲染器只读快照，不访问窗口成员，可以在渲染线程中使用
+struct PointCloudFrameState
+{
+    std::shared_ptr<PointCloudDataset> dataset;
+    QMatrix4x4 projection;
+    QMatrix4x4 view;
+    int renderMode = 0;        // 0: elevation, 1: RGB
+    std::shared_ptr<const PointCloudColormap> colormap;   // 高程色带
+    QVector3D bboxMin;         // 局部坐标
+    QVector3D bboxMax;
+    float displayMinZ = 0.0f;  // 高程色带覆盖的范围（局部坐标）
+    float displayMaxZ = 1.0f;
+    PointCloudPointSizeSettings pointSize;
+    PointCloudEdlSettings edl;
+    PointCloudHoleFillSettings holeFill;
+    std::shared_ptr<const PointCloudSelection> selection;   // 选中的点高亮显示，可以为空
+    std::shared_ptr<const PointCloudClipping> clipping;     // 裁剪盒和剖切面，可以为空
+    std::shared_ptr<const PointCloudSelection> deleted;     // 已删除的点不绘制，可以为空
+    QSize viewportSize;        // 窗口逻辑尺寸，屏幕坐标轴按像素定位
+    QSize targetSize;          // 帧缓冲尺寸（设备像素）
+    QSize renderSize;          // 实际渲染区域（左下角），动态分辨率时小于 targetSize
+    quint64 cameraVersion = 0;
+    quint64 dataVersion = 0;
+    PointCloudPickRequest pick;        // 随这一帧处理的点拾取请求
+    PointCloudPickRequest depthPick;   // 随这一帧处理的深度读取请求（旋转中心）
+
+    // 版本号和尺寸相同则画出的内容相同；新的拾取请求也要提交一次
+    bool sameFrame(const PointCloudFrameState& other) const
+    {
+        return cameraVersion == other.cameraVersion && dataVersion == other.dataVersion
+            && targetSize == other.targetSize && renderSize == other.renderSize
+            && pick.serial == other.pick.serial && depthPick.serial == other.depthPick.serial;
+    }
+};
+
+// 场景渲染：点云、屏幕空间后处理（补洞、视觉着色）、屏幕坐标轴、包围盒
+// 所有 GL 对象属于创建它的上下文（VAO 不能跨上下文共享），构造、使用和析构都要在同一上下文中
+class PointCloudRenderer : protected QOpenGLFunctions_3_3_Core
+{
+public:
+    PointCloudRenderer();
+    ~PointCloudRenderer();
+
+    bool initialize();
+
+    // 渲染到 fbo 左下角 state.renderSize 区域
+    void render(const PointCloudFrameState& state, QOpenGLFramebufferObject* fbo);
+
+    // 最近一次测得的帧时间换算到全分辨率（毫秒），结果尚未就绪时返回负数；不阻塞
+    double takeFrameTime();
+
+    // 上一帧只画了已上传的部分点，需要继续渲染直到上传完成
+    bool uploadPending() const { return m_uploadPending; }
+
+    // 点拾取：点序号写入整数缓冲，只画点击位置周围的小窗口，经 PBO 异步读回
+    // 结果在之后的帧中取得（通常是下一帧），不阻塞；时间与点云规模无关，不在 CPU 上搜索
+    // 深度读取：从画好的帧中把点击位置周围的深度经 PBO 读回，反投影为局部坐标
+    bool pickPending() const;
+    std::vector<PointCloudPickResult> takePickResults();
+
+private:
+    void initPointCloud();
+    QOpenGLShaderProgram* pointProgram(int renderMode, bool adaptiveSize, bool clipping, bool pickId = false);
+    void setPointSizeUniforms(QOpenGLShaderProgram* program, const PointCloudFrameState& state, bool adaptive);
+    void setClipUniforms(QOpenGLShaderProgram* program, const PointCloudFrameState& state);
+    void drawPoints(const PointCloudFrameState& state, size_t drawCount);
+    void updateColormapTexture(const std::shared_ptr<const PointCloudColormap>& colormap);
+    void updateSpacingTexture(const std::shared_ptr<const PointCloudDataset>& dataset);
+    void setupVertexArray();
+    void renderPointCloud(const PointCloudFrameState& state);
+    void updateFlagBuffer(const PointCloudFrameState& state);
+    void releaseFlagBuffer();
+
+    bool ensurePickTarget();
+    void renderPickIds(const PointCloudFrameState& state);
+    void readPickDepth(const PointCloudFrameState& state, GLuint fbo);
+
+    void initScreenAxisOrtho();
+    void renderScreenAxisOrtho(const PointCloudFrameState& state);
+
+    void initBoundingBoxGeometry();
+    void updateBoundingBoxGeometry(const PointCloudFrameState& state);
+    void renderBoundingBox(const PointCloudFrameState& state);
+
+    bool m_initialized = false;
+
+    // 点云，每种渲染模式和点大小方式一个着色器变体，第一次使用时创建
+    std::unordered_map<int, std::unique_ptr<QOpenGLShaderProgram>> m_programs;
+    QOpenGLVertexArrayObject m_vao;
+    std::shared_ptr<PointCloudDataset> m_dataset;
+    int m_vaoGeneration = -1;   // VAO 对应的数据集 GPU 缓冲版本
+
+    // 裁剪、删除时按块剔除后的绘制区间（glMultiDrawArrays）
+    std::vector<GLint> m_drawFirsts;
+    std::vector<GLsizei> m_drawCounts;
+
+    // 逐点标志（每点 1 字节，第 0 位为选中，第 1 位为已删除），与当前数据集及其点数对应
+    // 按选择集和删除标记的块比较，只把指针变化的块展开上传；m_flagSelected、m_flagDeleted 为各块已上传的内容，
+    // m_flagChunkValid 为 false 的块 GPU 中还没有写入；一次最多合并 kFlagUploadChunks 块，限制暂存内存
+    static constexpr size_t kFlagUploadChunks = 64;
+    GLuint m_flagBuffer = 0;
+    size_t m_flagPointCount = 0;
+    std::vector<std::shared_ptr<const PointCloudSelection::Chunk>> m_flagSelected;
+    std::vector<std::shared_ptr<const PointCloudSelection::Chunk>> m_flagDeleted;
+    std::vector<bool> m_flagChunkValid;
+    std::vector<quint8> m_flagStaging;
+
+    // 高程色带查找表（一维纹理），色带变化时只更新纹理
+    GLuint m_colormapTexture = 0;
+    std::shared_ptr<const PointCloudColormap> m_colormap;
+
+    // 点间距网格（三维纹理），切换数据集时更新
+    GLuint m_spacingTexture = 0;
+    std::weak_ptr<const PointCloudDataset> m_spacingSource;   // 纹理对应的数据集
+    int m_spacingGeneration = -1;                             // 纹理对应的点间距版本，数据集压缩后重新上传
+
+    // 流式上传，每帧最多占用 kUploadBudgetMs
+    static constexpr double kUploadBudgetMs = 3.0;
+    PointCloudUploader m_uploader;
+    bool m_uploadPending = false;
+
+    // 屏幕空间后处理
+    PointCloudPostProcess m_postProcess;
+
+    // 点拾取，同时在途的读回最多 kPickSlots 个
+    static constexpr int kPickWindow = 15;   // 拾取窗口边长（像素），取离点击位置最近的点
+    static constexpr int kPickSlots = 4;
+    struct PickRead
+    {
+        GLuint pbo = 0;
+        GLsync fence = nullptr;
+        PointCloudPickResult::Kind kind = PointCloudPickResult::ePoint;
+        quint64 serial = 0;
+        QPoint pixel;        // 点击位置（渲染像素）
+        QPoint origin;       // 读取窗口左下角在渲染区域中的位置
+        QSize window;        // 读取窗口尺寸
+        QSize renderSize;
+        QMatrix4x4 inverseProjection;   // 深度读取时这一帧的相机
+        QMatrix4x4 inverseView;
+    };
+    GLuint m_pickFbo = 0;
+    GLuint m_pickIds = 0;     // R32UI，点序号 + 1，0 为没有点
+    GLuint m_pickDepth = 0;
+    bool m_pickFailed = false;
+    PickRead m_pickReads[kPickSlots];
+    quint64 m_lastPickSerial = 0;
+    quint64 m_lastDepthPickSerial = 0;
+    std::vector<PointCloudPickResult> m_pickResults;
+    PickRead* acquirePickRead();
+    PointCloudPickResult resolvePick(PickRead& read);
+
+    // 屏幕坐标轴
+    std::unique_ptr<QOpenGLShaderProgram> m_axisShader;
+    QOpenGLBuffer m_axisVbo;
+    QOpenGLVertexArrayObject m_axisVao;
+
+    // 包围盒
+    std::unique_ptr<QOpenGLShaderProgram> m_boxShader;
+    QOpenGLBuffer m_boxVbo;
+    QOpenGLVertexArrayObject m_boxVao;
+    std::vector<float> m_boxVertices; // 存储边界盒顶点数据
+    std::vector<unsigned int> m_boxIndices; // 存储边界盒索引数据
+    QVector3D m_boxMin;
+    QVector3D m_boxMax;
+
+    // 帧计时
+    GLuint m_frameQuery = 0;
+    bool m_frameQueryPending = false;
+    double m_frameQueryPixelRatio = 1.0;   // 全分辨率像素数 / 实际渲染像素数
+};
@@ -0,0 +1,239 @@
+﻿#include "PointCloudSelection.h"
+
+#include <QtConcurrent>
+#include <QtAlgorithms>
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <numeric>
+
+PointCloudSelection::PointCloudSelection(size_t pointCount)
+    : m_pointCount(pointCount)
+    , m_chunks((pointCount + kChunkPoints - 1) / kChunkPoints)
+    , m_chunkCounts(m_chunks.size(), 0)
+{
+}
+
+bool PointCloudSelection::isSelected(size_t index) const
+{
+    if (index >= m_pointCount) return false;
+
+    const std::shared_ptr<const Chunk>& chunk = m_chunks[index / kChunkPoints];
+    const size_t offset = index % kChunkPoints;
+    return chunk && ((*chunk)[offset / 64] >> (offset % 64) & 1u) != 0;
+}
+
+size_t PointCloudSelection::nextIndex(size_t from, size_t end, bool selected) const
+{
+    end = std::min(end, m_pointCount);
+    size_t i = from;
+    while (i < end) {
+        const size_t c = i / kChunkPoints;
+        const size_t chunkBegin = c * kChunkPoints;
+        const size_t chunkEnd = chunkBegin + kChunkPoints;
+        const std::shared_ptr<const Chunk>& chunk = m_chunks[c];
+        // 整块都不是要找的状态时跳到下一块
+        const bool uniform = !chunk || m_chunkCounts[c] == std::min(kChunkPoints, m_pointCount - chunkBegin);
+        if (uniform) {
+            if (static_cast<bool>(chunk) == selected) return i;
+            i = chunkEnd;
+            continue;
+        }
+
+        for (size_t w = (i - chunkBegin) / 64; w < kChunkWords; ++w) {
+            quint64 word = selected ? (*chunk)[w] : ~(*chunk)[w];
+            const size_t wordBegin = chunkBegin + w * 64;
+            if (i > wordBegin) word &= ~quint64(0) << (i - wordBegin);
+            if (word) return std::min(end, wordBegin + qCountTrailingZeroBits(word));
+        }
+        i = chunkEnd;
+    }
+    return end;
+}
+
+std::shared_ptr<const PointCloudSelection> PointCloudSelection::select(const std::shared_ptr<const PointCloudSelection>& previous,
+    const PointCloudData& cloud, const QMatrix4x4& mvp, const QSize& viewport,
+    const QRectF& bounds, const QImage* mask, Mode mode, const PointCloudClipping* clipping,
+    const PointCloudSelection* excluded)
+{
+    const size_t count = cloud.pointCount();
+    auto result = std::make_shared<PointCloudSelection>(count);
+    const bool hasPrevious = previous && previous->pointCount() == count;
+
+    // 形状限制在窗口内，掩码按整数像素查表不会越界
+    const QRectF area = bounds.intersected(QRectF(0.0, 0.0, viewport.width(), viewport.height()));
+    const float left = static_cast<float>(area.left());
+    const float right = static_cast<float>(area.right());
+    const float top = static_cast<float>(area.top());
+    const float bottom = static_cast<float>(area.bottom());
+    const float halfWidth = viewport.width() * 0.5f;
+    const float halfHeight = viewport.height() * 0.5f;
+    const float* m = mvp.constData();   // 列主序
+
+    std::vector<size_t> chunkIndices(result->m_chunks.size());
+    std::iota(chunkIndices.begin(), chunkIndices.end(), size_t(0));
+    if (clipping && clipping->empty()) clipping = nullptr;
+    if (excluded && (excluded->pointCount() != count || excluded->empty())) excluded = nullptr;
+
+    QtConcurrent::blockingMap(chunkIndices, [&](size_t c) {
+        const std::shared_ptr<const Chunk> before = hasPrevious ? previous->m_chunks[c] : nullptr;
+        const size_t begin = c * kChunkPoints;
+        const size_t end = std::min(count, begin + kChunkPoints);
+
+        Chunk hits(kChunkWords, 0);
+        quint64 anyHit = 0;
+        if (!area.isEmpty()) {
+            const float* p = cloud.points.data() + begin * PointCloudData::kFloatsPerPoint;
+            for (size_t i = begin; i < end; ++i, p += PointCloudData::kFloatsPerPoint) {
+                const float w = m[3] * p[0] + m[7] * p[1] + m[11] * p[2] + m[15];
+                const float x = m[0] * p[0] + m[4] * p[1] + m[8] * p[2] + m[12];
+                const float y = m[1] * p[0] + m[5] * p[1] + m[9] * p[2] + m[13];
+                const float sx = (x / w + 1.0f) * halfWidth;
+                const float sy = (1.0f - y / w) * halfHeight;
+                // 不用分支，随机分布的点没有分支预测失败的开销；相机后方（w <= 0）的点不选
+                quint64 inside = (w > 0.0f) & (sx >= left) & (sx < right) & (sy >= top) & (sy < bottom);
+                if (mask && inside) inside = mask->constScanLine(static_cast<int>(sy))[static_cast<int>(sx)] != 0;
+                if (clipping && inside) inside = clipping->contains(p);
+                if (excluded && inside) inside = !excluded->isSelected(i);
+
+                const size_t offset = i - begin;
+                hits[offset / 64] |= inside << (offset % 64);
+                anyHit |= inside;
+            }
+        }
+
+        // 没有变化的块沿用原来的，渲染线程不用重新上传
+        std::shared_ptr<const Chunk> after;
+        if (mode == eReplace) {
+            if (anyHit) after = before && *before == hits ? before : std::make_shared<const Chunk>(std::move(hits));
+        }
+        else if (!anyHit || (mode == eSubtract && !before)) {
+            after = before;
+        }
+        else {
+            Chunk merged = before ? *before : Chunk(kChunkWords, 0);
+            bool any = false;
+            for (size_t k = 0; k < kChunkWords; ++k) {
+                merged[k] = mode == eAdd ? merged[k] | hits[k] : merged[k] & ~hits[k];
+                any = any || merged[k] != 0;
+            }
+            if (any) after = before && *before == merged ? before : std::make_shared<const Chunk>(std::move(merged));
+        }
+
+        size_t bits = 0;
+        if (after) {
+            for (quint64 word : *after) bits += qPopulationCount(word);
+        }
+        result->m_chunkCounts[c] = static_cast<quint32>(bits);
+        result->m_chunks[c] = std::move(after);
+    });
+
+    result->m_selectedCount = std::accumulate(result->m_chunkCounts.begin(), result->m_chunkCounts.end(), size_t(0));
+    return result;
+}
+
+std::shared_ptr<const PointCloudSelection> PointCloudSelection::united(const std::shared_ptr<const PointCloudSelection>& previous,
+    const PointCloudSelection& other)
+{
+    if (previous && previous->pointCount() != other.pointCount()) return nullptr;
+
+    auto result = std::make_shared<PointCloudSelection>(other.pointCount());
+    for (size_t c = 0; c < result->m_chunks.size(); ++c) {
+        const std::shared_ptr<const Chunk> before = previous ? previous->m_chunks[c] : nullptr;
+        const std::shared_ptr<const Chunk>& added = other.m_chunks[c];
+        if (!added || !before) {
+            result->m_chunks[c] = added ? added : before;
+            result->m_chunkCounts[c] = added ? other.m_chunkCounts[c] : previous ? previous->m_chunkCounts[c] : 0;
+            continue;
+        }
+
+        Chunk merged(kChunkWords);
+        size_t bits = 0;
+        for (size_t k = 0; k < kChunkWords; ++k) {
+            merged[k] = (*before)[k] | (*added)[k];
+            bits += qPopulationCount(merged[k]);
+        }
+        result->m_chunks[c] = bits == previous->m_chunkCounts[c] ? before : std::make_shared<const Chunk>(std::move(merged));
+        result->m_chunkCounts[c] = static_cast<quint32>(bits);
+    }
+    result->m_selectedCount = std::accumulate(result->m_chunkCounts.begin(), result->m_chunkCounts.end(), size_t(0));
+    return result;
+}
+
+bool PointCloudSelection::bounds(const PointCloudData& cloud, QVector3D& min, QVector3D& max) const
+{
+    if (empty() || cloud.pointCount() != m_pointCount) return false;
+
+    struct Box
+    {
+        float min[3];
+        float max[3];
+    };
+    const float inf = std::numeric_limits<float>::infinity();
+    std::vector<Box> boxes(m_chunks.size(), Box{ { inf, inf, inf }, { -inf, -inf, -inf } });
+    std::vector<size_t> chunkIndices(m_chunks.size());
+    std::iota(chunkIndices.begin(), chunkIndices.end(), size_t(0));
+
+    QtConcurrent::blockingMap(chunkIndices, [&](size_t c) {
+        const std::shared_ptr<const Chunk>& chunk = m_chunks[c];
+        if (!chunk) return;
+        Box& box = boxes[c];
+        for (size_t k = 0; k < kChunkWords; ++k) {
+            quint64 word = (*chunk)[k];
+            while (word) {
+                const size_t i = c * kChunkPoints + k * 64 + qCountTrailingZeroBits(word);
+                word &= word - 1;
+                const float* p = cloud.points.data() + i * PointCloudData::kFloatsPerPoint;
+                for (int a = 0; a < 3; ++a) {
+                    box.min[a] = std::min(box.min[a], p[a]);
+                    box.max[a] = std::max(box.max[a], p[a]);
+                }
+            }
+        }
+    });
+
+    Box total{ { inf, inf, inf }, { -inf, -inf, -inf } };
+    for (const Box& box : boxes) {
+        for (int a = 0; a < 3; ++a) {
+            total.min[a] = std::min(total.min[a], box.min[a]);
+            total.max[a] = std::max(total.max[a], box.max[a]);
+        }
+    }
+    min = QVector3D(total.min[0], total.min[1], total.min[2]);
+    max = QVector3D(total.max[0], total.max[1], total.max[2]);
+    return true;
+}
+
+// 先按块统计保留的点数，前缀和得到各块的输出位置，再按未选中的连续区间并行复制
+std::shared_ptr<PointCloudData> PointCloudSelection::extractUnselected(const PointCloudData& cloud) const
+{
+    const size_t count = cloud.pointCount();
+    auto result = std::make_shared<PointCloudData>();
+    result->origin = cloud.origin;
+    result->hasColor = cloud.hasColor;
+    result->schema = cloud.schema;
+    if (count != m_pointCount) return result;
+
+    std::vector<size_t> offsets(m_chunks.size() + 1, 0);
+    for (size_t c = 0; c < m_chunks.size(); ++c) {
+        offsets[c + 1] = offsets[c] + std::min(kChunkPoints, count - c * kChunkPoints) - m_chunkCounts[c];
+    }
+    const bool hasIntensity = cloud.intensity.size() == count;
+    result->points.resize(offsets.back() * PointCloudData::kFloatsPerPoint);
+    if (hasIntensity) result->intensity.resize(offsets.back());
+
+    std::vector<size_t> chunkIndices(m_chunks.size());
+    std::iota(chunkIndices.begin(), chunkIndices.end(), size_t(0));
+    QtConcurrent::blockingMap(chunkIndices, [&](size_t c) {
+        size_t out = offsets[c];
+        forEachUnselectedRun(c * kChunkPoints, std::min(count, (c + 1) * kChunkPoints), [&](size_t begin, size_t end) {
+            std::memcpy(result->points.data() + out * PointCloudData::kFloatsPerPoint,
+                cloud.points.data() + begin * PointCloudData::kFloatsPerPoint,
+                (end - begin) * PointCloudData::kFloatsPerPoint * sizeof(float));
+            if (hasIntensity) std::copy(cloud.intensity.begin() + begin, cloud.intensity.begin() + end, result->intensity.begin() + out);
+            out += end - begin;
+        });
+    });
+    return result;
+}
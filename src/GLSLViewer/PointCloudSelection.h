@@ -0,0 +1,82 @@
+﻿#pragma once
+
+#include "glslviewer_global.h"
+#include "PointCloudData.h"
+#include "PointCloudClipping.h"
+
+#include <QMatrix4x4>
+#include <QVector3D>
+#include <QRectF>
+#include <QImage>
+#include <vector>
+#include <memory>
+
+// 点选择集：按固定点数分块的位集，没有选中点的块不占内存（1 亿点全部选中约 12MB）
+// 块一旦生成就不再修改，修改选择时生成新的选择集，没有变化的块与原来的共享；
+// 渲染线程按块指针比较找出变化的块，只更新 GPU 标志缓冲中对应的区间
+// 同样的结构也用作删除标记（墓碑）：被删除的点为“选中”的点
+class GLSLVIEWER_EXPORT PointCloudSelection
+{
+public:
+    static constexpr size_t kChunkPoints = size_t(1) << 16;
+    static constexpr size_t kChunkWords = kChunkPoints / 64;
+    using Chunk = std::vector<quint64>;   // kChunkWords 个字，第 i 位对应块内第 i 个点
+
+    enum Mode
+    {
+        eReplace,    // 替换原来的选择
+        eAdd,        // 加入
+        eSubtract    // 移除
+    };
+
+    explicit PointCloudSelection(size_t pointCount = 0);
+
+    size_t pointCount() const { return m_pointCount; }
+    size_t selectedCount() const { return m_selectedCount; }
+    bool empty() const { return m_selectedCount == 0; }
+    size_t chunkCount() const { return m_chunks.size(); }
+    // 空指针表示这一块没有选中的点
+    const std::shared_ptr<const Chunk>& chunk(size_t index) const { return m_chunks[index]; }
+    size_t chunkSelectedCount(size_t index) const { return m_chunkCounts[index]; }
+    bool isSelected(size_t index) const;
+
+    // [from, end) 中第一个选中状态为 selected 的点，没有时返回 end；整块、整字跳过
+    size_t nextIndex(size_t from, size_t end, bool selected) const;
+
+    // 对 [begin, end) 中未选中的每个连续区间调用 f(runBegin, runEnd)
+    template <class F>
+    void forEachUnselectedRun(size_t begin, size_t end, F&& f) const
+    {
+        size_t i = nextIndex(begin, end, false);
+        while (i < end) {
+            const size_t runEnd = nextIndex(i, end, true);
+            f(i, runEnd);
+            i = nextIndex(runEnd, end, false);
+        }
+    }
+
+    // 选择投影落在屏幕形状内的点，按块并行
+    // mvp 把局部坐标变换到裁剪空间，投影到 viewport 大小的窗口坐标（左上角为原点）后与 bounds 比较；
+    // mask 非空时为与 viewport 同尺寸的灰度图，非零像素在形状内（多边形先光栅化，每个点只查一次表）
+    // 相机后方、被 clipping 裁掉和 excluded 中（已删除）的点不显示，也不选；previous 点数不一致时视为空选择
+    static std::shared_ptr<const PointCloudSelection> select(const std::shared_ptr<const PointCloudSelection>& previous,
+        const PointCloudData& cloud, const QMatrix4x4& mvp, const QSize& viewport,
+        const QRectF& bounds, const QImage* mask, Mode mode, const PointCloudClipping* clipping = nullptr,
+        const PointCloudSelection* excluded = nullptr);
+
+    // 两个选择集的并集，点数不一致时返回空；other 中没有选中点的块沿用 previous 的
+    static std::shared_ptr<const PointCloudSelection> united(const std::shared_ptr<const PointCloudSelection>& previous,
+        const PointCloudSelection& other);
+
+    // 选中点的包围盒（局部坐标），没有选中点时返回 false
+    bool bounds(const PointCloudData& cloud, QVector3D& min, QVector3D& max) const;
+
+    // 复制未选中的点（坐标、颜色、强度），保持原来的顺序和原点；按块并行
+    std::shared_ptr<PointCloudData> extractUnselected(const PointCloudData& cloud) const;
+
+private:
+    size_t m_pointCount = 0;
+    size_t m_selectedCount = 0;
+    std::vector<std::shared_ptr<const Chunk>> m_chunks;
+    std::vector<quint32> m_chunkCounts;   // 每块选中的点数
+};
@@ -0,0 +1,73 @@
+﻿#include "PointCloudShaderLibrary.h"
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QDebug>
+
+namespace
+{
+    struct ProgramSource
+    {
+        const char* name;
+        const char* vertex;
+        const char* fragment;
+    };
+
+    const ProgramSource kPrograms[] = {
+        { "pointcloud", ":/shaders/shaders/pointcloud.vert", ":/shaders/shaders/pointcloud.frag" },
+        { "axis", ":/shaders/shaders/axis.vert", ":/shaders/shaders/axis.frag" },
+        { "box", ":/shaders/shaders/box.vert", ":/shaders/shaders/box.frag" },
+        { "edl", ":/shaders/shaders/screen.vert", ":/shaders/shaders/edl.frag" },
+        { "holefill", ":/shaders/shaders/screen.vert", ":/shaders/shaders/holefill.frag" },
+    };
+
+    // 读取源码并在 #version 之后插入变体宏
+    QByteArray shaderSource(const char* path, const QByteArrayList& defines)
+    {
+        QFile file(QString::fromLatin1(path));
+        if (!file.open(QIODevice::ReadOnly)) {
+            qCritical() << "Cannot open shader source" << path;
+            return QByteArray();
+        }
+        QByteArray source = file.readAll();
+        if (defines.isEmpty()) return source;
+
+        QByteArray header;
+        for (const QByteArray& define : defines) header += "#define " + define + '\n';
+
+        // #version 必须是第一条语句
+        qsizetype insertAt = 0;
+        if (source.startsWith("#version")) {
+            const qsizetype lineEnd = source.indexOf('\n');
+            insertAt = lineEnd < 0 ? source.size() : lineEnd + 1;
+        }
+        source.insert(insertAt, header);
+        return source;
+    }
+}
+
+std::unique_ptr<QOpenGLShaderProgram> PointCloudShaderLibrary::create(Program program, const QByteArrayList& defines)
+{
+    const ProgramSource& source = kPrograms[program];
+
+    QElapsedTimer timer;
+    timer.start();
+
+    // 命中二进制缓存时 link() 直接加载，不编译源码；缓存按源码区分，每个变体各有一份
+    auto shader = std::make_unique<QOpenGLShaderProgram>();
+    if (!shader->addCacheableShaderFromSourceCode(QOpenGLShader::Vertex, shaderSource(source.vertex, defines))) {
+        qCritical() << "Failed to compile vertex shader" << source.vertex;
+        return nullptr;
+    }
+    if (!shader->addCacheableShaderFromSourceCode(QOpenGLShader::Fragment, shaderSource(source.fragment, defines))) {
+        qCritical() << "Failed to compile fragment shader" << source.fragment;
+        return nullptr;
+    }
+    if (!shader->link()) {
+        qCritical() << "Failed to link shader program" << source.name << shader->log();
+        return nullptr;
+    }
+
+    qDebug() << "Shader program" << source.name << defines << "ready in" << timer.nsecsElapsed() / 1e6 << "ms";
+    return shader;
+}
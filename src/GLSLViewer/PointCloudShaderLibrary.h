@@ -0,0 +1,30 @@
+﻿#pragma once
+
+#include <QOpenGLShaderProgram>
+#include <QByteArrayList>
+#include <memory>
+
+// 渲染器使用的着色器程序，源码都在 QT6_GLSL.qrc 中
+// 通过 addCacheableShaderFromSourceFile 创建：链接后的程序二进制由 Qt 按驱动厂商、渲染器和版本
+// 保存在磁盘缓存中，进程内也保留一份，之后新建窗口、重启程序时直接加载二进制，不再编译
+//
+// QOpenGLShaderProgram 记录的是创建它的上下文的函数表，上下文随窗口隐藏而销毁，
+// 因此程序对象按上下文各建一份，共享的是链接结果
+//
+// 变体：同一份源码在 #version 之后插入 #define 得到不同的程序（渲染模式等），
+// 着色器内用 #if 选择路径，不在每个顶点上按 uniform 分支；每个变体单独缓存
+class PointCloudShaderLibrary
+{
+public:
+    enum Program
+    {
+        ePointCloud,
+        eScreenAxis,
+        eBoundingBox,
+        eEyeDome,     // 视觉着色后处理，全屏三角形
+        eHoleFill     // 屏幕空间补洞（pull-push），全屏三角形
+    };
+
+    // 在当前上下文中创建并链接，defines 为变体宏（如 "COLOR_RGB"），失败返回空
+    static std::unique_ptr<QOpenGLShaderProgram> create(Program program, const QByteArrayList& defines = {});
+};
@@ -0,0 +1,83 @@
+﻿#include "PointCloudSpacing.h"
+
+#include <QtConcurrent>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+
+namespace
+{
+    // 每个并行块的点数
+    const size_t kChunkPoints = 256 * 1024;
+
+    struct Range
+    {
+        size_t begin;
+        size_t end;
+    };
+}
+
+PointCloudSpacing PointCloudSpacing::compute(const PointCloudData& cloud, const PointCloudStats& stats)
+{
+    PointCloudSpacing result;
+    const size_t count = cloud.pointCount();
+    if (count == 0 || !stats.valid()) return result;
+
+    // 格子边长：先按最长轴取 kMaxDimension 格，总格数超出时放大
+    float extent[3];
+    for (int k = 0; k < 3; ++k) extent[k] = std::max(stats.max[k] - stats.min[k], 1e-6f);
+    float cell = std::max({ extent[0], extent[1], extent[2] }) / kMaxDimension;
+    for (;;) {
+        qint64 cells = 1;
+        for (int k = 0; k < 3; ++k) {
+            result.dims[k] = std::clamp(static_cast<int>(std::ceil(extent[k] / cell)), 1, kMaxDimension);
+            cells *= result.dims[k];
+        }
+        if (cells <= kMaxCells) break;
+        cell *= 1.25f;
+    }
+    result.cellSize = cell;
+    for (int k = 0; k < 3; ++k) result.origin[k] = stats.min[k];
+
+    const int dimX = result.dims[0];
+    const int dimY = result.dims[1];
+    const int dimZ = result.dims[2];
+    const size_t cellCount = static_cast<size_t>(dimX) * dimY * dimZ;
+    std::vector<std::atomic<uint32_t>> counts(cellCount);
+    for (std::atomic<uint32_t>& c : counts) c.store(0, std::memory_order_relaxed);
+
+    const float inv = 1.0f / cell;
+    const float* points = cloud.points.data();
+    auto countChunk = [&](const Range& range) {
+        const float* p = points + range.begin * PointCloudData::kFloatsPerPoint;
+        for (size_t i = range.begin; i < range.end; ++i, p += PointCloudData::kFloatsPerPoint) {
+            const int x = std::min(static_cast<int>((p[0] - result.origin[0]) * inv), dimX - 1);
+            const int y = std::min(static_cast<int>((p[1] - result.origin[1]) * inv), dimY - 1);
+            const int z = std::min(static_cast<int>((p[2] - result.origin[2]) * inv), dimZ - 1);
+            counts[(static_cast<size_t>(z) * dimY + y) * dimX + x].fetch_add(1, std::memory_order_relaxed);
+        }
+    };
+
+    std::vector<Range> ranges;
+    for (size_t begin = 0; begin < count; begin += kChunkPoints) {
+        ranges.push_back({ begin, std::min(count, begin + kChunkPoints) });
+    }
+    if (ranges.size() == 1) countChunk(ranges.front());
+    else QtConcurrent::blockingMap(ranges, countChunk);
+
+    result.spacing.resize(cellCount);
+    std::vector<float> occupied;
+    for (size_t i = 0; i < cellCount; ++i) {
+        const uint32_t n = counts[i].load(std::memory_order_relaxed);
+        result.spacing[i] = n > 0 ? cell / std::sqrt(static_cast<float>(n)) : 0.0f;
+        if (n > 0) occupied.push_back(result.spacing[i]);
+    }
+
+    if (!occupied.empty()) {
+        auto middle = occupied.begin() + occupied.size() / 2;
+        std::nth_element(occupied.begin(), middle, occupied.end());
+        result.medianSpacing = *middle;
+    }
+    return result;
+}
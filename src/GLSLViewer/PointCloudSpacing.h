@@ -0,0 +1,28 @@
+﻿#pragma once
+
+#include "glslviewer_global.h"
+#include "PointCloudData.h"
+#include "PointCloudStats.h"
+
+#include <vector>
+
+// 点间距估计：把包围盒划分为立方体网格，按每格的点数估计局部点间距
+// 点大致分布在穿过格子的曲面上，面积约为边长²，n 个点的间距约为 边长 / sqrt(n)；
+// 对地面和立面都成立，不需要按方向区分。没有点的格子为 0
+// 着色器按点所在格子的间距和投影尺度决定点大小：稀疏处放大保持覆盖，密集处缩小减少重叠
+struct GLSLVIEWER_EXPORT PointCloudSpacing
+{
+    static constexpr int kMaxDimension = 256;        // 每轴格数上限（三维纹理尺寸）
+    static constexpr int kMaxCells = 1 << 18;        // 总格数上限
+
+    int dims[3] = { 0, 0, 0 };
+    float origin[3] = { 0.0f, 0.0f, 0.0f };          // 网格最小角（局部坐标）
+    float cellSize = 0.0f;
+    std::vector<float> spacing;                      // x 最快变化，其次 y、z
+    float medianSpacing = 0.0f;                      // 有点的格子的间距中位数
+
+    bool valid() const { return !spacing.empty(); }
+
+    // 按块并行计数，格子计数器为原子变量
+    static PointCloudSpacing compute(const PointCloudData& cloud, const PointCloudStats& stats);
+};
@@ -0,0 +1,446 @@
+﻿#include "PointCloudStats.h"
+#include "PointCloudSelection.h"
+
+#include <QtConcurrent>
+
+#include <algorithm>
+#include <limits>
+
+#if defined(_M_X64) || defined(__x86_64__) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PCS_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+    // 每个并行块的点数
+    const size_t kChunkPoints = 256 * 1024;
+
+    const int kBins = PointCloudStats::kHistogramBins;
+
+    struct Range
+    {
+        size_t begin;
+        size_t end;
+    };
+
+    // 单块的归约结果，顺序为 x y z r g b
+    struct Partial
+    {
+        size_t count = 0;
+        float min[6];
+        float max[6];
+        double sum[3] = { 0.0, 0.0, 0.0 };
+        float intensityMin = std::numeric_limits<float>::max();
+        float intensityMax = std::numeric_limits<float>::lowest();
+
+        Partial()
+        {
+            std::fill(min, min + 6, std::numeric_limits<float>::max());
+            std::fill(max, max + 6, std::numeric_limits<float>::lowest());
+        }
+
+        void merge(const Partial& other)
+        {
+            count += other.count;
+            for (int k = 0; k < 6; ++k) {
+                min[k] = std::min(min[k], other.min[k]);
+                max[k] = std::max(max[k], other.max[k]);
+            }
+            for (int k = 0; k < 3; ++k) sum[k] += other.sum[k];
+            intensityMin = std::min(intensityMin, other.intensityMin);
+            intensityMax = std::max(intensityMax, other.intensityMax);
+        }
+    };
+
+    // 第一遍：包围盒、颜色范围、坐标和（双精度累加）
+    void reducePoints(const float* p, size_t n, Partial& r)
+    {
+        size_t i = 0;
+#ifdef PCS_SSE2
+        // 每个点读两次 4 个 float：(x y z r) 和 (z r g b)，都不越过本点的 6 个 float
+        __m128 minA = _mm_set1_ps(std::numeric_limits<float>::max());
+        __m128 maxA = _mm_set1_ps(std::numeric_limits<float>::lowest());
+        __m128 minB = minA;
+        __m128 maxB = maxA;
+        __m128d sumXY = _mm_setzero_pd();
+        __m128d sumZR = _mm_setzero_pd();
+
+        for (; i < n; ++i, p += PointCloudData::kFloatsPerPoint) {
+            const __m128 a = _mm_loadu_ps(p);
+            const __m128 b = _mm_loadu_ps(p + 2);
+            minA = _mm_min_ps(minA, a);
+            maxA = _mm_max_ps(maxA, a);
+            minB = _mm_min_ps(minB, b);
+            maxB = _mm_max_ps(maxB, b);
+            sumXY = _mm_add_pd(sumXY, _mm_cvtps_pd(a));
+            sumZR = _mm_add_pd(sumZR, _mm_cvtps_pd(_mm_movehl_ps(a, a)));
+        }
+
+        float lo[4], hi[4], loB[4], hiB[4];
+        _mm_storeu_ps(lo, minA);
+        _mm_storeu_ps(hi, maxA);
+        _mm_storeu_ps(loB, minB);
+        _mm_storeu_ps(hiB, maxB);
+        double xy[2], zr[2];
+        _mm_storeu_pd(xy, sumXY);
+        _mm_storeu_pd(zr, sumZR);
+
+        for (int k = 0; k < 4; ++k) {
+            r.min[k] = std::min(r.min[k], lo[k]);
+            r.max[k] = std::max(r.max[k], hi[k]);
+        }
+        for (int k = 4; k < 6; ++k) {
+            r.min[k] = std::min(r.min[k], loB[k - 2]);
+            r.max[k] = std::max(r.max[k], hiB[k - 2]);
+        }
+        r.sum[0] += xy[0];
+        r.sum[1] += xy[1];
+        r.sum[2] += zr[0];
+#endif
+        for (; i < n; ++i, p += PointCloudData::kFloatsPerPoint) {
+            for (int k = 0; k < 6; ++k) {
+                r.min[k] = std::min(r.min[k], p[k]);
+                r.max[k] = std::max(r.max[k], p[k]);
+            }
+            for (int k = 0; k < 3; ++k) r.sum[k] += p[k];
+        }
+        r.count += n;
+    }
+
+    void reduceIntensity(const float* v, size_t n, Partial& r)
+    {
+        size_t i = 0;
+#ifdef PCS_SSE2
+        if (n >= 4) {
+            __m128 lo = _mm_set1_ps(r.intensityMin);
+            __m128 hi = _mm_set1_ps(r.intensityMax);
+            for (; i + 4 <= n; i += 4) {
+                const __m128 x = _mm_loadu_ps(v + i);
+                lo = _mm_min_ps(lo, x);
+                hi = _mm_max_ps(hi, x);
+            }
+            float l[4], h[4];
+            _mm_storeu_ps(l, lo);
+            _mm_storeu_ps(h, hi);
+            for (int k = 0; k < 4; ++k) {
+                r.intensityMin = std::min(r.intensityMin, l[k]);
+                r.intensityMax = std::max(r.intensityMax, h[k]);
+            }
+        }
+#endif
+        for (; i < n; ++i) {
+            r.intensityMin = std::min(r.intensityMin, v[i]);
+            r.intensityMax = std::max(r.intensityMax, v[i]);
+        }
+    }
+
+    // 第二遍：已知范围后统计各轴直方图，结果按 [axis * kBins + bin] 存放
+    void histogramPoints(const float* p, size_t n, const float min[3], const float scale[3], uint32_t* hist)
+    {
+        size_t i = 0;
+#ifdef PCS_SSE2
+        const __m128 vMin = _mm_setr_ps(min[0], min[1], min[2], 0.0f);
+        const __m128 vScale = _mm_setr_ps(scale[0], scale[1], scale[2], 0.0f);
+        const __m128 vZero = _mm_setzero_ps();
+        const __m128 vLast = _mm_set1_ps(static_cast<float>(kBins - 1));
+        alignas(16) int32_t bin[4];
+
+        for (; i < n; ++i, p += PointCloudData::kFloatsPerPoint) {
+            __m128 t = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(p), vMin), vScale);
+            t = _mm_min_ps(_mm_max_ps(t, vZero), vLast);
+            _mm_store_si128(reinterpret_cast<__m128i*>(bin), _mm_cvttps_epi32(t));
+            ++hist[bin[0]];
+            ++hist[kBins + bin[1]];
+            ++hist[2 * kBins + bin[2]];
+        }
+#endif
+        for (; i < n; ++i, p += PointCloudData::kFloatsPerPoint) {
+            for (int k = 0; k < 3; ++k) {
+                const float t = std::min(std::max((p[k] - min[k]) * scale[k], 0.0f), static_cast<float>(kBins - 1));
+                ++hist[k * kBins + static_cast<int>(t)];
+            }
+        }
+    }
+
+    std::vector<Range> splitRanges(size_t count)
+    {
+        std::vector<Range> ranges;
+        for (size_t begin = 0; begin < count; begin += kChunkPoints) {
+            ranges.push_back({ begin, std::min(count, begin + kChunkPoints) });
+        }
+        return ranges;
+    }
+
+    // 区间内未删除的连续段，excluded 为空时为整个区间
+    template <class Fn>
+    void forEachLiveRun(const PointCloudSelection* excluded, const Range& range, Fn fn)
+    {
+        if (excluded) excluded->forEachUnselectedRun(range.begin, range.end, fn);
+        else fn(range.begin, range.end);
+    }
+
+    // 按块并行计算后串行合并，只有一块时不进线程池
+    template <class Result, class MapFn, class MergeFn>
+    Result mapReduce(const std::vector<Range>& ranges, MapFn map, MergeFn merge)
+    {
+        if (ranges.size() == 1) return map(ranges.front());
+
+        Result total{};
+        bool first = true;
+        for (const Result& r : QtConcurrent::blockingMapped<std::vector<Result>>(ranges, map)) {
+            if (first) total = r;
+            else merge(total, r);
+            first = false;
+        }
+        return total;
+    }
+
+    //!--------------------------分位数----------------------------------
+    const int kPctBins = PointCloudStats::kPercentileBins;
+
+    // 标量属性在内存中的位置：首元素和步长（float 个数）
+    struct ScalarView
+    {
+        const float* data = nullptr;
+        size_t stride = 1;
+        size_t count = 0;
+        const PointCloudSelection* excluded = nullptr;   // 跳过的点
+    };
+
+    bool scalarView(const PointCloudData& cloud, PointScalar scalar, ScalarView& view)
+    {
+        const size_t count = cloud.pointCount();
+        if (count == 0) return false;
+
+        switch (scalar) {
+        case PointScalar::X:
+        case PointScalar::Y:
+        case PointScalar::Z:
+            view.data = cloud.points.data() + static_cast<int>(scalar);
+            view.stride = PointCloudData::kFloatsPerPoint;
+            view.count = count;
+            return true;
+        case PointScalar::Intensity:
+            if (cloud.intensity.size() != count) return false;
+            view.data = cloud.intensity.data();
+            view.stride = 1;
+            view.count = count;
+            return true;
+        }
+        return false;
+    }
+
+    // [lo, hi] 上 kPctBins 等分的格号，两级直方图共用同一公式，保证第二级筛选与第一级计数一致
+    inline int binOf(float v, float lo, float scale)
+    {
+        const int b = static_cast<int>((v - lo) * scale);
+        return std::min(std::max(b, 0), kPctBins - 1);
+    }
+
+    // 第 rank 个（从 0 起）值所在的格，cumBefore 为此前各格的累计数
+    int findBin(const std::vector<uint64_t>& hist, uint64_t rank, uint64_t& cumBefore)
+    {
+        uint64_t cum = cumBefore;
+        for (int b = 0; b < static_cast<int>(hist.size()); ++b) {
+            if (cum + hist[b] > rank) {
+                cumBefore = cum;
+                return b;
+            }
+            cum += hist[b];
+        }
+        cumBefore = cum - (hist.empty() ? 0 : hist.back());
+        return static_cast<int>(hist.size()) - 1;
+    }
+
+    // 已知范围 [lo, hi] 时的两级直方图分位数
+    void percentilesInRange(const ScalarView& view, const std::vector<Range>& ranges, float lo, float hi,
+        double lowPercent, double highPercent, float& low, float& high)
+    {
+        if (!(hi > lo)) {
+            low = high = lo;
+            return;
+        }
+
+        const float scale = kPctBins / (hi - lo);
+        auto mergeHist = [](std::vector<uint64_t>& a, const std::vector<uint64_t>& b) {
+            for (size_t i = 0; i < a.size(); ++i) a[i] += b[i];
+        };
+
+        // 第一级：整个范围
+        const std::vector<uint64_t> coarse = mapReduce<std::vector<uint64_t>>(ranges,
+            [&view, lo, scale](const Range& range) {
+                std::vector<uint64_t> hist(kPctBins, 0);
+                forEachLiveRun(view.excluded, range, [&](size_t begin, size_t end) {
+                    const float* p = view.data + begin * view.stride;
+                    for (size_t i = begin; i < end; ++i, p += view.stride) ++hist[binOf(*p, lo, scale)];
+                });
+                return hist;
+            }, mergeHist);
+
+        // 有删除的点时参与统计的点数少于 view.count，按直方图总数计算秩
+        uint64_t total = 0;
+        for (uint64_t n : coarse) total += n;
+        if (total == 0) {
+            low = lo;
+            high = hi;
+            return;
+        }
+        const double last = static_cast<double>(total - 1);
+        const uint64_t rank[2] = {
+            static_cast<uint64_t>(std::clamp(lowPercent, 0.0, 100.0) / 100.0 * last + 0.5),
+            static_cast<uint64_t>(std::clamp(highPercent, 0.0, 100.0) / 100.0 * last + 0.5)
+        };
+        uint64_t cumBefore[2] = { 0, 0 };
+        const int coarseBin[2] = { findBin(coarse, rank[0], cumBefore[0]), findBin(coarse, rank[1], cumBefore[1]) };
+
+        // 第二级：只细分两个分位数所在的格，一遍同时统计
+        const float coarseWidth = (hi - lo) / kPctBins;
+        const float fineScale = kPctBins / coarseWidth;
+        const std::vector<uint64_t> fine = mapReduce<std::vector<uint64_t>>(ranges,
+            [&view, lo, scale, &coarseBin, coarseWidth, fineScale](const Range& range) {
+                std::vector<uint64_t> hist(2 * kPctBins, 0);
+                const float base[2] = { lo + coarseBin[0] * coarseWidth, lo + coarseBin[1] * coarseWidth };
+                forEachLiveRun(view.excluded, range, [&](size_t begin, size_t end) {
+                    const float* p = view.data + begin * view.stride;
+                    for (size_t i = begin; i < end; ++i, p += view.stride) {
+                        const int b = binOf(*p, lo, scale);
+                        for (int k = 0; k < 2; ++k) {
+                            if (b == coarseBin[k]) ++hist[k * kPctBins + binOf(*p, base[k], fineScale)];
+                        }
+                    }
+                });
+                return hist;
+            }, mergeHist);
+
+        float result[2];
+        for (int k = 0; k < 2; ++k) {
+            const std::vector<uint64_t> sub(fine.begin() + k * kPctBins, fine.begin() + (k + 1) * kPctBins);
+            uint64_t cum = cumBefore[k];
+            const int fineBin = findBin(sub, rank[k], cum);
+            // 取细分格的中点
+            result[k] = lo + coarseBin[k] * coarseWidth + (fineBin + 0.5f) * coarseWidth / kPctBins;
+        }
+        low = std::clamp(result[0], lo, hi);
+        high = std::clamp(result[1], lo, hi);
+    }
+}
+
+PointCloudStats PointCloudStats::compute(const PointCloudData& cloud, const PointCloudSelection* excluded)
+{
+    PointCloudStats stats;
+    const size_t count = cloud.pointCount();
+    if (count == 0) return stats;
+    if (excluded && (excluded->pointCount() != count || excluded->empty())) excluded = nullptr;
+
+    const bool hasIntensity = cloud.intensity.size() == count;
+    const std::vector<Range> ranges = splitRanges(count);
+
+    // 第一遍：按块并行归约后串行合并
+    auto reduceChunk = [&cloud, hasIntensity, excluded](const Range& range) {
+        Partial r;
+        forEachLiveRun(excluded, range, [&](size_t begin, size_t end) {
+            reducePoints(cloud.points.data() + begin * PointCloudData::kFloatsPerPoint, end - begin, r);
+            if (hasIntensity) reduceIntensity(cloud.intensity.data() + begin, end - begin, r);
+        });
+        return r;
+    };
+
+    Partial total;
+    if (ranges.size() == 1) {
+        total = reduceChunk(ranges.front());
+    }
+    else {
+        for (const Partial& r : QtConcurrent::blockingMapped<std::vector<Partial>>(ranges, reduceChunk)) {
+            total.merge(r);
+        }
+    }
+
+    // 全部被删除
+    if (total.count == 0) return stats;
+
+    stats.count = total.count;
+    for (int k = 0; k < 3; ++k) {
+        stats.min[k] = total.min[k];
+        stats.max[k] = total.max[k];
+        stats.mean[k] = total.sum[k] / static_cast<double>(total.count);
+        stats.colorMin[k] = total.min[k + 3];
+        stats.colorMax[k] = total.max[k + 3];
+    }
+    stats.hasIntensity = hasIntensity;
+    if (hasIntensity) {
+        stats.intensityMin = total.intensityMin;
+        stats.intensityMax = total.intensityMax;
+    }
+
+    // 第二遍：直方图
+    float scale[3];
+    for (int k = 0; k < 3; ++k) {
+        const float extent = stats.max[k] - stats.min[k];
+        scale[k] = extent > 0.0f ? kBins / extent : 0.0f;
+    }
+
+    auto histogramChunk = [&cloud, &stats, &scale, excluded](const Range& range) {
+        std::vector<uint32_t> hist(3 * kBins, 0);
+        forEachLiveRun(excluded, range, [&](size_t begin, size_t end) {
+            histogramPoints(cloud.points.data() + begin * PointCloudData::kFloatsPerPoint,
+                end - begin, stats.min, scale, hist.data());
+        });
+        return hist;
+    };
+
+    std::vector<uint32_t> merged(3 * kBins, 0);
+    if (ranges.size() == 1) {
+        merged = histogramChunk(ranges.front());
+    }
+    else {
+        for (const std::vector<uint32_t>& hist : QtConcurrent::blockingMapped<std::vector<std::vector<uint32_t>>>(ranges, histogramChunk)) {
+            for (size_t b = 0; b < merged.size(); ++b) merged[b] += hist[b];
+        }
+    }
+
+    for (int k = 0; k < 3; ++k) {
+        stats.histogram[k].assign(merged.begin() + k * kBins, merged.begin() + (k + 1) * kBins);
+    }
+
+    // 默认高程显示范围
+    ScalarView zView;
+    scalarView(cloud, PointScalar::Z, zView);
+    zView.excluded = excluded;
+    percentilesInRange(zView, ranges, stats.min[2], stats.max[2],
+        kDefaultLowPercent, kDefaultHighPercent, stats.zLow, stats.zHigh);
+    return stats;
+}
+
+bool PointCloudStats::percentiles(const PointCloudData& cloud, PointScalar scalar,
+    double lowPercent, double highPercent, float& low, float& high, const PointCloudSelection* excluded)
+{
+    ScalarView view;
+    if (!scalarView(cloud, scalar, view)) return false;
+    if (excluded && excluded->pointCount() == view.count && !excluded->empty()) view.excluded = excluded;
+
+    const std::vector<Range> ranges = splitRanges(view.count);
+    using MinMax = std::pair<float, float>;
+    const MinMax extent = mapReduce<MinMax>(ranges,
+        [&view](const Range& range) {
+            MinMax r(std::numeric_limits<float>::max(), std::numeric_limits<float>::lowest());
+            forEachLiveRun(view.excluded, range, [&](size_t begin, size_t end) {
+                const float* p = view.data + begin * view.stride;
+                for (size_t i = begin; i < end; ++i, p += view.stride) {
+                    r.first = std::min(r.first, *p);
+                    r.second = std::max(r.second, *p);
+                }
+            });
+            return r;
+        },
+        [](MinMax& a, const MinMax& b) {
+            a.first = std::min(a.first, b.first);
+            a.second = std::max(a.second, b.second);
+        });
+
+    // 全部被删除
+    if (extent.first > extent.second) return false;
+
+    percentilesInRange(view, ranges, extent.first, extent.second, lowPercent, highPercent, low, high);
+    return true;
+}
@@ -0,0 +1,63 @@
+﻿#pragma once
+
+#include "glslviewer_global.h"
+#include "PointCloudData.h"
+
+#include <cstdint>
+#include <vector>
+
+class PointCloudSelection;
+
+// 可统计分位数的标量属性
+enum class PointScalar
+{
+    X,
+    Y,
+    Z,
+    Intensity
+};
+
+// 点云统计量：包围盒、均值、各轴直方图、颜色和强度范围、高程分位数
+// 按块并行归约，块内用 SSE 遍历交错顶点数组；加载和任何修改点云的操作之后都用它重新统计
+// excluded 非空时其中的点（已删除的点）不参与统计，按未删除的连续区间遍历
+struct GLSLVIEWER_EXPORT PointCloudStats
+{
+    static constexpr int kHistogramBins = 256;
+    static constexpr double kDefaultLowPercent = 1.0;
+    static constexpr double kDefaultHighPercent = 99.0;
+
+    size_t count = 0;
+    float min[3] = { 0.0f, 0.0f, 0.0f };    // 局部坐标
+    float max[3] = { 0.0f, 0.0f, 0.0f };
+    double mean[3] = { 0.0, 0.0, 0.0 };
+
+    float colorMin[3] = { 0.0f, 0.0f, 0.0f };
+    float colorMax[3] = { 0.0f, 0.0f, 0.0f };
+
+    bool hasIntensity = false;
+    float intensityMin = 0.0f;
+    float intensityMax = 0.0f;
+
+    // 各轴在 [min, max] 上的等宽直方图
+    std::vector<uint32_t> histogram[3];
+
+    // Z 的 1%–99% 分位数（局部坐标），默认的高程显示范围，不受零星的飞点影响
+    float zLow = 0.0f;
+    float zHigh = 0.0f;
+
+    bool valid() const { return count > 0; }
+
+    // 直方图第 bin 格的下边界（局部坐标）
+    float binValue(int axis, int bin) const
+    {
+        return min[axis] + (max[axis] - min[axis]) * bin / kHistogramBins;
+    }
+
+    static PointCloudStats compute(const PointCloudData& cloud, const PointCloudSelection* excluded = nullptr);
+
+    // 标量属性的分位数（百分比 0–100），并行两级直方图：第一级在 [min, max] 上划分，
+    // 第二级只细分分位数所在的格，精度为范围的 1/kPercentileBins²；属性不存在时返回 false
+    static constexpr int kPercentileBins = 4096;
+    static bool percentiles(const PointCloudData& cloud, PointScalar scalar,
+        double lowPercent, double highPercent, float& low, float& high, const PointCloudSelection* excluded = nullptr);
+};
@@ -0,0 +1,237 @@
+﻿#include "PointCloudTokenizer.h"
+
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define PCT_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define PCT_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define PCT_TARGET_AVX2
+#endif
+
+namespace
+{
+    using ClassifyFn = void (*)(const char* p, uint32_t& sep, uint32_t& newline);
+
+    // 字节分类表：1 为分隔符，3 为换行（换行同时也是分隔符）
+    struct ClassTable
+    {
+        unsigned char value[256] = {};
+
+        constexpr ClassTable()
+        {
+            value[static_cast<unsigned char>(' ')] = 1;
+            value[static_cast<unsigned char>('\t')] = 1;
+            value[static_cast<unsigned char>(',')] = 1;
+            value[static_cast<unsigned char>(';')] = 1;
+            value[static_cast<unsigned char>('\r')] = 1;
+            value[static_cast<unsigned char>('\n')] = 3;
+        }
+    };
+
+    constexpr ClassTable kClass;
+
+    inline int lowestBit(uint32_t v)
+    {
+#if defined(_MSC_VER)
+        unsigned long index;
+        _BitScanForward(&index, v);
+        return static_cast<int>(index);
+#else
+        return __builtin_ctz(v);
+#endif
+    }
+
+    // 标量实现，len 可以小于 32
+    void classifyScalar(const char* p, size_t len, uint32_t& sep, uint32_t& newline)
+    {
+        uint32_t s = 0, n = 0;
+        for (size_t i = 0; i < len; ++i) {
+            const unsigned char c = kClass.value[static_cast<unsigned char>(p[i])];
+            s |= static_cast<uint32_t>(c & 1) << i;
+            n |= static_cast<uint32_t>(c >> 1) << i;
+        }
+        sep = s;
+        newline = n;
+    }
+
+    void classifyScalar32(const char* p, uint32_t& sep, uint32_t& newline)
+    {
+        classifyScalar(p, 32, sep, newline);
+    }
+
+#ifdef PCT_X86
+    // SSE2 是 x86-64 的基线指令集，无需运行时检测
+    inline uint32_t sepMask16(__m128i v, uint32_t& newline)
+    {
+        const __m128i nl = _mm_cmpeq_epi8(v, _mm_set1_epi8('\n'));
+        __m128i s = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')),
+            _mm_cmpeq_epi8(v, _mm_set1_epi8('\t')));
+        s = _mm_or_si128(s, _mm_cmpeq_epi8(v, _mm_set1_epi8(',')));
+        s = _mm_or_si128(s, _mm_cmpeq_epi8(v, _mm_set1_epi8(';')));
+        s = _mm_or_si128(s, _mm_cmpeq_epi8(v, _mm_set1_epi8('\r')));
+        s = _mm_or_si128(s, nl);
+        newline = static_cast<uint32_t>(_mm_movemask_epi8(nl));
+        return static_cast<uint32_t>(_mm_movemask_epi8(s));
+    }
+
+    void classifySse2(const char* p, uint32_t& sep, uint32_t& newline)
+    {
+        uint32_t nlLo, nlHi;
+        const uint32_t lo = sepMask16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)), nlLo);
+        const uint32_t hi = sepMask16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 16)), nlHi);
+        sep = lo | (hi << 16);
+        newline = nlLo | (nlHi << 16);
+    }
+
+    PCT_TARGET_AVX2 void classifyAvx2(const char* p, uint32_t& sep, uint32_t& newline)
+    {
+        const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        const __m256i nl = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n'));
+        __m256i s = _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')),
+            _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t')));
+        s = _mm256_or_si256(s, _mm256_cmpeq_epi8(v, _mm256_set1_epi8(',')));
+        s = _mm256_or_si256(s, _mm256_cmpeq_epi8(v, _mm256_set1_epi8(';')));
+        s = _mm256_or_si256(s, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r')));
+        s = _mm256_or_si256(s, nl);
+        newline = static_cast<uint32_t>(_mm256_movemask_epi8(nl));
+        sep = static_cast<uint32_t>(_mm256_movemask_epi8(s));
+    }
+
+    bool cpuHasAvx2()
+    {
+#if defined(_MSC_VER)
+        int info[4];
+        __cpuid(info, 0);
+        if (info[0] < 7) return false;
+        __cpuid(info, 1);
+        const bool osxsave = (info[2] & (1 << 27)) != 0;
+        const bool avx = (info[2] & (1 << 28)) != 0;
+        if (!osxsave || !avx) return false;
+        if ((_xgetbv(0) & 6) != 6) return false;   // 操作系统需保存 YMM 寄存器
+        __cpuidex(info, 7, 0);
+        return (info[1] & (1 << 5)) != 0;
+#else
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2");
+#endif
+    }
+#endif
+
+    struct Dispatch
+    {
+        ClassifyFn classify = classifyScalar32;
+        const char* name = "scalar";
+
+        Dispatch()
+        {
+#ifdef PCT_X86
+            if (cpuHasAvx2()) {
+                classify = classifyAvx2;
+                name = "avx2";
+            }
+            else {
+                classify = classifySse2;
+                name = "sse2";
+            }
+#endif
+        }
+    };
+
+    const Dispatch& dispatch()
+    {
+        static const Dispatch d;
+        return d;
+    }
+}
+
+PointCloudTokenizer::PointCloudTokenizer(const char* data, size_t size)
+    : m_data(data)
+    , m_size(size)
+{
+}
+
+const char* PointCloudTokenizer::simdLevel()
+{
+    return dispatch().name;
+}
+
+bool PointCloudTokenizer::loadBlock()
+{
+    if (m_nextBlockPos >= m_size) return false;
+
+    m_blockPos = m_nextBlockPos;
+    const size_t remain = m_size - m_blockPos;
+
+    uint32_t sep, newline;
+    if (remain >= 32) {
+        dispatch().classify(m_data + m_blockPos, sep, newline);
+        m_nextBlockPos = m_blockPos + 32;
+    }
+    else {
+        classifyScalar(m_data + m_blockPos, remain, sep, newline);
+        // 数据末尾之后视为分隔符，这样最后一个字段能正常结束
+        sep |= ~((1u << remain) - 1u);
+        m_nextBlockPos = m_size;
+    }
+
+    // 分隔符状态翻转的位置就是字段的起点或终点
+    const uint32_t transitions = sep ^ ((sep << 1) | m_sepCarry);
+    m_sepCarry = sep >> 31;
+
+    m_sepMask = sep;
+    m_newlineMask = newline;
+    m_events = transitions | newline;
+    return true;
+}
+
+int PointCloudTokenizer::nextLine(Field* fields, int maxFields)
+{
+    int count = 0;
+
+    for (;;) {
+        while (m_events == 0) {
+            if (!loadBlock()) {
+                // 没有换行结尾的最后一行
+                if (m_fieldBegin) {
+                    if (count < maxFields) fields[count] = { m_fieldBegin, m_data + m_size };
+                    ++count;
+                    m_fieldBegin = nullptr;
+                }
+                if (count > 0) return count;
+                return -1;
+            }
+        }
+
+        const int bit = lowestBit(m_events);
+        const uint32_t mask = 1u << bit;
+        m_events &= m_events - 1;
+        const char* ptr = m_data + m_blockPos + bit;
+
+        if (m_newlineMask & mask) {
+            if (m_fieldBegin) {
+                if (count < maxFields) fields[count] = { m_fieldBegin, ptr };
+                ++count;
+                m_fieldBegin = nullptr;
+            }
+            if (count > 0) return count;
+        }
+        else if (m_sepMask & mask) {
+            if (m_fieldBegin) {
+                if (count < maxFields) fields[count] = { m_fieldBegin, ptr };
+                ++count;
+                m_fieldBegin = nullptr;
+            }
+        }
+        else {
+            m_fieldBegin = ptr;
+        }
+    }
+}
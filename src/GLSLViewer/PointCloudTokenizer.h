@@ -0,0 +1,44 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// 文本点云分词器
+// 每次按 32 字节分类分隔符（空格、制表符、逗号、分号、回车）和换行符（AVX2/SSE2，否则标量查表），
+// 再用位运算找出字段边界。连续分隔符视为一个，效果等同于 split(..., Qt::SkipEmptyParts)。
+class PointCloudTokenizer
+{
+public:
+    struct Field
+    {
+        const char* begin;
+        const char* end;
+    };
+
+    PointCloudTokenizer(const char* data, size_t size);
+
+    // 读取下一个非空行，最多写入 maxFields 个字段
+    // 返回该行的字段总数（可能大于 maxFields），数据结束时返回 -1
+    int nextLine(Field* fields, int maxFields);
+
+    // 已处理的字节数
+    size_t position() const { return m_blockPos; }
+
+    // 当前 CPU 上使用的分类实现："avx2"、"sse2" 或 "scalar"
+    static const char* simdLevel();
+
+private:
+    bool loadBlock();
+
+    const char* m_data;
+    size_t m_size;
+
+    size_t m_blockPos = 0;        // 当前块在数据中的偏移
+    size_t m_nextBlockPos = 0;    // 下一块的偏移
+    uint32_t m_events = 0;        // 当前块中还未处理的边界/换行位
+    uint32_t m_sepMask = 0;       // 当前块的分隔符位（包含换行）
+    uint32_t m_newlineMask = 0;   // 当前块的换行位
+    uint32_t m_sepCarry = 1;      // 上一块最后一个字节是否为分隔符
+
+    const char* m_fieldBegin = nullptr;
+};
@@ -0,0 +1,121 @@
+﻿#include "PointCloudUploader.h"
+
+#include <cstring>
+#include <vector>
+#include <QMutex>
+#include <QOpenGLContext>
+#include <QOpenGLExtraFunctions>
+#include <QDebug>
+
+namespace
+{
+    // 没有当前上下文时释放的同步对象
+    QMutex releasedFencesMutex;
+    std::vector<GLsync> releasedFences;
+}
+
+PointCloudUploader::~PointCloudUploader()
+{
+    // 调用方保证创建时的上下文为当前
+    if (!m_staging) return;
+
+    for (GLsync& fence : m_sliceFences) {
+        if (fence) glDeleteSync(fence);
+        fence = nullptr;
+    }
+    glDeleteBuffers(1, &m_staging);
+}
+
+bool PointCloudUploader::initialize()
+{
+    if (m_staging) return true;
+    if (!initializeOpenGLFunctions()) return false;
+
+    // 3.3 core 没有持久映射（glBufferStorage 需要 4.4），每片单独映射
+    glGenBuffers(1, &m_staging);
+    glBindBuffer(GL_COPY_READ_BUFFER, m_staging);
+    glBufferData(GL_COPY_READ_BUFFER, kSliceBytes * kSliceCount, nullptr, GL_STREAM_DRAW);
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    return true;
+}
+
+bool PointCloudUploader::copy(GLuint dst, qint64 dstOffset, const void* src, qint64 bytes)
+{
+    if (!m_staging || bytes <= 0 || bytes > kSliceBytes) return false;
+
+    // 这一片上次的复制还没执行完，不等待
+    GLsync& fence = m_sliceFences[m_nextSlice];
+    if (fence) {
+        const GLenum status = glClientWaitSync(fence, 0, 0);
+        if (status == GL_TIMEOUT_EXPIRED) return false;
+        glDeleteSync(fence);
+        fence = nullptr;
+    }
+
+    const qint64 stagingOffset = m_nextSlice * kSliceBytes;
+    glBindBuffer(GL_COPY_READ_BUFFER, m_staging);
+    void* mapped = glMapBufferRange(GL_COPY_READ_BUFFER, stagingOffset, bytes,
+        GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+    if (!mapped) {
+        qWarning() << "Failed to map staging buffer";
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        return false;
+    }
+    std::memcpy(mapped, src, static_cast<size_t>(bytes));
+    glUnmapBuffer(GL_COPY_READ_BUFFER);
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, dst);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, stagingOffset, dstOffset, bytes);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+
+    fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    m_nextSlice = (m_nextSlice + 1) % kSliceCount;
+    return true;
+}
+
+void PointCloudUploader::replaceFence(GLsync& fence)
+{
+    if (fence) glDeleteSync(fence);
+    fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    // 其它上下文等待的同步对象必须先提交
+    glFlush();
+}
+
+bool PointCloudUploader::finishFence(GLsync& fence)
+{
+    if (!fence) return true;
+
+    if (glClientWaitSync(fence, 0, 0) != GL_TIMEOUT_EXPIRED) {
+        glDeleteSync(fence);
+        fence = nullptr;
+        return true;
+    }
+    // 上传可能在其它上下文中进行，绘制前在 GPU 端等它完成
+    glWaitSync(fence, 0, GL_TIMEOUT_IGNORED);
+    return false;
+}
+
+void PointCloudUploader::releaseFence(GLsync fence)
+{
+    if (!fence) return;
+
+    if (QOpenGLContext* context = QOpenGLContext::currentContext()) {
+        context->extraFunctions()->glDeleteSync(fence);
+        return;
+    }
+    QMutexLocker locker(&releasedFencesMutex);
+    releasedFences.push_back(fence);
+}
+
+void PointCloudUploader::deleteReleasedFences()
+{
+    if (!m_staging) return;
+
+    std::vector<GLsync> fences;
+    {
+        QMutexLocker locker(&releasedFencesMutex);
+        fences.swap(releasedFences);
+    }
+    for (GLsync fence : fences) glDeleteSync(fence);
+}
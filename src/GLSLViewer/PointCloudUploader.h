@@ -0,0 +1,40 @@
+﻿#pragma once
+
+#include <QOpenGLFunctions_3_3_Core>
+
+// 顶点数据的流式上传：一个暂存缓冲分成若干片循环使用
+// 每片用 glMapBufferRange（GL_MAP_UNSYNCHRONIZED_BIT）写入后 glCopyBufferSubData 到目标缓冲，
+// 再插入同步对象；下次轮到这一片时只查询不等待，GPU 还没读完就推迟到下一帧，绘制线程不会被阻塞
+// 每个上下文一个实例，与创建它的上下文一起使用和销毁
+class PointCloudUploader : protected QOpenGLFunctions_3_3_Core
+{
+public:
+    static constexpr qint64 kSliceBytes = 16 * 1024 * 1024;
+    static constexpr int kSliceCount = 3;
+
+    PointCloudUploader() = default;
+    ~PointCloudUploader();
+
+    PointCloudUploader(const PointCloudUploader&) = delete;
+    PointCloudUploader& operator=(const PointCloudUploader&) = delete;
+
+    bool initialize();
+
+    // 把 src 的 bytes 字节（不超过 kSliceBytes）复制到 dst 缓冲的 dstOffset 处
+    // 暂存片都还在被 GPU 使用时返回 false，调用方下一帧再试
+    bool copy(GLuint dst, qint64 dstOffset, const void* src, qint64 bytes);
+
+    // 数据集的上传同步对象：上传后替换；已执行完的删除并返回 true，否则让当前上下文在 GPU 端等待
+    void replaceFence(GLsync& fence);
+    bool finishFence(GLsync& fence);
+
+    // 释放不再使用的同步对象：有当前上下文时立即删除，否则（如 GUI 线程按内存预算释放缓冲）先记下，
+    // 由下一个调用 deleteReleasedFences() 的上下文删除；同步对象在共享组内共享，哪个上下文删除都可以
+    static void releaseFence(GLsync fence);
+    void deleteReleasedFences();
+
+private:
+    GLuint m_staging = 0;
+    GLsync m_sliceFences[kSliceCount] = {};
+    int m_nextSlice = 0;
+};
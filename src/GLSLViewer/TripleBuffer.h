@@ -0,0 +1,41 @@
+﻿#pragma once
+
+#include <atomic>
+
+// 单生产者/单消费者的无锁三缓冲，只传递最新值
+// 生产者写 back() 后 publish()；消费者 update() 切换到最新发布的一份后读 front()。
+// 三个槽位在两端之间交换，任意时刻每个槽位只属于一端，槽位内容不需要加锁
+template <class T>
+class TripleBuffer
+{
+public:
+    // 生产者
+    T& back() { return m_slots[m_back]; }
+    int backIndex() const { return m_back; }
+    void publish()
+    {
+        m_back = m_middle.exchange(m_back | kFresh, std::memory_order_acq_rel) & kIndexMask;
+    }
+
+    // 消费者：有新发布的值时切换并返回 true
+    bool update()
+    {
+        if (!(m_middle.load(std::memory_order_acquire) & kFresh)) return false;
+        m_front = m_middle.exchange(m_front, std::memory_order_acq_rel) & kIndexMask;
+        return true;
+    }
+    T& front() { return m_slots[m_front]; }
+    int frontIndex() const { return m_front; }
+
+    // 两端都停止访问后使用
+    T& slot(int index) { return m_slots[index]; }
+
+private:
+    static constexpr int kIndexMask = 0x3;
+    static constexpr int kFresh = 0x4;
+
+    T m_slots[3];
+    int m_back = 0;
+    int m_front = 1;
+    std::atomic<int> m_middle{ 2 };
+};
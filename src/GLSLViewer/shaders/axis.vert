@@ -0,0 +1,9 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aColor;
+uniform mat4 uProjection;
+out vec3 vColor;
+void main() {
+   gl_Position = uProjection * vec4(aPos, 1.0);
+   vColor = aColor;
+}
@@ -0,0 +1,69 @@
+#version 330 core
+// 视觉着色（Eye-Dome Lighting）：比较每个像素与周围像素的对数深度，比邻域远的像素变暗
+// 只读取点云的深度缓冲，不需要法线
+// 变体宏（由 PointCloudShaderLibrary 插入）：
+//   EDL_SHADE     只输出明暗系数，写入半分辨率目标
+//   EDL_HALF_RES  合成时读取半分辨率的明暗系数
+//   都没有时合成时逐像素计算
+uniform sampler2D uDepth;      // 点云深度（窗口坐标 [0, 1]）
+uniform vec2 uDepthParams;     // 投影矩阵的 (2,2) 和 (2,3)，用于还原到相机的距离
+uniform ivec2 uDepthSize;      // 深度纹理中实际渲染的区域（像素）
+uniform float uRadius;         // 邻域半径（深度纹理像素）
+uniform float uStrength;
+
+#if defined(EDL_SHADE)
+out vec4 FragShade;
+#else
+uniform sampler2D uColor;
+#if defined(EDL_HALF_RES)
+uniform sampler2D uShade;
+#endif
+out vec4 FragColor;
+#endif
+
+// 到相机的距离，背景返回 0
+float linearDepth(ivec2 p)
+{
+    float d = texelFetch(uDepth, p, 0).r;
+    if (d >= 1.0) return 0.0;
+    return uDepthParams.y / (d * 2.0 - 1.0 + uDepthParams.x);
+}
+
+float shade(ivec2 p)
+{
+    float center = linearDepth(p);
+    if (center <= 0.0) return 1.0;
+    float logCenter = log2(center);
+
+    const vec2 offsets[8] = vec2[8](
+        vec2(1.0, 0.0), vec2(-1.0, 0.0), vec2(0.0, 1.0), vec2(0.0, -1.0),
+        vec2(0.7071, 0.7071), vec2(-0.7071, 0.7071), vec2(0.7071, -0.7071), vec2(-0.7071, -0.7071));
+
+    float sum = 0.0;
+    for (int i = 0; i < 8; ++i) {
+        ivec2 q = clamp(p + ivec2(round(offsets[i] * uRadius)), ivec2(0), uDepthSize - 1);
+        float d = linearDepth(q);
+        // 背景邻域不参与
+        if (d > 0.0) sum += max(0.0, logCenter - log2(d));
+    }
+    return exp(-sum / 8.0 * 300.0 * uStrength);
+}
+
+void main()
+{
+#if defined(EDL_SHADE)
+    // 半分辨率像素对应深度纹理中的左下角像素
+    FragShade = vec4(shade(ivec2(gl_FragCoord.xy) * 2));
+#else
+    ivec2 p = ivec2(gl_FragCoord.xy);
+#if defined(EDL_HALF_RES)
+    float s = texture(uShade, gl_FragCoord.xy * 0.5 / vec2(textureSize(uShade, 0))).r;
+#else
+    float s = shade(p);
+#endif
+    vec4 color = texelFetch(uColor, p, 0);
+    FragColor = vec4(color.rgb * s, color.a);
+    // 写回点云深度，之后的包围盒仍然按深度遮挡
+    gl_FragDepth = texelFetch(uDepth, p, 0).r;
+#endif
+}
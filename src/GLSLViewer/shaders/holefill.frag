@@ -0,0 +1,160 @@
+#version 330 core
+// 屏幕空间补洞（pull-push）
+// pull：逐级把 2×2 像素合成一个，只保留最靠前的表面，记录覆盖率（有点的像素比例）
+// push：从最粗一级往回，空像素用粗一级插值补上；被前景缝隙透出的远处像素同样替换
+// 覆盖率低于 uMinCoverage 的空像素视为真正的背景，轮廓不会向外扩张
+// 变体宏（由 PointCloudShaderLibrary 插入）：
+//   PULL_FROM_SCENE  由点云帧缓冲生成第 1 级
+//   PULL             由第 L-1 级生成第 L 级
+//   PUSH             合成第 L 级（L > 0）
+//   PUSH_TO_SCENE    合成最终图像，写回颜色和深度
+// 金字塔纹理：颜色 rgb + 覆盖率 a，深度为到相机的距离（0 为空）
+// 读取的级别由纹理的 BASE_LEVEL 指定，texelFetch 总是取第 0 级
+uniform vec2 uDepthParams;     // 投影矩阵的 (2,2) 和 (2,3)
+uniform float uTolerance;      // 相对深度差在此范围内视为同一表面
+uniform float uMinCoverage;
+uniform ivec2 uFineSize;       // 精细一级的有效区域（像素）
+
+#if defined(PULL_FROM_SCENE) || defined(PUSH_TO_SCENE)
+#define FINE_IS_SCENE
+uniform sampler2D uSceneColor;
+uniform sampler2D uSceneDepth;
+#else
+uniform sampler2D uFineColor;
+uniform sampler2D uFineDepth;
+#endif
+
+#if defined(PUSH) || defined(PUSH_TO_SCENE)
+uniform sampler2D uCoarseColor;
+uniform sampler2D uCoarseDepth;
+uniform ivec2 uCoarseSize;
+#endif
+
+#if defined(PUSH_TO_SCENE)
+out vec4 FragColor;
+#else
+layout(location = 0) out vec4 FragColor;
+layout(location = 1) out float FragDepth;
+#endif
+
+struct Sample
+{
+    vec3 color;
+    float depth;
+    float weight;
+};
+
+Sample fetchFine(ivec2 p)
+{
+    Sample s = Sample(vec3(0.0), 0.0, 0.0);
+    if (any(greaterThanEqual(p, uFineSize))) return s;
+#if defined(FINE_IS_SCENE)
+    float d = texelFetch(uSceneDepth, p, 0).r;
+    if (d < 1.0) {
+        s.color = texelFetch(uSceneColor, p, 0).rgb;
+        s.depth = uDepthParams.y / (d * 2.0 - 1.0 + uDepthParams.x);
+        s.weight = 1.0;
+    }
+#else
+    vec4 c = texelFetch(uFineColor, p, 0);
+    s.color = c.rgb;
+    s.weight = c.a;
+    s.depth = texelFetch(uFineDepth, p, 0).r;
+#endif
+    return s;
+}
+
+#if defined(PULL_FROM_SCENE) || defined(PULL)
+void main()
+{
+    ivec2 base = ivec2(gl_FragCoord.xy) * 2;
+    Sample s[4];
+    float nearest = 1e30;
+    for (int i = 0; i < 4; ++i) {
+        s[i] = fetchFine(base + ivec2(i & 1, i >> 1));
+        if (s[i].weight > 0.0) nearest = min(nearest, s[i].depth);
+    }
+
+    // 只合并最靠前的表面，前景和透出的背景不混色
+    vec3 color = vec3(0.0);
+    float depth = 0.0;
+    float weight = 0.0;
+    for (int i = 0; i < 4; ++i) {
+        if (s[i].weight > 0.0 && s[i].depth <= nearest * (1.0 + uTolerance)) {
+            color += s[i].color * s[i].weight;
+            depth += s[i].depth * s[i].weight;
+            weight += s[i].weight;
+        }
+    }
+
+    FragColor = weight > 0.0 ? vec4(color / weight, weight * 0.25) : vec4(0.0);
+    FragDepth = weight > 0.0 ? depth / weight : 0.0;
+}
+#else
+// 粗一级按覆盖率加权的双线性插值
+Sample fetchCoarse(vec2 fragCoord)
+{
+    vec2 c = fragCoord * 0.5 - 0.5;
+    vec2 f = fract(c);
+    ivec2 base = ivec2(floor(c));
+
+    vec3 color = vec3(0.0);
+    float depth = 0.0;
+    float weight = 0.0;
+    for (int i = 0; i < 4; ++i) {
+        ivec2 q = base + ivec2(i & 1, i >> 1);
+        if (any(lessThan(q, ivec2(0))) || any(greaterThanEqual(q, uCoarseSize))) continue;
+        float b = ((i & 1) != 0 ? f.x : 1.0 - f.x) * ((i >> 1) != 0 ? f.y : 1.0 - f.y);
+        vec4 texel = texelFetch(uCoarseColor, q, 0);
+        float w = b * texel.a;
+        color += texel.rgb * w;
+        depth += texelFetch(uCoarseDepth, q, 0).r * w;
+        weight += w;
+    }
+
+    Sample s = Sample(vec3(0.0), 0.0, weight);
+    if (weight > 0.0) {
+        s.color = color / weight;
+        s.depth = depth / weight;
+    }
+    return s;
+}
+
+void main()
+{
+    ivec2 p = ivec2(gl_FragCoord.xy);
+    Sample fine = fetchFine(p);
+    Sample coarse = fetchCoarse(gl_FragCoord.xy);
+
+    // 粗一级覆盖充分且明显更近：这个像素是从前景点之间的缝隙透出来的
+    if (fine.weight > 0.0 && coarse.weight > 0.0 && coarse.weight >= uMinCoverage && fine.depth > coarse.depth * (1.0 + uTolerance)) {
+        fine.weight = 0.0;
+    }
+
+#if defined(PUSH_TO_SCENE)
+    Sample result = fine;
+    if (fine.weight <= 0.0) {
+        if (coarse.weight <= 0.0 || coarse.weight < uMinCoverage) {
+            // 背景保持点云帧缓冲的清屏颜色
+            FragColor = texelFetch(uSceneColor, p, 0);
+            gl_FragDepth = 1.0;
+            return;
+        }
+        result = coarse;
+    }
+    FragColor = vec4(result.color, 1.0);
+    gl_FragDepth = ((uDepthParams.y / result.depth - uDepthParams.x) + 1.0) * 0.5;
+#else
+    float weight = fine.weight + (1.0 - fine.weight) * coarse.weight;
+    if (weight <= 0.0) {
+        FragColor = vec4(0.0);
+        FragDepth = 0.0;
+        return;
+    }
+    float fineWeight = fine.weight / weight;
+    float coarseWeight = (1.0 - fine.weight) * coarse.weight / weight;
+    FragColor = vec4(fine.color * fineWeight + coarse.color * coarseWeight, weight);
+    FragDepth = fine.depth * fineWeight + coarse.depth * coarseWeight;
+#endif
+}
+#endif
@@ -1,4 +1,13 @@
 #version 330 core
+#if defined(PICK_ID)
+flat in uint vId;
+out uint FragId;
+
+void main()
+{
+    FragId = vId;
+}
+#else
 in vec3 vColor;
 out vec4 FragColor;
 
@@ -6,3 +15,4 @@ void main()
 {
     FragColor = vec4(vColor, 1.0);
 }
+#endif
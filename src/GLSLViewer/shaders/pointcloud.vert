@@ -1,36 +1,97 @@
 #version 330 core
+// 变体宏（由 PointCloudShaderLibrary 插入）：COLOR_ELEVATION 按高程着色，COLOR_RGB 使用逐点颜色；
+// ADAPTIVE_SIZE 按点间距网格决定点大小，否则为固定大小；
+// PICK_ID 输出点序号 + 1 用于拾取（点按原始顺序绘制，gl_VertexID 即序号），不计算颜色
+// CLIPPING 按裁剪盒和剖切面逐点裁剪，没有裁剪体时不定义，不做逐点判断；
+// 被裁掉和已删除的点移到裁剪空间之外，由图元裁剪丢弃，不产生片元
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aColor;
+layout (location = 2) in uint aFlags;   // 逐点标志，第 0 位为选中，第 1 位为已删除；没有标志缓冲时为 0
 
 uniform mat4 uProjection;
 uniform mat4 uView;
-uniform int uRenderMode;
 uniform float uMinZ;
 uniform float uMaxZ;
+#if defined(COLOR_ELEVATION)
+uniform sampler1D uColormap;   // 256 级色带查找表
+#endif
+#if defined(ADAPTIVE_SIZE)
+uniform sampler3D uSpacing;        // 每个网格的点间距（局部坐标单位）
+uniform vec3 uSpacingOrigin;       // 网格最小角
+uniform vec3 uSpacingScale;        // 1 / 网格总尺寸
+uniform float uPixelsPerUnit;      // 距相机一个单位处，一个单位长度对应的像素数
+uniform float uPointScale;         // 全局系数
+uniform vec2 uPointSizeRange;      // 点大小范围（像素）
+#else
+uniform float uPointSize;
+#endif
 
+#if defined(CLIPPING)
+// 裁剪盒和剖切面，数组大小与 PointCloudClipping::kMaxBoxes / kMaxPlanes 一致
+uniform int uClipBoxCount;
+uniform vec3 uClipBoxMin[8];
+uniform vec3 uClipBoxMax[8];
+uniform int uClipBoxKeepInside[8];   // 0 时隐藏盒内的点
+uniform int uClipPlaneCount;
+uniform vec4 uClipPlanes[6];         // 保留 dot(xyz, p) + w >= 0 的一侧
+uniform int uClipInvert;             // 非 0 时对所有裁剪体的交取反
+#endif
+
+#if defined(PICK_ID)
+flat out uint vId;
+#else
 out vec3 vColor;
+#endif
 
-vec3 elevationColor(float t) {
-    vec3 c0 = vec3(0.0, 0.0, 0.5);
-    vec3 c1 = vec3(0.0, 0.5, 0.0);
-    vec3 c2 = vec3(0.8, 0.8, 0.0);
-    vec3 c3 = vec3(1.0, 1.0, 1.0);
-    if (t < 0.25) return mix(c0, c1, t * 4.0);
-    else if (t < 0.5) return mix(c1, c2, (t - 0.25) * 4.0);
-    else if (t < 0.75) return mix(c2, c3, (t - 0.5) * 4.0);
-    else return c3;
+#if defined(CLIPPING)
+bool clipped(vec3 p)
+{
+    bool invert = uClipInvert != 0;
+    for (int i = 0; i < uClipBoxCount; ++i) {
+        bool inside = all(greaterThanEqual(p, uClipBoxMin[i])) && all(lessThanEqual(p, uClipBoxMax[i]));
+        if (inside != (uClipBoxKeepInside[i] != 0)) return !invert;
+    }
+    for (int i = 0; i < uClipPlaneCount; ++i) {
+        if (dot(uClipPlanes[i].xyz, p) + uClipPlanes[i].w < 0.0) return !invert;
+    }
+    return invert;
 }
+#endif
 
 void main()
 {
+#if defined(CLIPPING)
+    bool hidden = (aFlags & 2u) != 0u || clipped(aPos);
+#else
+    bool hidden = (aFlags & 2u) != 0u;
+#endif
+    if (hidden) {
+        gl_Position = vec4(2.0, 2.0, 2.0, 1.0);
+        gl_PointSize = 1.0;
+        return;
+    }
+
     gl_Position = uProjection * uView * vec4(aPos, 1.0);
-    gl_PointSize = 3.0;
+#if defined(ADAPTIVE_SIZE)
+    // 间距投影到屏幕上的像素数：透视下与到相机的距离（clip.w）成反比
+    float spacing = texture(uSpacing, (aPos - uSpacingOrigin) * uSpacingScale).r;
+    gl_PointSize = clamp(uPointScale * spacing * uPixelsPerUnit / max(gl_Position.w, 1e-6),
+        uPointSizeRange.x, uPointSizeRange.y);
+#else
+    gl_PointSize = uPointSize;
+#endif
 
-    if (uRenderMode == 0) {
-        float t = (aPos.z - uMinZ) / (uMaxZ - uMinZ + 1e-6);
-        t = clamp(t, 0.0, 1.0);
-        vColor = elevationColor(t);
-    } else {
-        vColor = aColor;
-    }
+#if defined(PICK_ID)
+    vId = uint(gl_VertexID) + 1u;
+#elif defined(COLOR_ELEVATION)
+    float t = (aPos.z - uMinZ) / (uMaxZ - uMinZ + 1e-6);
+    t = clamp(t, 0.0, 1.0);
+    // 采样点落在首末纹素中心，两端不与相邻级混合
+    vColor = texture(uColormap, (t * 255.0 + 0.5) / 256.0).rgb;
+#else
+    vColor = aColor;
+#endif
+#if !defined(PICK_ID)
+    if ((aFlags & 1u) != 0u) vColor = mix(vColor, vec3(1.0, 0.15, 0.1), 0.75);
+#endif
 }
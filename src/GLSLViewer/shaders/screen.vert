@@ -0,0 +1,7 @@
+#version 330 core
+// 覆盖整个视口的三角形，顶点由 gl_VertexID 生成，不需要顶点缓冲
+void main()
+{
+    vec2 pos = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    gl_Position = vec4(pos * 2.0 - 1.0, 0.0, 1.0);
+}
@@ -0,0 +1,339 @@
+#include <QCoreApplication>
+#include <QGuiApplication>
+#include <QOpenGLContext>
+#include <QOffscreenSurface>
+#include <QSurfaceFormat>
+#include <QOpenGLFunctions_3_3_Core>
+#include <QOpenGLShaderProgram>
+#include <QOpenGLBuffer>
+#include <QOpenGLVertexArrayObject>
+#include <QOpenGLFramebufferObject>
+#include <QStringList>
+#include <QFile>
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QMatrix4x4>
+#include <QDebug>
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "GLSLViewer/PointCloudData.h"
+#include "GLSLViewer/PointCloudReader.h"
+#include "GLSLViewer/PointCloudKdTree.h"
+#include "GLSLViewer/PointCloudShaderLibrary.h"
+
+// 点云性能测试，结果输出到控制台
+//   PointCloudBench kdtree [文件|点数] [查询数] [k] [半径]
+//       构建 k-d 树并输出单线程、批量的每秒查询数；第一个参数为数字时生成模拟地形
+//   PointCloudBench reader <文件> [重复次数=5]
+//       同一份文本分别用识别出的专用格式和通用路径解析，输出各自的 MB/s 和点数
+//   PointCloudBench shaders [nocache]
+//       离屏创建新窗口首帧用到的着色器程序并各画一次，输出耗时；nocache 时关闭 Qt 的程序二进制缓存，即从源码编译。
+//       不带 nocache 时第一次运行写入磁盘缓存，之后的运行从缓存加载；每次运行的第二轮命中进程内缓存。
+//       驱动自身的着色器缓存（如 Mesa 的磁盘缓存）不受 nocache 影响
+//   PointCloudBench variants [点数=2000000] [重复次数=15]
+//       点云着色器的各个变体分别画模拟地形，关闭光栅化只计顶点阶段，输出每次绘制的中位耗时和每点纳秒数
+namespace
+{
+    void printUsage()
+    {
+        qInfo() << "Usage:";
+        qInfo() << "  PointCloudBench kdtree [file|pointCount] [queries=100000] [k=8] [radius=0.5]";
+        qInfo() << "  PointCloudBench reader <file> [repeat=5]";
+        qInfo() << "  PointCloudBench shaders [nocache]";
+        qInfo() << "  PointCloudBench variants [pointCount=2000000] [repeat=15]";
+    }
+
+    // 模拟地面扫描：起伏地面上按扫描线采样，点距约 0.1，带少量高程噪声
+    std::shared_ptr<PointCloudData> syntheticCloud(size_t count)
+    {
+        auto cloud = std::make_shared<PointCloudData>();
+        cloud->points.resize(count * PointCloudData::kFloatsPerPoint);
+        const size_t perLine = static_cast<size_t>(std::sqrt(static_cast<double>(count))) + 1;
+        std::mt19937 random(2024);
+        std::normal_distribution<float> noise(0.0f, 0.02f);
+        for (size_t i = 0; i < count; ++i) {
+            float* p = cloud->points.data() + i * PointCloudData::kFloatsPerPoint;
+            p[0] = static_cast<float>(i % perLine) * 0.1f;
+            p[1] = static_cast<float>(i / perLine) * 0.1f;
+            p[2] = 2.0f * std::sin(p[0] * 0.05f) * std::cos(p[1] * 0.07f) + noise(random);
+            p[3] = p[4] = p[5] = 1.0f;
+        }
+        return cloud;
+    }
+
+    // 参数为数字时生成模拟数据，否则按文件读取
+    std::shared_ptr<PointCloudData> loadCloud(const QString& source)
+    {
+        bool isCount = false;
+        const qulonglong count = source.toULongLong(&isCount);
+        if (isCount) return count > 0 ? syntheticCloud(count) : nullptr;
+
+        auto cloud = std::make_shared<PointCloudData>();
+        if (!PointCloudReader::readFile(source, *cloud) || cloud->empty()) {
+            qWarning() << "Cannot read points from" << source;
+            return nullptr;
+        }
+        return cloud;
+    }
+
+    int benchKdTree(const QStringList& args)
+    {
+        const std::shared_ptr<PointCloudData> cloud = loadCloud(args.value(0, QStringLiteral("1000000")));
+        if (!cloud) return 1;
+        const size_t queries = args.value(1, QStringLiteral("100000")).toULongLong();
+        const int k = args.value(2, QStringLiteral("8")).toInt();
+        const float radius = args.value(3, QStringLiteral("0.5")).toFloat();
+
+        // 构建耗时由 build() 输出
+        PointCloudKdTree tree;
+        if (!tree.build(*cloud)) {
+            qWarning() << "Failed to build k-d tree";
+            return 1;
+        }
+        qInfo() << "k-d tree memory:" << tree.memoryBytes() / (1 << 20) << "MB";
+
+        tree.benchmark(queries, k, radius);
+        return 0;
+    }
+
+    // 重复 repeat 次取最快的一次，减少文件缓存和频率变化的影响
+    double timeRead(const QByteArray& text, PointSchema schema, const PointCloudOrigin& origin,
+        double bytesPerLine, int repeat, size_t& points)
+    {
+        double best = 0.0;
+        for (int i = 0; i < repeat; ++i) {
+            PointCloudData cloud;
+            QElapsedTimer timer;
+            timer.start();
+            PointCloudReader::read(text.constData(), static_cast<size_t>(text.size()), schema, origin, cloud, bytesPerLine);
+            const double seconds = qMax(timer.nsecsElapsed() * 1e-9, 1e-9);
+            if (i == 0 || seconds < best) best = seconds;
+            points = cloud.pointCount();
+        }
+        return best;
+    }
+
+    int benchReader(const QStringList& args)
+    {
+        if (args.isEmpty()) {
+            printUsage();
+            return 1;
+        }
+        QFile file(args.at(0));
+        if (!file.open(QIODevice::ReadOnly)) {
+            qWarning() << "Cannot open file:" << args.at(0);
+            return 1;
+        }
+        // 读入内存后再计时，两条路径解析同一块缓冲
+        const QByteArray text = file.readAll();
+        const int repeat = qMax(1, args.value(1, QStringLiteral("5")).toInt());
+
+        double bytesPerLine = 40.0;
+        PointCloudOrigin origin;
+        const PointSchema schema = PointCloudReader::detectSchema(text.constData(),
+            static_cast<size_t>(text.size()), &bytesPerLine, &origin);
+
+        const double mb = text.size() / 1e6;
+        size_t points = 0;
+        const double specialized = timeRead(text, schema, origin, bytesPerLine, repeat, points);
+        qInfo().nospace() << "schema " << PointCloudReader::schemaName(schema) << ": "
+                          << specialized * 1e3 << " ms, " << mb / specialized << " MB/s, " << points << " points";
+
+        const double generic = timeRead(text, PointSchema::Generic, origin, bytesPerLine, repeat, points);
+        qInfo().nospace() << "schema Generic: "
+                          << generic * 1e3 << " ms, " << mb / generic << " MB/s, " << points << " points";
+        qInfo().nospace() << "speedup: " << generic / specialized << "x";
+        return 0;
+    }
+
+    // 离屏的 OpenGL 3.3 核心上下文，与窗口中使用的版本一致
+    bool createContext(QOpenGLContext& context, QOffscreenSurface& surface)
+    {
+        QSurfaceFormat format;
+        format.setVersion(3, 3);
+        format.setProfile(QSurfaceFormat::CoreProfile);
+        context.setFormat(format);
+        if (!context.create()) {
+            qWarning() << "Failed to create OpenGL context";
+            return false;
+        }
+        surface.setFormat(context.format());
+        surface.create();
+        if (!context.makeCurrent(&surface)) {
+            qWarning() << "Failed to make OpenGL context current";
+            return false;
+        }
+        qInfo() << "OpenGL renderer:" << reinterpret_cast<const char*>(context.functions()->glGetString(GL_RENDERER));
+        return true;
+    }
+
+    // 新窗口首帧用到的三个程序：默认（高程着色）的点云变体、坐标轴和包围盒
+    // 驱动可能把部分编译推迟到第一次绘制，因此同时输出加上各画一个点的耗时
+    bool timeShaderPrograms(QOpenGLFunctions_3_3_Core& gl, int round)
+    {
+        const std::pair<PointCloudShaderLibrary::Program, QByteArrayList> sources[] = {
+            { PointCloudShaderLibrary::ePointCloud, { QByteArrayLiteral("COLOR_ELEVATION") } },
+            { PointCloudShaderLibrary::eScreenAxis, {} },
+            { PointCloudShaderLibrary::eBoundingBox, {} },
+        };
+
+        QElapsedTimer timer;
+        timer.start();
+        std::vector<std::unique_ptr<QOpenGLShaderProgram>> programs;
+        for (const auto& source : sources) {
+            std::unique_ptr<QOpenGLShaderProgram> program = PointCloudShaderLibrary::create(source.first, source.second);
+            if (!program) return false;
+            programs.push_back(std::move(program));
+        }
+        gl.glFinish();
+        const double createMs = timer.nsecsElapsed() / 1e6;
+
+        for (const std::unique_ptr<QOpenGLShaderProgram>& program : programs) {
+            program->bind();
+            gl.glDrawArrays(GL_POINTS, 0, 1);
+            program->release();
+        }
+        gl.glFinish();
+        const double firstDrawMs = timer.nsecsElapsed() / 1e6;
+
+        qInfo().nospace() << "round " << round << ": create " << createMs << " ms, with first draw " << firstDrawMs << " ms";
+        return true;
+    }
+
+    int benchShaders()
+    {
+        QOpenGLContext context;
+        QOffscreenSurface surface;
+        if (!createContext(context, surface)) return 1;
+        QOpenGLFunctions_3_3_Core gl;
+        gl.initializeOpenGLFunctions();
+
+        qInfo() << "Qt program binary cache:"
+                << (QCoreApplication::testAttribute(Qt::AA_DisableShaderDiskCache) ? "disabled" : "enabled");
+
+        // 核心模式下绘制需要绑定 VAO，画到小的离屏缓冲中
+        QOpenGLVertexArrayObject vao;
+        vao.create();
+        vao.bind();
+        QOpenGLFramebufferObject target(64, 64);
+        target.bind();
+        gl.glViewport(0, 0, 64, 64);
+
+        for (int round = 1; round <= 2; ++round) {
+            if (!timeShaderPrograms(gl, round)) return 1;
+        }
+
+        target.release();
+        vao.release();
+        context.doneCurrent();
+        return 0;
+    }
+
+    int benchVariants(const QStringList& args)
+    {
+        const size_t pointCount = args.value(0, QStringLiteral("2000000")).toULongLong();
+        const int repeat = qMax(1, args.value(1, QStringLiteral("15")).toInt());
+        if (pointCount == 0) {
+            printUsage();
+            return 1;
+        }
+        const std::shared_ptr<PointCloudData> cloud = syntheticCloud(pointCount);
+
+        QOpenGLContext context;
+        QOffscreenSurface surface;
+        if (!createContext(context, surface)) return 1;
+        QOpenGLFunctions_3_3_Core gl;
+        gl.initializeOpenGLFunctions();
+
+        // 顶点布局与 PointCloudRenderer 相同：xyz + rgb 交错，没有标志缓冲
+        QOpenGLVertexArrayObject vao;
+        vao.create();
+        vao.bind();
+        QOpenGLBuffer vbo;
+        vbo.create();
+        vbo.bind();
+        vbo.allocate(cloud->points.data(), static_cast<int>(cloud->points.size() * sizeof(float)));
+        gl.glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), nullptr);
+        gl.glEnableVertexAttribArray(0);
+        gl.glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), reinterpret_cast<void*>(3 * sizeof(float)));
+        gl.glEnableVertexAttribArray(1);
+        gl.glVertexAttribI4ui(2, 0, 0, 0, 0);
+        gl.glEnable(GL_PROGRAM_POINT_SIZE);
+
+        // 离屏表面不一定有默认帧缓冲，绘制到小的离屏缓冲中；光栅化关闭，不会写入
+        QOpenGLFramebufferObject target(64, 64);
+        target.bind();
+        gl.glViewport(0, 0, 64, 64);
+        gl.glEnable(GL_RASTERIZER_DISCARD);
+
+        const QByteArrayList variants[] = {
+            { QByteArrayLiteral("COLOR_ELEVATION") },
+            { QByteArrayLiteral("COLOR_RGB") },
+            { QByteArrayLiteral("PICK_ID") },
+        };
+        for (const QByteArrayList& defines : variants) {
+            std::unique_ptr<QOpenGLShaderProgram> program = PointCloudShaderLibrary::create(PointCloudShaderLibrary::ePointCloud, defines);
+            if (!program) return 1;
+            program->bind();
+            program->setUniformValue("uProjection", QMatrix4x4());
+            program->setUniformValue("uView", QMatrix4x4());
+            program->setUniformValue("uMinZ", -2.0f);
+            program->setUniformValue("uMaxZ", 2.0f);
+            program->setUniformValue("uPointSize", 1.0f);
+
+            // 先画一次，排除驱动推迟到首次绘制的编译
+            gl.glDrawArrays(GL_POINTS, 0, static_cast<GLsizei>(pointCount));
+            gl.glFinish();
+
+            std::vector<double> times;
+            for (int i = 0; i < repeat; ++i) {
+                QElapsedTimer timer;
+                timer.start();
+                gl.glDrawArrays(GL_POINTS, 0, static_cast<GLsizei>(pointCount));
+                gl.glFinish();
+                times.push_back(timer.nsecsElapsed() / 1e6);
+            }
+            std::sort(times.begin(), times.end());
+            const double median = times[times.size() / 2];
+            qInfo().nospace() << defines.join(' ') << ": " << median << " ms, " << median * 1e6 / pointCount << " ns/point";
+            program->release();
+        }
+
+        gl.glDisable(GL_RASTERIZER_DISCARD);
+        target.release();
+        vbo.release();
+        vao.release();
+        context.doneCurrent();
+        return 0;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    // 着色器测试需要 OpenGL 上下文，使用 QGuiApplication；其它命令不依赖窗口系统
+    const bool needsOpenGL = argc > 1 && (qstrcmp(argv[1], "shaders") == 0 || qstrcmp(argv[1], "variants") == 0);
+    for (int i = 2; needsOpenGL && i < argc; ++i) {
+        // 必须在创建应用对象之前设置
+        if (qstrcmp(argv[i], "nocache") == 0) QCoreApplication::setAttribute(Qt::AA_DisableShaderDiskCache);
+    }
+    std::unique_ptr<QCoreApplication> app;
+    if (needsOpenGL) app = std::make_unique<QGuiApplication>(argc, argv);
+    else app = std::make_unique<QCoreApplication>(argc, argv);
+
+    QStringList args = app->arguments().mid(1);
+    const QString command = args.isEmpty() ? QString() : args.takeFirst();
+
+    if (command == QLatin1String("kdtree")) return benchKdTree(args);
+    if (command == QLatin1String("reader")) return benchReader(args);
+    if (command == QLatin1String("shaders")) return benchShaders();
+    if (command == QLatin1String("variants")) return benchVariants(args);
+
+    printUsage();
+    return command.isEmpty() ? 0 : 1;
+}